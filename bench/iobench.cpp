@@ -0,0 +1,199 @@
+//Round-trip benchmark of formatted and unformatted data transfer.
+//
+//Generates two pairs of programs that move the same INTEGER and REAL values through a
+//file: one pair writes them with PRINT and reads them back with READ *, from --input,
+//the other writes them with WRITE to an unformatted unit and reads them back with READ
+//from it. A record of values is written or read at each leaf of a binary recursion of
+//the given depth. Each program is run by the interpreter several times and the best
+//wall time is printed, with the size of the file; the read programs print a checksum
+//of what they read, which must be the same for both pairs.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+struct Options {
+	string interpreter = "./interpreter";
+	string dir = "/tmp";
+	int depth = 16;
+	int values = 4; //INTEGER and REAL values of each record
+	int repeat = 3;
+};
+
+//One record is written or read at each of the 2 ** depth leaves
+static string Program(const Options & opt, bool unformatted, bool reading) {
+	string data = opt.dir + "/iobench.dat";
+	string sub = reading ? "consume" : "produce";
+	string args = reading ? "depth, total" : "depth, n";
+	ostringstream p;
+	p << "SUBROUTINE " << sub << "(" << args << ")\n";
+	p << "\tINTEGER, INTENT(IN) :: depth\n";
+	p << (reading ? "\tREAL, INTENT(INOUT) :: total\n" : "\tINTEGER, INTENT(INOUT) :: n\n");
+	string vars, printed, sum;
+	for (int k = 1; k <= opt.values; k++) {
+		p << "\tINTEGER :: i" << k << "\n\tREAL :: r" << k << "\n";
+	}
+	for (int k = 1; k <= opt.values; k++) {
+		for (char type : {'i', 'r'}) {
+			string var = type + to_string(k);
+			vars += (vars.empty() ? "" : ", ") + var;
+			printed += (printed.empty() ? "" : ", \" \", ") + var; //PRINT puts nothing between values
+			sum += " + " + var;
+		}
+	}
+	p << "\tIF (depth > 0) THEN\n";
+	p << "\t\tCALL " << sub << "(depth - 1, " << (reading ? "total" : "n") << ")\n";
+	p << "\t\tCALL " << sub << "(depth - 1, " << (reading ? "total" : "n") << ")\n";
+	p << "\tELSE\n";
+	if (reading) {
+		p << (unformatted ? "\t\tREAD(10) " : "\t\tREAD *, ") << vars << "\n";
+		p << "\t\ttotal = total" << sum << "\n";
+	} else {
+		p << "\t\tn = n + 1\n";
+		for (int k = 1; k <= opt.values; k++) {
+			//Quarters are printed exactly with two decimals, so both pairs read the same values
+			p << "\t\ti" << k << " = n * " << k << "\n\t\tr" << k << " = n * 0.25 + " << k << "\n";
+		}
+		p << (unformatted ? "\t\tWRITE(10) " + vars : "\t\tPRINT *, " + printed) << "\n";
+	}
+	p << "\tEND IF\n";
+	p << "END SUBROUTINE " << sub << "\n\n";
+
+	p << "PROGRAM " << (reading ? "reader" : "writer") << "\n";
+	p << (reading ? "\tREAL :: total = 0.0\n" : "\tINTEGER :: n = 0\n");
+	if (unformatted) {
+		p << "\tOPEN(10, FILE = \"" << data << "\", FORM = \"UNFORMATTED\"" << (reading ? ", ACTION = \"READ\"" : "") << ")\n";
+	}
+	p << "\tCALL " << sub << "(" << opt.depth << ", " << (reading ? "total" : "n") << ")\n";
+	if (reading) {
+		p << "\tPRINT *, total\n";
+	}
+	p << "END PROGRAM " << (reading ? "reader" : "writer") << "\n";
+	return p.str();
+}
+
+//Runs the interpreter on program with its standard output going to output; returns the wall time in ms, or -1
+static double Run(const Options & opt, const vector<string> & args, const string & program, const string & output) {
+	auto start = chrono::steady_clock::now();
+	pid_t pid = fork();
+	if (pid < 0) {
+		return -1;
+	}
+	if (pid == 0) {
+		int out = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		int in = open("/dev/null", O_RDONLY);
+		if (out < 0 || in < 0) {
+			_exit(127);
+		}
+		dup2(out, STDOUT_FILENO);
+		dup2(in, STDIN_FILENO);
+		vector<char *> argv;
+		argv.push_back(const_cast<char *>(opt.interpreter.c_str()));
+		for (const string & arg : args) {
+			argv.push_back(const_cast<char *>(arg.c_str()));
+		}
+		argv.push_back(const_cast<char *>(program.c_str()));
+		argv.push_back(nullptr);
+		execv(opt.interpreter.c_str(), argv.data());
+		_exit(127);
+	}
+	int status;
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+		return -1;
+	}
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static bool WriteFile(const string & path, const string & text) {
+	ofstream out(path);
+	out << text;
+	return bool(out);
+}
+
+static string FirstLine(const string & path) {
+	ifstream in(path);
+	string line;
+	getline(in, line);
+	return line;
+}
+
+static long long FileSize(const string & path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+int main(int argc, char *argv[]) {
+	Options opt;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--interpreter" && hasValue) {
+			opt.interpreter = argv[++i];
+		} else if (arg == "--dir" && hasValue) {
+			opt.dir = argv[++i];
+		} else if (arg == "--depth" && hasValue) {
+			opt.depth = max(0, atoi(argv[++i]));
+		} else if (arg == "--values" && hasValue) {
+			opt.values = max(1, atoi(argv[++i]));
+		} else if (arg == "--repeat" && hasValue) {
+			opt.repeat = max(1, atoi(argv[++i]));
+		} else {
+			cerr << "Usage: iobench [--interpreter PATH] [--dir DIR] [--depth N] [--values N] [--repeat N]" << endl;
+			return 2;
+		}
+	}
+
+	string data = opt.dir + "/iobench.dat";
+	string result = opt.dir + "/iobench.out";
+	cout << (1LL << opt.depth) << " records of " << 2 * opt.values << " values" << endl;
+	cout << left << setw(13) << "Form" << setw(12) << "Write ms" << setw(12) << "Read ms" << setw(14) << "File bytes" << "Checksum" << endl;
+	string checksums[2];
+	for (int unformatted = 0; unformatted < 2; unformatted++) {
+		string writer = opt.dir + "/iobench_write", reader = opt.dir + "/iobench_read";
+		if (!WriteFile(writer, Program(opt, unformatted, false)) || !WriteFile(reader, Program(opt, unformatted, true))) {
+			cerr << "CANNOT WRITE PROGRAMS IN " << opt.dir << endl;
+			return 2;
+		}
+		//The formatted pair passes the data through standard output and --input
+		vector<string> writeArgs, readArgs;
+		if (!unformatted) {
+			readArgs = {"--input", data};
+		}
+		double bestWrite = 1e30, bestRead = 1e30;
+		for (int r = 0; r < opt.repeat; r++) {
+			double w = Run(opt, writeArgs, writer, unformatted ? "/dev/null" : data);
+			double rd = Run(opt, readArgs, reader, result);
+			if (w < 0 || rd < 0) {
+				cerr << "CANNOT RUN " << opt.interpreter << endl;
+				return 2;
+			}
+			bestWrite = min(bestWrite, w);
+			bestRead = min(bestRead, rd);
+		}
+		checksums[unformatted] = FirstLine(result);
+		cout << setw(13) << (unformatted ? "unformatted" : "formatted") << fixed << setprecision(1)
+			<< setw(12) << bestWrite << setw(12) << bestRead << setw(14) << FileSize(data) << checksums[unformatted] << endl;
+		unlink(writer.c_str());
+		unlink(reader.c_str());
+	}
+	unlink(data.c_str());
+	unlink(result.c_str());
+	if (checksums[0] != checksums[1]) {
+		cerr << "CHECKSUMS DIFFER" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,478 @@
+//End-to-end performance regression runner.
+//
+//Runs every program that has a matching .correct file N times, checks its output,
+//and records the minimum and median wall time, retired user-space instructions
+//(through perf_event_open, when the kernel allows it) and peak RSS. The results are
+//compared with a baseline JSON file and the runner exits with status 1 when a
+//program produces the wrong output or regresses by more than the threshold.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+struct Sample {
+	double wallMs;
+	long long instructions; //-1 when no counter is available
+	long maxRssKb;
+	string output;
+};
+
+struct Result {
+	string program;
+	bool correct;
+	double wallMin;
+	double wallMedian;
+	long long instructions; //Median, -1 when unavailable
+	long maxRssKb;
+};
+
+struct Options {
+	string interpreter = "./interpreter";
+	string baseline = "bench/baseline.json";
+	vector<string> dirs;
+	vector<string> programs;
+	vector<string> interpreterArgs; //Passed before the program, e.g. budgets whose overhead is measured
+	int runs = 5;
+	double threshold = 10.0; //Percent
+	double minWallMs = 2.0; //Wall time differences below this are treated as noise
+	bool update = false;
+};
+
+static int OpenInstructionCounter(pid_t pid) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.disabled = 1;
+	attr.enable_on_exec = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+//Runs the interpreter once on program with programArgs. The child waits on a pipe until
+//the counter is attached, so only instructions executed after exec are counted.
+static bool RunInterpreter(const Options & opt, const string & program, const vector<string> & programArgs, Sample & sample) {
+	int outPipe[2], goPipe[2];
+	if (pipe(outPipe) != 0 || pipe(goPipe) != 0) {
+		return false;
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		return false;
+	}
+	if (pid == 0) {
+		close(outPipe[0]);
+		close(goPipe[1]);
+		dup2(outPipe[1], STDOUT_FILENO);
+		dup2(outPipe[1], STDERR_FILENO);
+		//A program that READs takes its input from the file of the same name with .in appended
+		int input = open((program + ".in").c_str(), O_RDONLY);
+		if (input < 0) {
+			input = open("/dev/null", O_RDONLY);
+		}
+		if (input >= 0) {
+			dup2(input, STDIN_FILENO);
+			close(input);
+		}
+		char go;
+		if (read(goPipe[0], &go, 1) != 1) {
+			_exit(127);
+		}
+		vector<char *> args;
+		args.push_back(const_cast<char *>(opt.interpreter.c_str()));
+		for (const string & arg : programArgs) {
+			args.push_back(const_cast<char *>(arg.c_str()));
+		}
+		args.push_back(const_cast<char *>(program.c_str()));
+		args.push_back(nullptr);
+		execv(opt.interpreter.c_str(), args.data());
+		_exit(127);
+	}
+	close(outPipe[1]);
+	close(goPipe[0]);
+
+	int counter = OpenInstructionCounter(pid);
+	auto start = chrono::steady_clock::now();
+	if (write(goPipe[1], "x", 1) != 1) {
+		return false;
+	}
+	close(goPipe[1]);
+
+	sample.output.clear();
+	char buf[65536];
+	ssize_t n;
+	while ((n = read(outPipe[0], buf, sizeof(buf))) > 0) {
+		sample.output.append(buf, n);
+	}
+	close(outPipe[0]);
+
+	int status;
+	rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0) {
+		return false;
+	}
+	auto end = chrono::steady_clock::now();
+	sample.wallMs = chrono::duration<double, milli>(end - start).count();
+	sample.maxRssKb = usage.ru_maxrss;
+	sample.instructions = -1;
+	if (counter >= 0) {
+		long long count;
+		if (read(counter, &count, sizeof(count)) == sizeof(count)) {
+			sample.instructions = count;
+		}
+		close(counter);
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) != 127;
+}
+
+//Runs program once. Its own interpreter options are in the file of the same name with
+//.args appended, one line for each time the interpreter is run on it, e.g. to interrupt
+//it and then resume it; the sample adds up those runs.
+static bool RunOnce(const Options & opt, const string & program, Sample & sample) {
+	vector<string> lines;
+	ifstream argsFile((program + ".args").c_str());
+	string line;
+	while (getline(argsFile, line)) {
+		lines.push_back(line);
+	}
+	if (lines.empty()) {
+		lines.push_back("");
+	}
+	sample = Sample{0, 0, 0, ""};
+	for (const string & options : lines) {
+		vector<string> programArgs = opt.interpreterArgs;
+		istringstream words(options);
+		string arg;
+		while (words >> arg) {
+			programArgs.push_back(arg);
+		}
+		Sample run;
+		if (!RunInterpreter(opt, program, programArgs, run)) {
+			return false;
+		}
+		sample.wallMs += run.wallMs;
+		sample.instructions = sample.instructions < 0 || run.instructions < 0 ? -1 : sample.instructions + run.instructions;
+		sample.maxRssKb = max(sample.maxRssKb, run.maxRssKb);
+		sample.output += run.output;
+	}
+	return true;
+}
+
+//Trailing whitespace on each line and trailing blank lines are not significant
+static string Normalize(const string & text) {
+	istringstream in(text);
+	string line, result, pending;
+	while (getline(in, line)) {
+		line.erase(line.find_last_not_of(" \t\r") + 1);
+		if (line.empty()) {
+			pending += "\n";
+			continue;
+		}
+		result += pending + line + "\n";
+		pending.clear();
+	}
+	return result;
+}
+
+static bool ReadFile(const string & path, string & text) {
+	ifstream file(path.c_str(), ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	ostringstream contents;
+	contents << file.rdbuf();
+	text = contents.str();
+	return true;
+}
+
+static double Median(vector<double> values) {
+	sort(values.begin(), values.end());
+	size_t mid = values.size() / 2;
+	return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+//Programs in dir that have a matching .correct file, in natural order (test2 before test10)
+static vector<string> Discover(const string & dir) {
+	vector<string> found;
+	DIR * d = opendir(dir.c_str());
+	if (d == NULL) {
+		return found;
+	}
+	while (dirent * entry = readdir(d)) {
+		string name = entry->d_name;
+		if (name[0] == '.' || (name.size() > 8 && name.compare(name.size() - 8, 8, ".correct") == 0)) {
+			continue;
+		}
+		string path = dir + "/" + name;
+		if (access((path + ".correct").c_str(), R_OK) == 0) {
+			found.push_back(path);
+		}
+	}
+	closedir(d);
+	sort(found.begin(), found.end(), [](const string & a, const string & b) {
+		size_t i = a.find_first_of("0123456789"), j = b.find_first_of("0123456789");
+		if (i != string::npos && i == j && a.compare(0, i, b, 0, j) == 0) {
+			return atol(a.c_str() + i) != atol(b.c_str() + j) ? atol(a.c_str() + i) < atol(b.c_str() + j) : a < b;
+		}
+		return a < b;
+	});
+	return found;
+}
+
+//Just enough JSON to read back the files written by WriteBaseline
+class JsonReader {
+	const string & text;
+	size_t pos;
+
+	void Skip() {
+		while (pos < text.size() && isspace((unsigned char) text[pos])) {
+			pos++;
+		}
+	}
+	string String() {
+		string s;
+		pos++;
+		while (pos < text.size() && text[pos] != '"') {
+			if (text[pos] == '\\' && pos + 1 < text.size()) {
+				pos++;
+			}
+			s += text[pos++];
+		}
+		pos++;
+		return s;
+	}
+
+public:
+	explicit JsonReader(const string & t) : text(t), pos(0) {}
+
+	//Reads { "program": { "field": number, ... }, ... } nested under "programs"
+	bool Programs(map<string, map<string, double> > & programs) {
+		size_t at = text.find("\"programs\"");
+		if (at == string::npos) {
+			return false;
+		}
+		pos = text.find('{', at);
+		if (pos == string::npos) {
+			return false;
+		}
+		pos++;
+		while (true) {
+			Skip();
+			if (pos >= text.size()) {
+				return false;
+			}
+			if (text[pos] == '}') {
+				return true;
+			}
+			if (text[pos] == ',') {
+				pos++;
+				continue;
+			}
+			string program = String();
+			Skip();
+			pos++; //:
+			Skip();
+			pos++; //{
+			map<string, double> & fields = programs[program];
+			while (true) {
+				Skip();
+				if (pos >= text.size()) {
+					return false;
+				}
+				if (text[pos] == '}') {
+					pos++;
+					break;
+				}
+				if (text[pos] == ',') {
+					pos++;
+					continue;
+				}
+				string field = String();
+				Skip();
+				pos++; //:
+				Skip();
+				if (text.compare(pos, 4, "null") == 0) {
+					pos += 4;
+					continue;
+				}
+				char * end;
+				fields[field] = strtod(text.c_str() + pos, &end);
+				pos = end - text.c_str();
+			}
+		}
+	}
+};
+
+static void WriteBaseline(const Options & opt, const vector<Result> & results) {
+	ofstream out(opt.baseline.c_str());
+	out << "{\n  \"runs\": " << opt.runs << ",\n  \"programs\": {\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result & r = results[i];
+		out << "    \"" << r.program << "\": {\"wall_min_ms\": " << r.wallMin << ", \"wall_median_ms\": " << r.wallMedian << ", \"instructions\": ";
+		if (r.instructions < 0) {
+			out << "null";
+		} else {
+			out << r.instructions;
+		}
+		out << ", \"max_rss_kb\": " << r.maxRssKb << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  }\n}\n";
+}
+
+//Returns a description of each metric that got worse than the baseline allows
+static vector<string> Regressions(const Options & opt, const Result & r, map<string, double> & base) {
+	vector<string> found;
+	double limit = 1 + opt.threshold / 100;
+	if (base.count("wall_median_ms") && r.wallMedian > base["wall_median_ms"] * limit && r.wallMedian - base["wall_median_ms"] > opt.minWallMs) {
+		found.push_back("wall median " + to_string(r.wallMedian) + " ms vs " + to_string(base["wall_median_ms"]) + " ms");
+	}
+	if (base.count("instructions") && r.instructions >= 0 && r.instructions > base["instructions"] * limit) {
+		found.push_back("instructions " + to_string(r.instructions) + " vs " + to_string((long long) base["instructions"]));
+	}
+	if (base.count("max_rss_kb") && r.maxRssKb > base["max_rss_kb"] * limit) {
+		found.push_back("peak RSS " + to_string(r.maxRssKb) + " KB vs " + to_string((long) base["max_rss_kb"]) + " KB");
+	}
+	return found;
+}
+
+static void Usage() {
+	cerr << "Usage: runner [--interpreter PATH] [--runs N] [--threshold PERCENT] [--min-wall-ms MS]" << endl
+		<< "              [--baseline FILE] [--update] [--arg ARG]... [--dir DIR]... [PROGRAM]..." << endl;
+}
+
+int main(int argc, char * argv[]) {
+	Options opt;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--interpreter" && hasValue) {
+			opt.interpreter = argv[++i];
+		} else if (arg == "--runs" && hasValue) {
+			opt.runs = max(1, atoi(argv[++i]));
+		} else if (arg == "--threshold" && hasValue) {
+			opt.threshold = atof(argv[++i]);
+		} else if (arg == "--min-wall-ms" && hasValue) {
+			opt.minWallMs = atof(argv[++i]);
+		} else if (arg == "--baseline" && hasValue) {
+			opt.baseline = argv[++i];
+		} else if (arg == "--update") {
+			opt.update = true;
+		} else if (arg == "--arg" && hasValue) {
+			opt.interpreterArgs.push_back(argv[++i]);
+		} else if (arg == "--dir" && hasValue) {
+			opt.dirs.push_back(argv[++i]);
+		} else if (arg[0] != '-') {
+			opt.programs.push_back(arg);
+		} else {
+			Usage();
+			return 2;
+		}
+	}
+	if (opt.dirs.empty() && opt.programs.empty()) {
+		opt.dirs.push_back("test");
+	}
+	for (const string & dir : opt.dirs) {
+		vector<string> found = Discover(dir);
+		opt.programs.insert(opt.programs.end(), found.begin(), found.end());
+	}
+	if (opt.programs.empty()) {
+		cerr << "NO PROGRAMS FOUND" << endl;
+		return 2;
+	}
+
+	map<string, map<string, double> > baseline;
+	string baselineText;
+	bool haveBaseline = !opt.update && ReadFile(opt.baseline, baselineText) && JsonReader(baselineText).Programs(baseline);
+	if (!opt.update && !haveBaseline) {
+		cerr << "No baseline at " << opt.baseline << ", reporting measurements only" << endl;
+	}
+
+	vector<Result> results;
+	int failures = 0;
+	bool countersSeen = false;
+	for (const string & program : opt.programs) {
+		string expected;
+		if (!ReadFile(program + ".correct", expected)) {
+			cerr << "CANNOT OPEN " << program << ".correct" << endl;
+			return 2;
+		}
+		expected = Normalize(expected);
+
+		Result r;
+		r.program = program;
+		r.correct = true;
+		r.maxRssKb = 0;
+		vector<double> walls, instructions;
+		for (int run = 0; run < opt.runs; run++) {
+			Sample sample;
+			if (!RunOnce(opt, program, sample)) {
+				cerr << "CANNOT RUN " << opt.interpreter << endl;
+				return 2;
+			}
+			r.correct = r.correct && Normalize(sample.output) == expected;
+			walls.push_back(sample.wallMs);
+			if (sample.instructions >= 0) {
+				instructions.push_back(sample.instructions);
+			}
+			r.maxRssKb = max(r.maxRssKb, sample.maxRssKb);
+		}
+		r.wallMin = *min_element(walls.begin(), walls.end());
+		r.wallMedian = Median(walls);
+		r.instructions = instructions.size() == walls.size() ? (long long) Median(instructions) : -1;
+		countersSeen = countersSeen || r.instructions >= 0;
+		results.push_back(r);
+
+		cout << program << ": wall min " << r.wallMin << " ms, median " << r.wallMedian << " ms, instructions ";
+		if (r.instructions < 0) {
+			cout << "n/a";
+		} else {
+			cout << r.instructions;
+		}
+		cout << ", peak RSS " << r.maxRssKb << " KB";
+		if (!r.correct) {
+			cout << "  WRONG OUTPUT";
+			failures++;
+		}
+		cout << endl;
+		if (haveBaseline) {
+			if (!baseline.count(program)) {
+				cout << "  not in baseline" << endl;
+				continue;
+			}
+			for (const string & regression : Regressions(opt, r, baseline[program])) {
+				cout << "  REGRESSION: " << regression << endl;
+				failures++;
+			}
+		}
+	}
+	if (!countersSeen) {
+		cerr << "Instruction counts unavailable (perf_event_open not permitted)" << endl;
+	}
+
+	if (opt.update) {
+		WriteBaseline(opt, results);
+		cout << "Baseline written to " << opt.baseline << endl;
+	}
+	cout << results.size() << " programs, " << failures << " failures" << endl;
+	return failures == 0 ? 0 : 1;
+}
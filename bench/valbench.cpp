@@ -0,0 +1,95 @@
+//Microbenchmark of the binary Value operators.
+//
+//Times every operator on every pair of operand types, including the pairs that
+//only produce an error value, over small arrays of operands so that the loop
+//measures the dispatch and the arithmetic rather than memory. Prints the best
+//time per operation of several repetitions.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include "../src/val.h"
+
+using namespace std;
+
+struct Operator {
+	const char * name;
+	Value (*apply)(const Value &, const Value &);
+};
+
+static const Operator operators[] = {
+	{"+", [](const Value & a, const Value & b) { return a + b; }},
+	{"-", [](const Value & a, const Value & b) { return a - b; }},
+	{"*", [](const Value & a, const Value & b) { return a * b; }},
+	{"/", [](const Value & a, const Value & b) { return a / b; }},
+	{"**", [](const Value & a, const Value & b) { return a.Power(b); }},
+	{"==", [](const Value & a, const Value & b) { return a == b; }},
+	{"<", [](const Value & a, const Value & b) { return a < b; }},
+	{">", [](const Value & a, const Value & b) { return a > b; }},
+};
+
+static const int operand_count = 1024;
+
+//Operands of one type, all different from zero so that division is defined
+static vector<Value> Operands(ValType type) {
+	vector<Value> values;
+	for (int i = 0; i < operand_count; i++) {
+		if (type == VINT) {
+			values.push_back(Value(i % 7 + 1));
+		} else if (type == VREAL) {
+			values.push_back(Value(i % 5 + 1.5));
+		} else {
+			values.push_back(Value(string(i % 3 + 4, 'a' + i % 26)));
+		}
+	}
+	return values;
+}
+
+static const char * TypeName(ValType type) {
+	return type == VINT ? "INTEGER" : type == VREAL ? "REAL" : "CHARACTER";
+}
+
+int main(int argc, char *argv[]) {
+	long long iterations = 10000000;
+	int repeat = 5;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--iterations" && i + 1 < argc) {
+			iterations = atoll(argv[++i]);
+		} else if (arg == "--repeat" && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+		} else {
+			cerr << "Usage: valbench [--iterations N] [--repeat N]" << endl;
+			return 1;
+		}
+	}
+
+	const ValType types[] = {VINT, VREAL, VSTRING};
+	long long sink = 0;
+	cout << left << setw(4) << "Op" << setw(24) << "Operands" << "ns/op" << endl;
+	for (const Operator & op : operators) {
+		for (ValType lhs : types) {
+			for (ValType rhs : types) {
+				vector<Value> a = Operands(lhs), b = Operands(rhs);
+				double best = 1e30;
+				for (int r = 0; r < repeat; r++) {
+					auto start = chrono::steady_clock::now();
+					for (long long i = 0; i < iterations; i++) {
+						Value result = op.apply(a[i % operand_count], b[(i * 7) % operand_count]);
+						sink += result.GetType();
+					}
+					chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+					best = min(best, elapsed.count() / iterations);
+				}
+				string pair = string(TypeName(lhs)) + ", " + TypeName(rhs);
+				cout << left << setw(4) << op.name << setw(24) << pair << fixed << setprecision(2) << best << endl;
+			}
+		}
+	}
+	return sink == 42 ? 2 : 0; //Keeps the results alive
+}
@@ -0,0 +1,221 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <unistd.h>
+
+#include "batch.h"
+#include "interpreter.h"
+#include "lockstep.h"
+
+//Rows run side by side in lock-step by one thread
+static const size_t lockstep_width = 256;
+
+//Splits a CSV record at its commas. A field in double quotes may hold commas and
+//doubled quotes; blanks around an unquoted field are dropped.
+static bool SplitRecord(const string & line, vector<Field> & fields) {
+	fields.clear();
+	size_t i = 0;
+	while (true) {
+		while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) {
+			i++;
+		}
+		Field field = {"", false};
+		if (i < line.size() && line[i] == '"') {
+			field.quoted = true;
+			for (i++; ; i++) {
+				if (i >= line.size()) {
+					return false;
+				}
+				if (line[i] == '"') {
+					if (i + 1 < line.size() && line[i + 1] == '"') {
+						i++;
+					} else {
+						i++;
+						break;
+					}
+				}
+				field.text += line[i];
+			}
+			while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) {
+				i++;
+			}
+		} else {
+			size_t end = line.find(',', i);
+			field.text = line.substr(i, end == string::npos ? string::npos : end - i);
+			field.text.erase(field.text.find_last_not_of(" \t") + 1);
+			i = end == string::npos ? line.size() : end;
+		}
+		fields.push_back(field);
+		if (i >= line.size()) {
+			return true;
+		}
+		if (line[i] != ',') {
+			return false;
+		}
+		i++;
+	}
+}
+
+static bool ReadBindings(const string & csvPath, vector<string> & names, vector<vector<Field>> & rows) {
+	ifstream csv(csvPath.c_str());
+	if (!csv.is_open()) {
+		cerr << "CANNOT OPEN " << csvPath << endl;
+		return false;
+	}
+	string line;
+	int lineNumber = 0;
+	vector<Field> fields;
+	while (getline(csv, line)) {
+		lineNumber++;
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.find_first_not_of(" \t") == string::npos) {
+			continue;
+		}
+		if (!SplitRecord(line, fields)) {
+			cerr << "INVALID CSV RECORD ON LINE " << lineNumber << " OF " << csvPath << endl;
+			return false;
+		}
+		if (names.empty()) {
+			for (const Field & f : fields) {
+				if (f.text.empty()) {
+					cerr << "MISSING VARIABLE NAME IN " << csvPath << endl;
+					return false;
+				}
+				names.push_back(f.text);
+			}
+		} else if (fields.size() != names.size()) {
+			cerr << "WRONG NUMBER OF VALUES ON LINE " << lineNumber << " OF " << csvPath << endl;
+			return false;
+		} else {
+			rows.push_back(fields);
+		}
+	}
+	if (names.empty()) {
+		cerr << "MISSING VARIABLE NAMES IN " << csvPath << endl;
+		return false;
+	}
+	return true;
+}
+
+//Runs work on count threads, the calling one among them
+static void OnThreads(size_t count, const function<void()> & work) {
+	vector<thread> pool;
+	for (size_t t = 1; t < count; t++) {
+		pool.emplace_back(work);
+	}
+	work();
+	for (thread & t : pool) {
+		t.join();
+	}
+}
+
+int RunBatch(const string & path, const string & csvPath, unsigned threads) {
+	ifstream src(path.c_str());
+	if (!src.is_open()) {
+		cerr << "CANNOT OPEN " << path << endl;
+		return 0;
+	}
+	vector<string> names;
+	vector<vector<Field>> rows;
+	if (!ReadBindings(csvPath, names, rows)) {
+		return 0;
+	}
+	//Every run reads the same tokens
+	vector<LexItem> tokens;
+	int line = 1;
+	Tokenize(src, line, tokens);
+	string input = path + ".in";
+	if (access(input.c_str(), R_OK) != 0) {
+		input = "/dev/null";
+	}
+
+	mutex lock;
+	int worst = 0;
+	set<string> declared; //Bound names some run has declared
+	//Rows the lock-step runs did not finish, or all of them, are then run one at a time
+	vector<size_t> alone;
+	LockstepProgram * lockstep = BudgetsSet() ? nullptr : CompileLockstep(tokens, names, MaxDepth());
+	if (lockstep == nullptr) {
+		for (size_t row = 0; row < rows.size(); row++) {
+			alone.push_back(row);
+		}
+	} else {
+		atomic<size_t> nextChunk(0);
+		bool finishedAny = false;
+		auto chunkWorker = [&]() {
+			vector<string> output;
+			vector<char> finished;
+			vector<size_t> left;
+			for (size_t first = nextChunk.fetch_add(lockstep_width); first < rows.size(); first = nextChunk.fetch_add(lockstep_width)) {
+				size_t last = min(rows.size(), first + lockstep_width);
+				RunLockstep(*lockstep, rows, first, last, output, finished);
+				left.clear();
+				for (size_t row = first; row < last; row++) {
+					if (finished[row - first]) {
+						ofstream out((path + "." + to_string(row + 1) + ".out").c_str());
+						out << output[row - first];
+					} else {
+						left.push_back(row);
+					}
+				}
+				lock_guard<mutex> guard(lock);
+				alone.insert(alone.end(), left.begin(), left.end());
+				finishedAny = finishedAny || left.size() < last - first;
+			}
+		};
+		OnThreads(min<size_t>(threads, (rows.size() + lockstep_width - 1) / lockstep_width), chunkWorker);
+		for (const string & name : names) {
+			if (finishedAny && LockstepDeclares(*lockstep, name)) {
+				declared.insert(name);
+			}
+		}
+		DeleteLockstep(lockstep);
+		sort(alone.begin(), alone.end());
+	}
+
+	atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t at = next++; at < alone.size(); at = next++) {
+			size_t row = alone[at];
+			ofstream out((path + "." + to_string(row + 1) + ".out").c_str());
+			ProgramContext * context = NewProgram(out, input);
+			for (size_t i = 0; i < names.size(); i++) {
+				BindVariable(context, names[i], rows[row][i].text, rows[row][i].quoted);
+			}
+			istringstream none;
+			int status;
+			try {
+				status = RunProgram(context, none, &tokens);
+			} catch (const char * msg) {
+				out << msg << endl;
+				status = 1;
+			}
+			vector<string> undeclared = UnusedBindings(context);
+			DeleteProgram(context);
+			lock_guard<mutex> guard(lock);
+			worst = max(worst, status);
+			for (const string & name : names) {
+				if (find(undeclared.begin(), undeclared.end(), name) == undeclared.end()) {
+					declared.insert(name);
+				}
+			}
+		}
+	};
+	OnThreads(min<size_t>(threads, alone.size()), worker);
+	for (const string & name : names) {
+		if (declared.count(name) || rows.empty()) {
+			continue;
+		}
+		cerr << "VARIABLE " << name << " OF " << csvPath << " IS NOT DECLARED BY THE PROGRAM" << endl;
+	}
+	return worst;
+}
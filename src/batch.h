@@ -0,0 +1,15 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <string>
+
+using namespace std;
+
+//Runs one program once for every row of a CSV file. The first row names program
+//variables; each following row gives them initial values in place of the ones they
+//are declared with. The program is lexed once and the runs are spread over threads,
+//each with its own variables and output: the output of row N goes to the program
+//file name with .N.out appended. Returns the highest exit status among the runs.
+extern int RunBatch(const string & path, const string & csvPath, unsigned threads);
+
+#endif
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <utility>
+#include <cstring>
+
+#include "bitarray.h"
+
+BitArray::BitArray(size_t size, bool value) : words(WordCount(size), value ? ~uint64_t(0) : 0), size(size) {
+	ClearTail();
+}
+
+BitArray::BitArray(size_t size, vector<uint64_t> words) : words(move(words)), size(size) {
+	this->words.resize(WordCount(size));
+	ClearTail();
+}
+
+void BitArray::ClearTail() {
+	if (size % 64 != 0) {
+		words.back() &= (uint64_t(1) << (size % 64)) - 1;
+	}
+}
+
+void BitArray::Fill(bool value) {
+	fill(words.begin(), words.end(), value ? ~uint64_t(0) : 0);
+	ClearTail();
+}
+
+void BitArray::LoadWords(const char * from) {
+	memcpy(words.data(), from, words.size() * sizeof(uint64_t));
+	ClearTail();
+}
+
+void BitArray::And(const BitArray & other) {
+	for (size_t w = 0; w < words.size(); w++) {
+		words[w] &= other.words[w];
+	}
+}
+
+void BitArray::Or(const BitArray & other) {
+	for (size_t w = 0; w < words.size(); w++) {
+		words[w] |= other.words[w];
+	}
+}
+
+void BitArray::Not() {
+	for (uint64_t & word : words) {
+		word = ~word;
+	}
+	ClearTail();
+}
+
+size_t BitArray::Count() const {
+	size_t count = 0;
+	for (uint64_t word : words) {
+		count += __builtin_popcountll(word);
+	}
+	return count;
+}
+
+bool BitArray::Any() const {
+	for (uint64_t word : words) {
+		if (word != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool BitArray::All() const {
+	if (words.empty()) {
+		return true;
+	}
+	for (size_t w = 0; w + 1 < words.size(); w++) {
+		if (words[w] != ~uint64_t(0)) {
+			return false;
+		}
+	}
+	size_t tail = size % 64;
+	return words.back() == (tail == 0 ? ~uint64_t(0) : (uint64_t(1) << tail) - 1);
+}
@@ -0,0 +1,49 @@
+#ifndef BITARRAY_H_
+#define BITARRAY_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+//Elements of a LOGICAL array, one bit each and 64 to a word. The bits past the last
+//element are kept clear, so that whole words can be combined, counted and compared
+//without looking at where the array ends.
+class BitArray {
+	vector<uint64_t> words;
+	size_t size;
+
+	static size_t WordCount(size_t size) { return (size + 63) / 64; }
+	void ClearTail();
+
+public:
+	BitArray() : size(0) {}
+	explicit BitArray(size_t size, bool value = false);
+	//An array of size elements stored in words, as Words returned them
+	BitArray(size_t size, vector<uint64_t> words);
+
+	size_t Size() const { return size; }
+	const vector<uint64_t> & Words() const { return words; }
+	size_t Bytes() const { return words.capacity() * sizeof(uint64_t); }
+
+	bool Get(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+	void Set(size_t i, bool value) {
+		uint64_t bit = uint64_t(1) << (i % 64);
+		words[i / 64] = (words[i / 64] & ~bit) | (-uint64_t(value) & bit);
+	}
+
+	void Fill(bool value);
+	//Copies the elements from bytes laid out as Words holds them
+	void LoadWords(const char * from);
+	//Element-wise, with an array of the same size
+	void And(const BitArray & other);
+	void Or(const BitArray & other);
+	void Not();
+
+	size_t Count() const;
+	bool Any() const;
+	bool All() const;
+};
+
+#endif
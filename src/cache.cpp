@@ -0,0 +1,124 @@
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "checkpoint.h"
+
+static const char * const cache_magic = "SF95MEMO";
+static const uint64_t cache_version = 1;
+
+//Changes whenever the interpreter is rebuilt or replaced, as its output may change with it
+static string InterpreterIdentity() {
+	struct stat st;
+	if (stat("/proc/self/exe", &st) != 0) {
+		return __DATE__ " " __TIME__;
+	}
+	return to_string(st.st_dev) + ":" + to_string(st.st_ino) + ":" + to_string(st.st_size) + ":"
+		+ to_string(st.st_mtim.tv_sec) + "." + to_string(st.st_mtim.tv_nsec);
+}
+
+//FNV-1a with a 128-bit state
+static void Hash(unsigned __int128 & hash, const string & data) {
+	const unsigned __int128 prime = ((unsigned __int128) 1 << 88) + 0x13b;
+	for (unsigned char c : data) {
+		hash = (hash ^ c) * prime;
+	}
+}
+
+string ResultCache::Key(const string & source, const string & config) {
+	unsigned __int128 hash = ((unsigned __int128) 0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+	Hash(hash, InterpreterIdentity());
+	//The lengths keep the boundaries between the parts from moving
+	Hash(hash, string(1, '\0') + to_string(config.size()) + '\0' + config);
+	Hash(hash, to_string(source.size()) + '\0' + source);
+	char hex[33];
+	snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long) (hash >> 64), (unsigned long long) hash);
+	return hex;
+}
+
+string ResultCache::Path(const string & key) const {
+	return dir + "/" + key;
+}
+
+bool ResultCache::Lookup(const string & key, string & output, int & status) const {
+	CheckpointReader r;
+	if (!r.Open(Path(key))) {
+		return false;
+	}
+	if (r.Str() != cache_magic || r.U64() != cache_version || r.Str() != key) {
+		return false;
+	}
+	status = (int) r.I64();
+	output = r.Str();
+	if (!r.Good()) {
+		return false;
+	}
+	//Marks the entry as used for the eviction order; a failure only makes it look older
+	utimensat(AT_FDCWD, Path(key).c_str(), nullptr, 0);
+	return true;
+}
+
+void ResultCache::Store(const string & key, const string & output, int status) const {
+	CheckpointWriter w;
+	w.Str(cache_magic);
+	w.U64(cache_version);
+	w.Str(key);
+	w.I64(status);
+	w.Str(output);
+	if ((long long) w.Data().size() > limit) {
+		return;
+	}
+	mkdir(dir.c_str(), 0755);
+	if (w.Commit(Path(key))) {
+		Evict();
+	}
+}
+
+struct Entry {
+	string path;
+	long long size;
+	struct timespec used;
+};
+
+//Removes the least recently used entries until the rest fit in the limit. Processes
+//evicting at the same time may remove an entry twice, which is harmless, and a
+//process reading an entry as it is removed keeps reading the open file.
+void ResultCache::Evict() const {
+	DIR * d = opendir(dir.c_str());
+	if (d == nullptr) {
+		return;
+	}
+	vector<Entry> entries;
+	long long total = 0;
+	while (struct dirent * e = readdir(d)) {
+		string name = e->d_name;
+		//Only entries: temporary files of writers that have not renamed yet are left alone
+		if (name.size() != 32 || name.find_first_not_of("0123456789abcdef") != string::npos) {
+			continue;
+		}
+		struct stat st;
+		if (stat(Path(name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+			entries.push_back({Path(name), (long long) st.st_size, st.st_mtim});
+			total += st.st_size;
+		}
+	}
+	closedir(d);
+	if (total <= limit) {
+		return;
+	}
+	sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) {
+		return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+	});
+	for (const Entry & entry : entries) {
+		if (total <= limit) {
+			break;
+		}
+		unlink(entry.path.c_str());
+		total -= entry.size;
+	}
+}
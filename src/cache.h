@@ -0,0 +1,30 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <string>
+
+using namespace std;
+
+//Directory of the outputs and exit statuses of earlier runs, behind --cache. An entry
+//is named after a 128-bit hash of the program's source, the options it ran with and
+//the interpreter binary, and is written to a temporary file renamed into place, so
+//that processes sharing the directory only ever see whole entries. A hit refreshes
+//the entry's modification time, and the least recently used entries are removed
+//once the entries together take more than the size limit.
+class ResultCache {
+	string dir;
+	long long limit;
+
+	string Path(const string & key) const;
+	void Evict() const;
+
+public:
+	ResultCache(const string & dir, long long limit) : dir(dir), limit(limit) {}
+
+	static string Key(const string & source, const string & config);
+
+	bool Lookup(const string & key, string & output, int & status) const;
+	void Store(const string & key, const string & output, int status) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "check.h"
+#include "interpreter.h"
+
+int CheckFiles(const vector<string> & files, unsigned threads, ostream & out) {
+	vector<string> reports(files.size());
+	vector<char> failed(files.size(), false);
+	vector<char> missing(files.size(), false);
+	atomic<size_t> next(0);
+
+	auto worker = [&]() {
+		for (size_t i = next++; i < files.size(); i = next++) {
+			ostringstream diagnostics;
+			ifstream file(files[i].c_str());
+			if (!file.is_open()) {
+				failed[i] = missing[i] = true;
+				continue;
+			}
+			failed[i] = CheckProgram(file, diagnostics) > 0;
+			reports[i] = diagnostics.str();
+		}
+	};
+	threads = max(1u, min<unsigned>(threads, files.size()));
+	vector<thread> pool;
+	for (unsigned t = 1; t < threads; t++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (thread & t : pool) {
+		t.join();
+	}
+
+	int failures = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		failures += failed[i];
+		if (missing[i]) {
+			out << "CANNOT OPEN " << files[i] << "\n";
+			continue;
+		}
+		if (files.size() == 1) {
+			out << reports[i];
+			continue;
+		}
+		istringstream lines(reports[i]);
+		string text;
+		while (getline(lines, text)) {
+			out << files[i] << ":" << text << "\n";
+		}
+	}
+	out.flush();
+	return failures;
+}
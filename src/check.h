@@ -0,0 +1,16 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+using namespace std;
+
+//Checks every program file without executing it, spreading the files over threads.
+//The diagnostics are written to out in the order of the files; with more than one
+//file each line starts with the name of the file it is about. Returns the number of
+//files with errors.
+extern int CheckFiles(const vector<string> & files, unsigned threads, ostream & out);
+
+#endif
@@ -0,0 +1,118 @@
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+void CheckpointWriter::U64(uint64_t v) {
+	while (v >= 0x80) {
+		data += (char) (v | 0x80);
+		v >>= 7;
+	}
+	data += (char) v;
+}
+
+void CheckpointWriter::I64(int64_t v) {
+	U64(((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+void CheckpointWriter::F64(double v) {
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	for (int i = 0; i < 8; i++) {
+		data += (char) (bits >> (8 * i));
+	}
+}
+
+void CheckpointWriter::Str(const string & s) {
+	U64(s.size());
+	data += s;
+}
+
+bool CheckpointWriter::Commit(const string & path) const {
+	string temp = path + ".tmp." + to_string(getpid()); //Processes writing the same path do not share it
+	{
+		ofstream out(temp.c_str(), ios::binary | ios::trunc);
+		if (!out.write(data.data(), data.size()).flush()) {
+			return false;
+		}
+	}
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+bool CheckpointReader::Open(const string & path) {
+	ifstream in(path.c_str(), ios::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+	ostringstream buf;
+	buf << in.rdbuf();
+	data = buf.str();
+	pos = 0;
+	failed = false;
+	return true;
+}
+
+uint64_t CheckpointReader::U64() {
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos >= data.size()) {
+			failed = true;
+			return 0;
+		}
+		unsigned char byte = data[pos++];
+		v |= (uint64_t) (byte & 0x7f) << shift;
+		if (byte < 0x80) {
+			return v;
+		}
+	}
+	failed = true;
+	return 0;
+}
+
+int64_t CheckpointReader::I64() {
+	uint64_t v = U64();
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+double CheckpointReader::F64() {
+	if (data.size() - pos < 8) {
+		failed = true;
+		return 0.0;
+	}
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++) {
+		bits |= (uint64_t) (unsigned char) data[pos++] << (8 * i);
+	}
+	double v;
+	memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+string CheckpointReader::Str() {
+	uint64_t len = U64();
+	if (failed || data.size() - pos < len) {
+		failed = true;
+		return "";
+	}
+	string s = data.substr(pos, len);
+	pos += len;
+	return s;
+}
+
+uint64_t HashFile(const string & path) {
+	ifstream in(path.c_str(), ios::binary);
+	if (!in.is_open()) {
+		return 0;
+	}
+	uint64_t hash = 14695981039346656037ULL;
+	char buf[65536];
+	while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+		for (streamsize i = 0; i < in.gcount(); i++) {
+			hash = (hash ^ (unsigned char) buf[i]) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+//Little-endian binary encoding of a checkpoint. Integers are written as varints,
+//so the small counts and line numbers that make up most of it take a byte or two.
+class CheckpointWriter {
+	string data;
+
+public:
+	void U64(uint64_t v);
+	void I64(int64_t v); //Zigzag encoded
+	void F64(double v);
+	void Str(const string & s);
+
+	//Writes the checkpoint next to path and renames it over path, so a crash
+	//while writing leaves the previous checkpoint intact and readers of path,
+	//in this process or another, never see a partly written one
+	bool Commit(const string & path) const;
+
+	const string & Data() const { return data; }
+};
+
+class CheckpointReader {
+	string data;
+	size_t pos;
+	bool failed;
+
+public:
+	CheckpointReader() : pos(0), failed(false) {}
+	//Reads data encoded in memory, e.g. one CheckpointWriter nested in another
+	explicit CheckpointReader(const string & data) : data(data), pos(0), failed(false) {}
+
+	bool Open(const string & path);
+
+	uint64_t U64();
+	int64_t I64();
+	double F64();
+	string Str();
+
+	//False once a read has run past the end of the data
+	bool Good() const { return !failed; }
+};
+
+//FNV-1a hash of a file's contents, 0 when it cannot be read
+extern uint64_t HashFile(const string & path);
+
+#endif
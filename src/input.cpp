@@ -0,0 +1,174 @@
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "input.h"
+
+static const size_t block_size = 1 << 20;
+
+InputReader::InputReader() : fd(-1), owned(false), mapped(false), exhausted(true), data(nullptr), size(0), pos(0), consumed(0), record(1), inRecord(false) {
+}
+
+InputReader::~InputReader() {
+	if (mapped) {
+		munmap(const_cast<char *>(data), size);
+	}
+	if (owned) {
+		close(fd);
+	}
+}
+
+bool InputReader::Open(const string & name) {
+	if (name.empty()) {
+		fd = STDIN_FILENO;
+	} else {
+		fd = open(name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		owned = true;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void * map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			data = static_cast<const char *>(map);
+			size = st.st_size;
+			mapped = true;
+			return true;
+		}
+	}
+	block.resize(block_size);
+	data = block.data();
+	exhausted = false;
+	return true;
+}
+
+//Moves the unread bytes to the front of the block and reads more after them
+bool InputReader::Fill() {
+	if (exhausted) {
+		return false;
+	}
+	size_t keep = size - pos;
+	consumed += pos;
+	memmove(block.data(), block.data() + pos, keep);
+	pos = 0;
+	size = keep;
+	if (size == block.size()) { //A single value longer than the block
+		block.resize(block.size() * 2);
+	}
+	data = block.data();
+	for (;;) {
+		ssize_t n = read(fd, block.data() + size, block.size() - size);
+		if (n > 0) {
+			size += n;
+			return true;
+		}
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		exhausted = true;
+		return false;
+	}
+}
+
+bool InputReader::SkipSeparators() {
+	for (;;) {
+		while (pos < size) {
+			char c = data[pos];
+			if (c == '\n') {
+				record++;
+			} else if (c != ' ' && c != ',' && c != '\t' && c != '\r') {
+				return true;
+			}
+			pos++;
+		}
+		if (!Fill()) {
+			return false;
+		}
+	}
+}
+
+void InputReader::NextRecord() {
+	if (!inRecord) {
+		return;
+	}
+	inRecord = false;
+	for (;;) {
+		const char * newline = static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+		if (newline != nullptr) {
+			pos = newline - data + 1;
+			record++;
+			return;
+		}
+		pos = size;
+		if (!Fill()) {
+			return;
+		}
+	}
+}
+
+bool InputReader::NextField(string_view & field, bool & quoted) {
+	if (!SkipSeparators()) {
+		return false;
+	}
+	inRecord = true;
+	char quote = data[pos];
+	quoted = quote == '\'' || quote == '"';
+	size_t start = pos + (quoted ? 1 : 0);
+	size_t end = start;
+	for (;;) {
+		while (end < size) {
+			char c = data[end];
+			if (quoted ? (c == quote || c == '\n') : (c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n')) {
+				break;
+			}
+			end++;
+		}
+		if (end < size) {
+			break;
+		}
+		size_t offset = pos;
+		if (!Fill()) {
+			break;
+		}
+		start -= offset;
+		end -= offset;
+	}
+	field = string_view(data + start, end - start);
+	pos = end;
+	if (quoted && pos < size && data[pos] == quote) {
+		pos++;
+	}
+	return true;
+}
+
+bool InputReader::Seek(long long offset, int line, bool midRecord) {
+	record = line;
+	inRecord = midRecord;
+	if (mapped) {
+		if (offset > (long long) size) {
+			return false;
+		}
+		pos = offset;
+		return true;
+	}
+	if (lseek(fd, offset, SEEK_SET) == offset) {
+		consumed = offset;
+		pos = size = 0;
+		return true;
+	}
+	//A pipe: read up to the offset and drop what comes before it
+	while (consumed + (long long) size < offset) {
+		pos = size;
+		if (!Fill()) {
+			return false;
+		}
+	}
+	pos = offset - consumed;
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+//List-directed input for READ. A regular file is mapped into memory whole; any
+//other input (a pipe or a terminal) is read in large blocks. Values are separated
+//by blanks, tabs or commas and may be quoted with ' or " to contain them.
+//Every READ statement starts a new record (line) of the input, and moves on to
+//following records while it needs more values.
+class InputReader {
+	int fd;
+	bool owned; //The descriptor was opened here and is closed with the reader
+	bool mapped;
+	bool exhausted; //No more data can be read into the block
+	const char * data;
+	size_t size;
+	size_t pos;
+	long long consumed; //Bytes of the input before data
+	vector<char> block;
+	int record; //Input line of the next character
+	bool inRecord; //Something of the current record has been read
+
+	bool Fill();
+	bool SkipSeparators();
+
+public:
+	InputReader();
+	~InputReader();
+
+	InputReader(const InputReader &) = delete;
+	InputReader & operator=(const InputReader &) = delete;
+
+	//Reads from the file, or from standard input when the name is empty
+	bool Open(const string & name);
+
+	//Skips what is left of the current record
+	void NextRecord();
+
+	//The next value, valid until the following call; false at the end of the input
+	bool NextField(string_view & field, bool & quoted);
+
+	int Record() const { return record; }
+
+	//Where the next value would be read from, to continue there after a restart
+	long long Offset() const { return consumed + pos; }
+	bool InRecord() const { return inRecord; }
+	bool Seek(long long offset, int record, bool inRecord);
+};
+
+#endif
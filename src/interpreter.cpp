@@ -1,385 +1,3480 @@
 #include "interpreter.h"
+#include "pool.h"
+#include "input.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "bitarray.h"
+#include "unit.h"
 
-map<string, bool> defVar; //Map of declared variables
-map<string, Token> SymTable;
-map<string, bool> initVar; //Map of initialized variables
+#include <vector>
+#include <array>
+#include <set>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <unordered_map>
 
-map<string, Value> TempsResults; //Container of temporary locations of Value objects for results of expressions, variables values and constants 
-queue <Value> * ValQueue; //Declare a pointer variable to a queue of Value objects
+thread_local vector<Value> ValStack; //Values of the PRINT lists being evaluated; storage is kept between statements
+thread_local string PrintLine; //Text of the line being printed, written to the output in one piece
+thread_local string RecordBytes; //Unformatted records being laid out, each written in one piece; storage is kept
+
+void ParseError(int line, string msg);
 
 namespace Parser {
-	bool pushed_back = false;
-	LexItem	pushed_token;
+	//Tokens read but not yet consumed, in a ring: the next token is at first. Tokens
+	//pushed back go in front of it and tokens peeked at are read in behind the others.
+	static const unsigned lookahead_size = 4;
+	struct Lookahead {
+		LexItem tokens[lookahead_size];
+		unsigned first = 0;
+		unsigned count = 0;
+	};
+	thread_local Lookahead ahead;
+	thread_local const vector<LexItem> * replay = nullptr; //Recorded tokens read instead of the input stream, e.g. a DO CONCURRENT body
+	thread_local size_t replay_pos = 0;
+	thread_local int stream_pos = 0; //Tokens read from the input stream so far, by which they are numbered
+
+	static LexItem ReadToken(istream& in, int& line) {
+		if(replay != nullptr) {
+			if(replay_pos < replay->size()) {
+				const LexItem & t = (*replay)[replay_pos++];
+				line = t.GetLinenum();
+				return t;
+			}
+			return LexItem(DONE, "", line);
+		}
+		LexItem t = getNextToken(in, line);
+		t.SetPos(stream_pos++);
+		return t;
+	}
+	static LexItem GetNextToken(istream& in, int& line) {
+		if(ahead.count > 0) {
+			LexItem t = move(ahead.tokens[ahead.first]);
+			ahead.first = (ahead.first + 1) % lookahead_size;
+			--ahead.count;
+			return t;
+		}
+		return ReadToken(in, line);
+	}
+	//Overflowing the ring is reported and the token in front is replaced by ERR,
+	//which the statement being parsed then fails on
+	static void PushBackToken(const LexItem & t) {
+		if(ahead.count == lookahead_size) {
+			ParseError(t.GetLinenum(), "Too Many Tokens Pushed Back");
+			ahead.tokens[ahead.first] = LexItem(ERR, t.GetLexeme(), t.GetLinenum());
+			return;
+		}
+		ahead.first = (ahead.first + lookahead_size - 1) % lookahead_size;
+		ahead.tokens[ahead.first] = t;
+		++ahead.count;
+	}
+	//The token k places after the next one, without consuming it
+	static const LexItem & PeekToken(istream& in, int& line, unsigned k = 0) {
+		if(k >= lookahead_size) {
+			static thread_local LexItem beyond;
+			ParseError(line, "Token Peeked Beyond the Lookahead");
+			beyond = LexItem(ERR, "", line);
+			return beyond;
+		}
+		while(ahead.count <= k) {
+			ahead.tokens[(ahead.first + ahead.count) % lookahead_size] = ReadToken(in, line);
+			++ahead.count;
+		}
+		return ahead.tokens[(ahead.first + k) % lookahead_size];
+	}
+}
+
+//Reads the program from already lexed tokens, e.g. after Optimize, instead of the input stream
+void ReplayTokens(const vector<LexItem> * tokens) {
+	Parser::replay = tokens;
+	Parser::replay_pos = 0;
+}
+
+//A reduction operand recorded by one DO CONCURRENT iteration
+struct Contribution {
+	string var;
+	Token op;
+	Value val;
+};
+
+//State private to a chunk of DO CONCURRENT iterations executed by one pool worker
+struct IterContext {
+	ostringstream out; //PRINT output and diagnostics, emitted in iteration order after the loop
+	int errors = 0;
+	map<string, Value> locals; //Index variables of the enclosing DO CONCURRENT constructs
+	const set<string> * reductions = nullptr;
+	vector<Contribution> contributions;
+	long long failed = -1; //First iteration of the chunk that raised an error
+};
+static thread_local IterContext * iterCtx = nullptr;
+
+enum Intent { INTENT_NONE, INTENT_IN, INTENT_OUT, INTENT_INOUT };
+
+//A variable of a subprogram, given a fixed slot of its frame when the subprogram is defined
+struct SlotInfo {
+	string name;
+	Token type;
+	int strlen; //Declared LEN of a CHARACTER variable, 0 when a dummy argument takes its actual's length
+	Intent intent;
+	bool dummy;
+};
+
+struct Subprogram {
+	bool function;
+	vector<int> params; //Slots of the dummy arguments, in order
+	int result = -1; //Slot of the function result variable
+	vector<SlotInfo> slots;
+	vector<LexItem> body; //Declarations and statements, with identifiers resolved to slots
+};
+
+//Storage of one variable of a frame. A dummy argument bound to a variable
+//points at the actual argument's storage instead of its own.
+struct Slot {
+	Value own;
+	bool ownInit = false;
+	Value * val = nullptr;
+	bool * init = nullptr;
+};
+
+struct Frame {
+	const Subprogram * def;
+	Slot * slots;
+};
+
+//An initial value given to a program variable from outside, in place of its initializer
+struct Binding {
+	string text;
+	bool quoted;
+	bool used = false; //The program declares the variable
+};
+
+//Values of a SELECT CASE arm: lo:hi, with INT_MIN or INT_MAX for an open end
+struct CaseRange {
+	int lo, hi;
+	int arm;
+};
+
+//A SELECT CASE construct, compiled from its tokens. Offsets count from the token after
+//the selector's right parenthesis, so that one compilation serves every token vector
+//the construct is replayed from: DO CONCURRENT and subprogram bodies, --optimize.
+//INTEGER values that are dense go in a jump table, sparse ones in ranges searched by
+//bisection; CHARACTER values are hashed without their trailing blanks.
+struct SelectTable {
+	Token type = ERR; //Of the CASE values, ERR when there are none
+	vector<size_t> arms; //Offset of the first statement of each arm
+	int fallback = -1; //Arm of CASE DEFAULT
+	size_t length = 0; //Offset of the token after END SELECT
+	int endLine = 0;
+	int base = 0; //Value of jump[0]
+	vector<int> jump; //Arm of each value from base on, -1 for none
+	vector<CaseRange> ranges; //Sorted, used when there is no jump table
+	unordered_map<string, int> strings;
+
+	int Dispatch(const Value & selector) const;
+};
+
+//A file connected to a unit by OPEN. A unit is written through writer, or with
+//ACTION='READ' read through lines or, with FORM='UNFORMATTED', through records.
+struct Unit {
+	string path;
+	UnitWriter writer;
+	InputReader lines;
+	UnitReader records;
+	bool input = false;
+	bool unformatted = false;
+};
+
+//Everything a program owns apart from the parsing and execution state of the thread
+//running it. The interpreter reaches the program being run through program, which
+//DO CONCURRENT workers also point at the program they work for.
+struct ProgramContext {
+	map<string, bool> defVar; //Map of declared variables
+	map<string, Token> SymTable;
+	map<string, bool> initVar; //Map of initialized variables
+	map<string, Value> TempsResults; //Container of temporary locations of Value objects for results of expressions, variables values and constants
+	map<string, BitArray> arrays; //LOGICAL arrays, declared in defVar, SymTable and initVar but not in TempsResults
+	map<string, Subprogram> Subprograms;
+	int error_count = 0;
+	ostream * out; //PRINT output and diagnostics
+	long long written = 0; //Bytes written to out
+	InputReader input;
+	bool input_open = false;
+	string input_name; //READ input, standard input when empty
+	atomic<long long> statements_run{0};
+	atomic<long long> character_bytes{0};
+	atomic<long long> output_bytes{0};
+	chrono::steady_clock::time_point budget_start = chrono::steady_clock::now();
+	atomic<int> budget_tripped{-1}; //The budget that stopped the program
+	atomic<int> budget_line{0};
+	map<string, Binding> bindings;
+	map<int, SelectTable> selects; //Compiled SELECT CASE constructs run from recorded tokens, by the position of SELECT
+	mutex select_lock;
+	map<int, Unit> units; //Files connected by OPEN, by unit number
+	bool units_opened = false; //A file has been opened, so the program's effects are more than its output
+	long long top_statements = 0; //Top-level statements started so far
+	int mem_countdown = 0; //Top-level statements until memory is sampled again
+
+	explicit ProgramContext(ostream & o) : out(&o) {}
+};
+static ProgramContext main_program(cout); //The program run by main
+thread_local ProgramContext * program = &main_program;
+
+//Set on a thread that only checks a program: every statement is parsed and typed, with
+//placeholder values standing for what the program would compute, but nothing is
+//printed, read or called, both branches of an IF are checked and a DO CONCURRENT body
+//is checked once
+thread_local bool checking = false;
+
+//A value of the declared type, standing for whatever the checked program would compute
+static Value Placeholder(Token type, int strlen) {
+	if (type == INTEGER) {
+		return Value(1);
+	} else if (type == REAL) {
+		return Value(1.0);
+	} else if (type == LOGICAL) {
+		return Value(false);
+	}
+	Value val(string(max(strlen, 1), ' '));
+	val.SetstrLen(max(strlen, 1));
+	return val;
+}
+
+//Each thread's call stack is allocated on its first call and never resized, so that
+//dummy arguments can keep pointers to slots of the frames below them
+static const size_t stack_slots = 1 << 14;
+thread_local vector<Slot> CallStack;
+thread_local size_t stack_top = 0;
+thread_local Frame * frame = nullptr; //Frame of the subprogram being executed, nullptr in the program
+thread_local int call_depth = 0;
+thread_local bool call_failed = false; //Silences the messages of the calling frames while a failed call unwinds
+static int max_call_depth = 1000;
+void SetMaxCallDepth(int depth) {
+	max_call_depth = depth;
+}
+
+static atomic<int> deepest_call(0);
+static atomic<size_t> largest_frame(0);
+static atomic<size_t> stack_high_water(0);
+template <class T> static void RaiseTo(atomic<T> & stat, T value) {
+	T seen = stat.load(memory_order_relaxed);
+	while (seen < value && !stat.compare_exchange_weak(seen, value, memory_order_relaxed));
+}
+void PrintStats(ostream & out) {
+	out << "Maximum Call Depth: " << deepest_call.load() << endl;
+	out << "Largest Frame: " << largest_frame.load() << " slots (" << largest_frame.load() * sizeof(Slot) << " bytes)" << endl;
+	out << "Call Stack High-Water Mark: " << stack_high_water.load() << " slots" << endl;
+}
+
+//Execution trace behind --trace, nullptr when it is off. Only the program run by main is traced.
+static Tracer trace_file;
+static Tracer * tracer = nullptr;
+
+bool OpenTrace(const string & path, size_t capacity) {
+	if (!trace_file.Open(path, capacity)) {
+		return false;
+	}
+	tracer = &trace_file;
+	return true;
+}
+
+//Memory accounting. What the program's context holds is measured by walking it every
+//few top-level statements and at the end; buffers owned outside the interpreter are
+//charged by their owners, and short-lived ones only raise the peak of their subsystem.
+static bool mem_report = false;
+static long long mem_fixed[MEM_COUNT]; //Charged with ChargeMemory
+static long long mem_live[MEM_COUNT];
+static long long mem_peak[MEM_COUNT];
+static long long mem_peak_total = 0;
+static atomic<long long> call_stack_bytes(0); //Of every thread that has made a call
+static const int mem_sample_interval = 64; //Top-level statements between two samples
+static const char * const mem_names[MEM_COUNT] = {"Source Buffer", "Tokens", "Symbol Table", "Variable Storage", "String Storage", "Output Buffers"};
+
+void EnableMemReport() {
+	mem_report = true;
+}
+
+void ChargeMemory(MemSubsystem subsystem, long long bytes) {
+	mem_fixed[subsystem] += bytes;
+}
+
+//Bytes a string holds on the heap; short ones are stored inside the string object
+static size_t HeapBytes(size_t capacity) {
+	static const size_t inline_capacity = string().capacity();
+	return capacity > inline_capacity ? capacity + 1 : 0;
+}
+
+//A std::map node: the tree links and color, followed by the key and the mapped value
+template <class K, class V> static constexpr size_t NodeBytes() {
+	return 4 * sizeof(void *) + sizeof(pair<const K, V>);
+}
+
+long long TokenBytes(const vector<LexItem> & tokens) {
+	long long bytes = tokens.capacity() * sizeof(LexItem);
+	for (const LexItem & t : tokens) {
+		bytes += HeapBytes(t.GetLexeme().capacity());
+	}
+	return bytes;
+}
+
+//What a program variable costs: its entries in defVar, SymTable, initVar and TempsResults,
+//the Value itself, and the characters of a CHARACTER value
+struct Footprint {
+	long long symbols;
+	long long storage;
+	long long strings;
+	long long Total() const { return symbols + storage + strings; }
+};
+
+static Footprint VarFootprint(const string & name, const Value & val) {
+	Footprint f;
+	f.symbols = 2 * NodeBytes<string, bool>() + NodeBytes<string, Token>() + NodeBytes<string, Value>() - sizeof(Value)
+		+ 4 * HeapBytes(name.capacity());
+	f.storage = sizeof(Value);
+	f.strings = HeapBytes(val.GetStringCapacity());
+	return f;
+}
+
+static Footprint ArrayFootprint(const string & name, const BitArray & array) {
+	Footprint f;
+	f.symbols = 2 * NodeBytes<string, bool>() + NodeBytes<string, Token>() + NodeBytes<string, BitArray>() - sizeof(BitArray)
+		+ 4 * HeapBytes(name.capacity());
+	f.storage = sizeof(BitArray) + array.Bytes();
+	f.strings = 0;
+	return f;
+}
+
+static void SampleMemory() {
+	long long sampled[MEM_COUNT] = {};
+	for (const auto & var : program->TempsResults) {
+		Footprint f = VarFootprint(var.first, var.second);
+		sampled[MEM_SYMBOLS] += f.symbols;
+		sampled[MEM_VARIABLES] += f.storage;
+		sampled[MEM_STRINGS] += f.strings;
+	}
+	for (const auto & array : program->arrays) {
+		Footprint f = ArrayFootprint(array.first, array.second);
+		sampled[MEM_SYMBOLS] += f.symbols;
+		sampled[MEM_VARIABLES] += f.storage;
+	}
+	for (const auto & sub : program->Subprograms) {
+		const Subprogram & def = sub.second;
+		sampled[MEM_SYMBOLS] += NodeBytes<string, Subprogram>() + HeapBytes(sub.first.capacity())
+			+ def.params.capacity() * sizeof(int) + def.slots.capacity() * sizeof(SlotInfo);
+		for (const SlotInfo & info : def.slots) {
+			sampled[MEM_SYMBOLS] += HeapBytes(info.name.capacity());
+		}
+		sampled[MEM_TOKENS] += TokenBytes(def.body);
+	}
+	sampled[MEM_VARIABLES] += call_stack_bytes.load();
+	//Slots keep their values after a call returns
+	size_t used = min(CallStack.size(), stack_high_water.load());
+	for (size_t i = 0; i < used; i++) {
+		sampled[MEM_STRINGS] += HeapBytes(CallStack[i].own.GetStringCapacity());
+	}
+	sampled[MEM_OUTPUT] += HeapBytes(PrintLine.capacity()) + HeapBytes(RecordBytes.capacity()) + ValStack.capacity() * sizeof(Value);
+	for (const auto & unit : program->units) {
+		sampled[MEM_OUTPUT] += NodeBytes<int, Unit>() + unit.second.writer.Capacity();
+	}
+
+	long long total = 0;
+	for (int i = 0; i < MEM_COUNT; i++) {
+		mem_live[i] = mem_fixed[i] + sampled[i];
+		mem_peak[i] = max(mem_peak[i], mem_live[i]);
+		total += mem_live[i];
+	}
+	mem_peak_total = max(mem_peak_total, total);
+}
+
+//Bytes held for a moment on top of what is live, e.g. the output of DO CONCURRENT chunks
+static void ChargeTransient(MemSubsystem subsystem, long long bytes) {
+	if (!mem_report) {
+		return;
+	}
+	mem_peak[subsystem] = max(mem_peak[subsystem], mem_live[subsystem] + bytes);
+	long long total = bytes;
+	for (int i = 0; i < MEM_COUNT; i++) {
+		total += mem_live[i];
+	}
+	mem_peak_total = max(mem_peak_total, total);
+}
+
+void PrintMemReport(ostream & out, int top) {
+	SampleMemory();
+	long long total = 0;
+	out << "Memory: Live / Peak Bytes" << endl;
+	for (int i = 0; i < MEM_COUNT; i++) {
+		out << mem_names[i] << ": " << mem_live[i] << " / " << mem_peak[i] << endl;
+		total += mem_live[i];
+	}
+	out << "Total: " << total << " / " << mem_peak_total << endl;
+
+	vector<pair<long long, string>> vars;
+	for (const auto & var : program->TempsResults) {
+		vars.push_back({VarFootprint(var.first, var.second).Total(), var.first});
+	}
+	for (const auto & array : program->arrays) {
+		vars.push_back({ArrayFootprint(array.first, array.second).Total(), array.first});
+	}
+	sort(vars.begin(), vars.end(), [](const pair<long long, string> & a, const pair<long long, string> & b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	});
+	out << "Largest Variables (" << min<size_t>(top, vars.size()) << " of " << vars.size() << "):" << endl;
+	for (size_t i = 0; i < vars.size() && i < (size_t) top; i++) {
+		const string & name = vars[i].second;
+		Token type = program->SymTable[name];
+		out << name << " " << (type == INTEGER ? "INTEGER" : type == REAL ? "REAL" : type == LOGICAL ? "LOGICAL" : "CHARACTER");
+		if (type == CHARACTER) {
+			out << "(LEN=" << program->TempsResults[name].GetstrLen() << ")";
+		} else if (program->arrays.count(name)) {
+			out << "(" << program->arrays[name].Size() << ")";
+		}
+		out << ": " << vars[i].first << " bytes" << endl;
+	}
+}
+
+static void AllocateCallStack() {
+	CallStack.resize(stack_slots);
+	call_stack_bytes += stack_slots * sizeof(Slot);
+}
+
+//Where the variable an identifier names is stored, as seen from the current frame
+struct VarRef {
+	Value * val;
+	bool * init;
+	Token type;
+	Intent intent;
+	bool shared; //A program variable or DO CONCURRENT index seen from inside an iteration
+	BitArray * array; //The elements of a LOGICAL array, which has no val or init
+};
+
+static bool Lookup(const LexItem & tok, VarRef & ref) {
+	if (frame != nullptr) {
+		int slot = tok.GetSlot();
+		if (slot < 0) {
+			return false;
+		}
+		const SlotInfo & info = frame->def->slots[slot];
+		ref = {frame->slots[slot].val, frame->slots[slot].init, info.type, info.intent, false, nullptr};
+		return true;
+	}
+	string name = tok.GetLexeme();
+	if (iterCtx != nullptr) {
+		auto local = iterCtx->locals.find(name);
+		if (local != iterCtx->locals.end()) {
+			static thread_local bool indexInit = true;
+			ref = {&local->second, &indexInit, INTEGER, INTENT_IN, true, nullptr};
+			return true;
+		}
+	}
+	auto sym = program->SymTable.find(name);
+	if (sym == program->SymTable.end()) {
+		return false;
+	}
+	if (sym->second == LOGICAL) {
+		auto array = program->arrays.find(name);
+		if (array != program->arrays.end()) {
+			ref = {nullptr, nullptr, LOGICAL, INTENT_NONE, iterCtx != nullptr, &array->second};
+			return true;
+		}
+	}
+	ref = {&program->TempsResults.find(name)->second, &program->initVar.find(name)->second, sym->second, INTENT_NONE, iterCtx != nullptr, nullptr};
+	return true;
+}
+
+//The value of an expression over LOGICAL arrays: an array, or a scalar standing for every
+//element. An array variable is borrowed, and only copied once an operator changes it.
+struct Mask {
+	bool scalar = true;
+	bool value = false;
+	const BitArray * borrowed = nullptr;
+	BitArray own;
+
+	const BitArray & Bits() const { return borrowed != nullptr ? *borrowed : own; }
+	BitArray & Own() {
+		if (borrowed != nullptr) {
+			own = *borrowed;
+			borrowed = nullptr;
+		}
+		return own;
+	}
+};
+
+//Functions of a whole LOGICAL array, named like variables but only when none is declared
+enum Intrinsic { INTRINSIC_NONE, INTRINSIC_COUNT, INTRINSIC_ANY, INTRINSIC_ALL };
+
+static Intrinsic IntrinsicOf(string name) {
+	for (char & c : name) {
+		c = tolower(c);
+	}
+	return name == "count" ? INTRINSIC_COUNT : name == "any" ? INTRINSIC_ANY : name == "all" ? INTRINSIC_ALL : INTRINSIC_NONE;
+}
+
+static int max_depth = 1000; //Deepest nesting of parenthesized expressions and ** chains
+thread_local int expr_depth = 0;
+thread_local bool depth_exceeded = false; //Silences the per-level messages while unwinding from the limit
+void SetMaxDepth(int depth) {
+	max_depth = depth;
+}
+int MaxDepth() {
+	return max_depth;
+}
+
+//Expr for a value stored into a CHARACTER variable of length limit
+static bool StoredExpr(istream& in, int& line, Value & retVal, size_t limit);
+
+//The parsing and execution state a program keeps in thread-local storage. A program
+//that yields to a scheduler carries it on its own stack and leaves the thread's
+//variables as a program that has not started would find them.
+struct ExecState {
+	Parser::Lookahead ahead;
+	const vector<LexItem> * replay = nullptr;
+	size_t replayPos = 0;
+	int streamPos = 0;
+	vector<Value> valStack;
+	string printLine;
+	string recordBytes;
+	vector<Slot> callStack;
+	size_t stackTop = 0;
+	Frame * frame = nullptr;
+	int callDepth = 0;
+	bool callFailed = false;
+	int exprDepth = 0;
+	bool depthExceeded = false;
+	ProgramContext * program = &main_program;
+};
+
+static void SwapExecState(ExecState & s) {
+	swap(s.ahead, Parser::ahead);
+	swap(s.replay, Parser::replay);
+	swap(s.replayPos, Parser::replay_pos);
+	swap(s.streamPos, Parser::stream_pos);
+	swap(s.valStack, ValStack);
+	swap(s.printLine, PrintLine);
+	swap(s.recordBytes, RecordBytes);
+	swap(s.callStack, CallStack);
+	swap(s.stackTop, stack_top);
+	swap(s.frame, frame);
+	swap(s.callDepth, call_depth);
+	swap(s.callFailed, call_failed);
+	swap(s.exprDepth, expr_depth);
+	swap(s.depthExceeded, depth_exceeded);
+	swap(s.program, program);
+}
+
+//Installed per thread by a scheduler; the program yields when slice_over says so
+static thread_local bool (*slice_over)() = nullptr;
+static thread_local void (*yield_thread)() = nullptr;
+static thread_local int preempt_countdown = 0;
+static const int preempt_interval = 64; //Statements between two calls to slice_over
+
+void SetPreemption(bool (*sliceOver)(), void (*yield)()) {
+	slice_over = sliceOver;
+	yield_thread = yield;
+}
+
+//Only the program's own thread of execution yields, never a DO CONCURRENT task
+static void Preempt() {
+	if (--preempt_countdown > 0 || iterCtx != nullptr) {
+		return;
+	}
+	preempt_countdown = preempt_interval;
+	if (slice_over()) {
+		ExecState own;
+		SwapExecState(own);
+		yield_thread();
+		SwapExecState(own);
+	}
+}
+
+//Limits on what a program may consume; 0 is unlimited. They are only checked once
+//any of them is set, so a run without budgets pays a single branch per safepoint.
+static bool budgets_set = false;
+static double budget_limit[BUDGET_COUNT];
+static const char * const budget_names[BUDGET_COUNT] = {"Statements", "Wall Time", "CHARACTER Bytes", "Output Bytes"};
+
+void SetBudget(Budget budget, double limit) {
+	budget_limit[budget] = limit;
+	budgets_set = true;
+}
+
+bool BudgetsSet() {
+	return budgets_set;
+}
+
+//Buffer of each unit connected by OPEN, and whether its file is written with direct I/O
+static size_t unit_buffer = 4 << 20;
+static bool unit_direct = false;
+void SetUnitBuffer(size_t bytes, bool direct) {
+	unit_buffer = bytes;
+	unit_direct = direct;
+}
+
+static bool Trip(Budget budget, int line) {
+	int none = -1;
+	if (program->budget_tripped.compare_exchange_strong(none, budget)) {
+		program->budget_line = line;
+	}
+	return false;
+}
+
+//Prints the diagnostic of the budget that stopped the program, if one did
+static bool BudgetExceeded(ostream & out) {
+	int budget = program->budget_tripped.load();
+	if (budget < 0) {
+		return false;
+	}
+	out << program->budget_line.load() << ": Execution Budget Exceeded: " << budget_names[budget] << endl;
+	return true;
+}
+
+static bool CheckBudgets(int line) {
+	if (program->budget_tripped.load(memory_order_relaxed) >= 0) {
+		return false;
+	}
+	long long count = program->statements_run.fetch_add(1, memory_order_relaxed) + 1;
+	if (budget_limit[BUDGET_STATEMENTS] > 0 && count > budget_limit[BUDGET_STATEMENTS]) {
+		return Trip(BUDGET_STATEMENTS, line);
+	}
+	if (budget_limit[BUDGET_CHARACTER] > 0 && program->character_bytes.load(memory_order_relaxed) > budget_limit[BUDGET_CHARACTER]) {
+		return Trip(BUDGET_CHARACTER, line);
+	}
+	if (budget_limit[BUDGET_TIME] > 0 && count % 256 == 0) { //Reading the clock costs more than the rest together
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - program->budget_start;
+		if (elapsed.count() > budget_limit[BUDGET_TIME]) {
+			return Trip(BUDGET_TIME, line);
+		}
+	}
+	return true;
+}
+
+static inline bool Safepoint(int line) {
+	if (slice_over != nullptr) {
+		Preempt();
+	}
+	return !budgets_set || CheckBudgets(line);
+}
+
+static inline void ChargeCharacter(size_t bytes) {
+	if (budgets_set) {
+		program->character_bytes.fetch_add(bytes, memory_order_relaxed);
+	}
+}
+
+static unsigned thread_count = 0; //0 selects one thread per hardware core
+void SetThreadCount(unsigned count) {
+	thread_count = count;
+}
+
+static WorkStealingPool & Pool() {
+	static WorkStealingPool pool(thread_count != 0 ? thread_count : max(1u, thread::hardware_concurrency()));
+	return pool;
+}
+
+static ostream & Out() {
+	return iterCtx != nullptr ? iterCtx->out : *program->out;
+}
+
+int ErrCount(){
+    return program->error_count;
+}
+
+void ParseError(int line, string msg){
+	if ((call_failed && frame != nullptr) || program->budget_tripped.load(memory_order_relaxed) >= 0) {
+		return;
+	}
+	if (iterCtx != nullptr) {
+		++iterCtx->errors;
+	} else {
+		++program->error_count;
+		program->written += to_string(line).size() + msg.size() + 3;
+	}
+	if (tracer != nullptr) {
+		tracer->Error(line, msg);
+	}
+	Out() << line << ": " << msg << endl;
+}
+
+//Prints the status that closes the output of a program that has stopped and returns the exit status
+int Finish(bool status, ostream & out) {
+	program->units.clear(); //Units a failed program left open are flushed and closed
+	if (BudgetExceeded(out)) {
+		out << "\nStatus: Execution Budget Exceeded" << endl;
+		return 3;
+	}
+	if (!status) {
+		out << "\nStatus: Unsuccessful Interpretation" << endl << "Number of Errors " << ErrCount() << endl;
+	}
+	return 0;
+}
+
+ProgramContext * NewProgram(ostream & out, const string & inputName) {
+	ProgramContext * context = new ProgramContext(out);
+	context->input_name = inputName;
+	return context;
+}
+
+void DeleteProgram(ProgramContext * context) {
+	delete context;
+}
+
+void BindVariable(ProgramContext * context, const string & name, const string & text, bool quoted) {
+	context->bindings[name] = {text, quoted};
+}
+
+vector<string> UnusedBindings(ProgramContext * context) {
+	vector<string> names;
+	for (const auto & bound : context->bindings) {
+		if (!bound.second.used) {
+			names.push_back(bound.first);
+		}
+	}
+	return names;
+}
+
+int RunProgram(ProgramContext * context, istream & in, const vector<LexItem> * tokens) {
+	ExecState fresh;
+	fresh.program = context;
+	fresh.replay = tokens;
+	SwapExecState(fresh); //What the thread held is kept aside until the program is done
+	int status;
+	try {
+		int line = 1;
+		bool parsed = Prog(in, line);
+		status = Finish(parsed, *context->out);
+	} catch (...) {
+		SwapExecState(fresh);
+		throw;
+	}
+	SwapExecState(fresh);
+	return status;
+}
+
+//Runs the grammar and the declaration and type rules over the whole program, without
+//executing it; diagnostics go to out. Returns the number of errors.
+int CheckProgram(istream & in, ostream & out) {
+	ProgramContext context(out);
+	ExecState fresh;
+	fresh.program = &context;
+	SwapExecState(fresh);
+	checking = true;
+	bool parsed;
+	try {
+		int line = 1;
+		parsed = Prog(in, line);
+	} catch (...) {
+		checking = false;
+		SwapExecState(fresh);
+		throw;
+	}
+	checking = false;
+	SwapExecState(fresh);
+	return parsed ? 0 : max(1, context.error_count);
+}
+
+static bool ProgStmts(istream& in, int& line, LexItem token);
+static bool CloseUnits(int line);
+static bool CheckSubprograms(istream& in, int& line);
+static bool SkipDoBody(istream& in, int& line);
+static bool SkipSelect(istream& in, int& line);
+static bool ReductionStmt(istream& in, int& line, const string & varName);
+static bool Invoke(istream& in, int& line, const Subprogram & def, Value * result);
+static bool MaskExpr(istream& in, int& line, Mask & mask);
+static bool EnterNesting(int line);
+static bool AssignMask(int line, BitArray & array, Mask & mask);
+
+//Periodic checkpoints of the main program, taken before a top-level statement, where
+//no frame, DO CONCURRENT iteration or pending PRINT list is live and the whole state
+//is the program's variables and subprograms, the source position and the counters
+static string checkpoint_path;
+static long long checkpoint_every = 0; //Top-level statements between two checkpoints, 0 for none
+static uint64_t source_hash = 0; //Of the program file, so a checkpoint is only resumed with its program
+static const uint64_t checkpoint_version = 6; //Tokens are saved by number, so it changes with Token
+
+void SetCheckpoint(const string & path, long long every, uint64_t sourceHash) {
+	checkpoint_path = path;
+	checkpoint_every = every;
+	source_hash = sourceHash;
+}
+
+static void SaveToken(CheckpointWriter & w, const LexItem & t) {
+	w.U64(t.GetToken());
+	w.I64(t.GetPos());
+	w.Str(t.GetLexeme());
+	w.I64(t.GetLinenum());
+	w.I64(t.GetSlot());
+}
+
+static LexItem LoadToken(CheckpointReader & r) {
+	Token token = (Token) r.U64();
+	int pos = r.I64();
+	string lexeme = r.Str();
+	int line = r.I64();
+	LexItem t(token, lexeme, line);
+	t.SetPos(pos);
+	t.SetSlot(r.I64());
+	return t;
+}
+
+static void SaveValue(CheckpointWriter & w, const Value & v) {
+	w.U64(v.GetType());
+	if (v.IsInt()) {
+		w.I64(v.GetInt());
+	} else if (v.IsReal()) {
+		w.F64(v.GetReal());
+	} else if (v.IsString()) {
+		w.Str(v.GetString());
+		w.I64(v.GetstrLen());
+	} else if (v.IsBool()) {
+		w.U64(v.GetBool());
+	}
+}
+
+static Value LoadValue(CheckpointReader & r) {
+	Value v;
+	ValType type = (ValType) r.U64();
+	if (type == VINT) {
+		v = Value((int) r.I64());
+	} else if (type == VREAL) {
+		v = Value(r.F64());
+	} else if (type == VSTRING) {
+		v = Value(r.Str());
+		v.SetstrLen(r.I64());
+	} else if (type == VBOOL) {
+		v = Value(r.U64() != 0);
+	}
+	return v;
+}
+
+//Where the next token will be read from: a byte offset in the source, or an index
+//into the replayed tokens. -1 when the stream cannot tell.
+static long long SourcePosition(istream& in) {
+	return Parser::replay != nullptr ? (long long) Parser::replay_pos : (long long) in.tellg();
+}
+
+//The state of the main program before its top-level statement next
+static void SaveState(CheckpointWriter & w, istream& in, int line, const LexItem & next) {
+	bool replaying = Parser::replay != nullptr;
+	long long position = SourcePosition(in);
+	w.U64(replaying);
+	w.I64(position);
+	w.I64(line);
+	w.I64(Parser::stream_pos);
+	w.U64(Parser::ahead.count);
+	for (unsigned i = 0; i < Parser::ahead.count; i++) {
+		SaveToken(w, Parser::ahead.tokens[(Parser::ahead.first + i) % Parser::lookahead_size]);
+	}
+	SaveToken(w, next);
+	w.I64(program->top_statements);
+	w.I64(program->error_count);
+	w.I64(program->written);
+	w.I64(program->statements_run);
+	w.I64(program->character_bytes);
+	w.I64(program->output_bytes);
+
+	w.U64(program->input_open);
+	if (program->input_open) {
+		w.I64(program->input.Offset());
+		w.I64(program->input.Record());
+		w.U64(program->input.InRecord());
+	}
+
+	//The files of open units are flushed, so that a resumed run can cut them off where the unit was,
+	//and input units go on from where they were read to
+	w.U64(program->units.size());
+	for (auto & unit : program->units) {
+		Unit & u = unit.second;
+		w.I64(unit.first);
+		w.Str(u.path);
+		w.U64(u.input);
+		w.U64(u.unformatted);
+		if (!u.input) {
+			u.writer.Flush();
+			w.I64(u.writer.Offset());
+		} else if (u.unformatted) {
+			w.I64(u.records.Offset());
+		} else {
+			w.I64(u.lines.Offset());
+			w.I64(u.lines.Record());
+			w.U64(u.lines.InRecord());
+		}
+	}
+
+	w.U64(program->SymTable.size() - program->arrays.size());
+	for (const auto & var : program->SymTable) {
+		if (program->arrays.count(var.first)) {
+			continue;
+		}
+		w.Str(var.first);
+		w.U64(var.second);
+		w.U64(program->initVar[var.first]);
+		SaveValue(w, program->TempsResults[var.first]);
+	}
+	w.U64(program->arrays.size());
+	for (const auto & array : program->arrays) {
+		w.Str(array.first);
+		w.U64(array.second.Size());
+		for (uint64_t word : array.second.Words()) {
+			w.U64(word);
+		}
+	}
+
+	w.U64(program->Subprograms.size());
+	for (const auto & sub : program->Subprograms) {
+		const Subprogram & def = sub.second;
+		w.Str(sub.first);
+		w.U64(def.function);
+		w.I64(def.result);
+		w.U64(def.params.size());
+		for (int param : def.params) {
+			w.I64(param);
+		}
+		w.U64(def.slots.size());
+		for (const SlotInfo & info : def.slots) {
+			w.Str(info.name);
+			w.U64(info.type);
+			w.I64(info.strlen);
+			w.U64(info.intent);
+			w.U64(info.dummy);
+		}
+		w.U64(def.body.size());
+		for (const LexItem & t : def.body) {
+			SaveToken(w, t);
+		}
+	}
+}
+
+static void WriteCheckpoint(istream& in, int line, const LexItem & next) {
+	if (SourcePosition(in) < 0) {
+		return;
+	}
+	CheckpointWriter w;
+	w.Str("SF95CKPT");
+	w.U64(checkpoint_version);
+	w.U64(source_hash);
+	SaveState(w, in, line, next);
+	w.Commit(checkpoint_path);
+}
+
+//Restores the state saved by SaveState and moves the input to where it was taken.
+//outputOffset is how much output the program had written by then.
+static bool LoadState(CheckpointReader & r, istream& in, int& line, long long & outputOffset) {
+	bool replaying = r.U64() != 0;
+	long long position = r.I64();
+	if (replaying != (Parser::replay != nullptr)) {
+		return false;
+	}
+	line = r.I64();
+	int streamPos = r.I64();
+	int pushed = r.U64();
+	if (pushed > 1) { //The statement's first token is pushed on top of these
+		return false;
+	}
+	Parser::Lookahead ahead;
+	for (int i = 0; i < pushed; i++) {
+		ahead.tokens[i] = LoadToken(r);
+	}
+	ahead.count = pushed;
+	LexItem next = LoadToken(r);
+	program->top_statements = r.I64();
+	program->error_count = r.I64();
+	outputOffset = r.I64();
+	program->written = outputOffset;
+	program->statements_run = r.I64();
+	program->character_bytes = r.I64();
+	program->output_bytes = r.I64();
+
+	if (r.U64() != 0) {
+		long long offset = r.I64();
+		int record = r.I64();
+		bool inRecord = r.U64() != 0;
+		program->input_open = program->input.Open(program->input_name);
+		if (!program->input_open || !program->input.Seek(offset, record, inRecord)) {
+			return false;
+		}
+	}
+
+	size_t units = r.U64();
+	for (size_t i = 0; i < units && r.Good(); i++) {
+		Unit & u = program->units[r.I64()];
+		u.path = r.Str();
+		u.input = r.U64() != 0;
+		u.unformatted = r.U64() != 0;
+		long long offset = r.I64();
+		program->units_opened = true;
+		if (!u.input) {
+			if (!u.writer.Open(u.path, unit_buffer, unit_direct, offset)) {
+				return false;
+			}
+		} else if (u.unformatted) {
+			if (!u.records.Open(u.path, offset)) {
+				return false;
+			}
+		} else {
+			int record = r.I64();
+			bool inRecord = r.U64() != 0;
+			if (!u.lines.Open(u.path) || !u.lines.Seek(offset, record, inRecord)) {
+				return false;
+			}
+		}
+	}
+
+	size_t vars = r.U64();
+	for (size_t i = 0; i < vars && r.Good(); i++) {
+		string name = r.Str();
+		program->defVar[name] = true;
+		program->SymTable[name] = (Token) r.U64();
+		program->initVar[name] = r.U64() != 0;
+		program->TempsResults[name] = LoadValue(r);
+	}
+	size_t arrays = r.U64();
+	for (size_t i = 0; i < arrays && r.Good(); i++) {
+		string name = r.Str();
+		size_t size = r.U64();
+		vector<uint64_t> words;
+		for (size_t w = 0; w < (size + 63) / 64 && r.Good(); w++) {
+			words.push_back(r.U64());
+		}
+		program->defVar[name] = true;
+		program->SymTable[name] = LOGICAL;
+		program->initVar[name] = true;
+		program->arrays[name] = BitArray(size, move(words));
+	}
+
+	size_t subs = r.U64();
+	for (size_t i = 0; i < subs && r.Good(); i++) {
+		string name = r.Str();
+		Subprogram & def = program->Subprograms[name];
+		def.function = r.U64() != 0;
+		def.result = r.I64();
+		def.params.resize(r.U64());
+		for (int & param : def.params) {
+			param = r.I64();
+		}
+		def.slots.resize(r.U64());
+		for (SlotInfo & info : def.slots) {
+			info.name = r.Str();
+			info.type = (Token) r.U64();
+			info.strlen = r.I64();
+			info.intent = (Intent) r.U64();
+			info.dummy = r.U64() != 0;
+		}
+		def.body.resize(r.U64());
+		for (LexItem & t : def.body) {
+			t = LoadToken(r);
+		}
+	}
+	if (!r.Good()) {
+		return false;
+	}
+
+	if (replaying) {
+		Parser::replay_pos = position;
+	} else if (!in.seekg(position)) {
+		return false;
+	}
+	Parser::ahead = move(ahead);
+	Parser::stream_pos = streamPos;
+	Parser::PushBackToken(next);
+	program->top_statements--; //The statement is counted again when it runs
+	return true;
+}
+
+bool LoadCheckpoint(istream& in, int& line, long long & outputOffset) {
+	CheckpointReader r;
+	if (!r.Open(checkpoint_path) || r.Str() != "SF95CKPT" || r.U64() != checkpoint_version || r.U64() != source_hash) {
+		return false;
+	}
+	return LoadState(r, in, line, outputOffset);
+}
+
+//Incremental re-execution. Every snapshot_every top-level statements the state is kept
+//in memory, and saved at the end of the run with the program's source and output. The
+//next run diffs its source against that one and resumes from the last snapshot taken
+//before the first changed byte, since nothing before it can have a different effect.
+struct Snapshot {
+	long long position; //Source offset the state was taken at
+	string state;
+};
+static vector<Snapshot> snapshots;
+static long long snapshot_every = 0;
+static const uint64_t incremental_version = 4;
+
+void SetIncremental(long long every) {
+	snapshot_every = every;
+}
+
+static void TakeSnapshot(istream& in, int line, const LexItem & next) {
+	//Replayed tokens have no source offsets, and a state that has read input or written files depends on more than the source
+	long long position = SourcePosition(in);
+	if (position < 0 || Parser::replay != nullptr || (program->input_open && program->input.Record() > 0) || program->units_opened) {
+		return;
+	}
+	CheckpointWriter w;
+	SaveState(w, in, line, next);
+	snapshots.push_back({position, w.Data()});
+}
+
+//Restores the last snapshot of the previous run that is still valid for source, the
+//new program text. config holds the settings of the run and must match the previous
+//one. output gets what the previous run had written by the snapshot. False when the
+//cache cannot be used at all; resumed tells whether a snapshot was restored.
+bool LoadIncremental(const string & path, const string & config, const string & source, istream& in, int& line, string & output, bool & resumed) {
+	resumed = false;
+	CheckpointReader r;
+	if (!r.Open(path)) {
+		return true; //First run
+	}
+	if (r.Str() != "SF95INCR" || r.U64() != incremental_version || r.Str() != config) {
+		return true;
+	}
+	string previous = r.Str();
+	string previousOutput = r.Str();
+	//The byte at a snapshot's position was looked at to end the token before it, so it must be unchanged too
+	long long same = mismatch(previous.begin(), previous.begin() + min(previous.size(), source.size()), source.begin()).first - previous.begin();
+	size_t count = r.U64();
+	for (size_t i = 0; i < count && r.Good(); i++) {
+		long long position = r.I64();
+		string state = r.Str();
+		if (position >= same) {
+			break;
+		}
+		snapshots.push_back({position, state});
+	}
+	if (!r.Good()) {
+		snapshots.clear();
+		return false;
+	}
+	if (snapshots.empty()) {
+		return true;
+	}
+	CheckpointReader state(snapshots.back().state);
+	long long outputOffset;
+	if (!LoadState(state, in, line, outputOffset) || outputOffset > (long long) previousOutput.size()) {
+		return false;
+	}
+	output = previousOutput.substr(0, outputOffset);
+	resumed = true;
+	return true;
+}
+
+//Saves the snapshots of this run, with its source and its whole output, for the next one
+bool SaveIncremental(const string & path, const string & config, const string & source, const string & output) {
+	CheckpointWriter w;
+	w.Str("SF95INCR");
+	w.U64(incremental_version);
+	w.Str(config);
+	w.Str(source);
+	w.Str(output);
+	w.U64(snapshots.size());
+	for (const Snapshot & snapshot : snapshots) {
+		w.I64(snapshot.position);
+		w.Str(snapshot.state);
+	}
+	return w.Commit(path);
+}
+
+//Continues the main program from the checkpoint LoadCheckpoint restored
+bool ResumeProg(istream& in, int& line) {
+	return ProgStmts(in, line, Parser::GetNextToken(in, line));
+}
+
+//Prog ::= {Subprogram} PROGRAM IDENT {Decl} {Stmt} END PROGRAM IDENT
+bool Prog(istream& in, int& line) {
+    LexItem token = Parser::GetNextToken(in, line);
+	while (token == SUBROUTINE || token == FUNCTION) {
+		Parser::PushBackToken(token);
+		if (!SubprogramDef(in, line)) {
+			ParseError(line, "Incorrect Subprogram Definition");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+	}
+	if (checking && !CheckSubprograms(in, line)) {
+		return false;
+	}
+    if (token != PROGRAM) {
+        ParseError(line, "Missing Program");
+        return false;
+    }
+    token = Parser::GetNextToken(in, line);
+	if (token != IDENT) {
+		ParseError(line, "Missing Program name");
+		return false;
+	}
+	
+	token = Parser::GetNextToken(in, line);
+	while (token == REAL || token == INTEGER || token == CHARACTER || token == LOGICAL) { //Iterating through declarations, ending when token isn't a Type
+		Parser::PushBackToken(token);
+		if (!Decl(in, line)) {
+			ParseError(line, "Incorrect Declaration in Program");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		//cout << "Prog Decl " << token << endl;
+	}
+
+	return ProgStmts(in, line, token);
+}
+
+//{Stmt} END PROGRAM IDENT, starting with token
+static bool ProgStmts(istream& in, int& line, LexItem token) {
+	while (token == IF || token == PRINT || token == READ || token == IDENT || token == DO || token == CALL || token == SELECT
+		|| token == OPEN || token == WRITE || token == CLOSE) { //Iterating through statements, ending when token isn't a statement
+		if (!checking) {
+			long long started = ++program->top_statements;
+			if (checkpoint_every > 0 && started % checkpoint_every == 0) {
+				WriteCheckpoint(in, line, token);
+			}
+			if (snapshot_every > 0 && started % snapshot_every == 0) {
+				TakeSnapshot(in, line, token);
+			}
+			if (mem_report && --program->mem_countdown <= 0) {
+				program->mem_countdown = mem_sample_interval;
+				SampleMemory();
+			}
+		}
+		Parser::PushBackToken(token);
+		if (!Stmt(in, line)) {
+			ParseError(token.GetLinenum(), "Incorrect Statement in Program");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		//cout << "Prog Stmt " << token << endl;
+	}
+	
+	if (token != END) {
+		ParseError(line, "Missing END of Program");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != PROGRAM) {
+		ParseError(line, "Missing Program");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != IDENT) {
+		ParseError(line, "Missing Program name");
+		return false;
+	}
+	return CloseUnits(token.GetLinenum());
+}
+
+
+static Intent IntentOf(string spec) {
+	for (char & c : spec) {
+		c = tolower(c);
+	}
+	return spec == "in" ? INTENT_IN : spec == "out" ? INTENT_OUT : spec == "inout" ? INTENT_INOUT : INTENT_NONE;
+}
+
+//Decl ::= Type [, INTENT (IN | OUT | INOUT)] :: VarList
+//Type ::= INTEGER | REAL | LOGICAL | CHARACTER [(LEN = ICONST)]
+bool Decl(istream& in, int& line) {
+	string len;
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != INTEGER && token != REAL && token != CHARACTER && token != LOGICAL) {
+		ParseError(line, "Missing Type");
+		return false;
+	}
+	LexItem type = token;
+	token = Parser::GetNextToken(in, line);
+
+	if (token == LPAREN) { //Type has a length
+		token = Parser::GetNextToken(in, line);
+		if (token != LEN) {
+			ParseError(line, "Missing Length");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != ASSOP) {
+			ParseError(line, "Missing Assignment Operator");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != ICONST) {
+			ParseError(line, "Incorrect Initialization of a String Length");
+			return false;
+		}
+		len =  token.GetLexeme();
+		token = Parser::GetNextToken(in, line);
+		if (token != RPAREN) {
+			ParseError(line, "Missing Right Parenthesis");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+	}
+
+	if (token == COMMA) { //Dummy arguments only, the intent was recorded when the subprogram was defined
+		if (frame == nullptr) {
+			ParseError(line, "INTENT Outside a Subprogram");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != INTENT) {
+			ParseError(line, "Missing INTENT");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != LPAREN) {
+			ParseError(line, "Missing Left Parenthesis");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != IDENT || IntentOf(token.GetLexeme()) == INTENT_NONE) {
+			ParseError(line, "Incorrect INTENT Specification");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != RPAREN) {
+			ParseError(line, "Missing Right Parenthesis");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+	}
+	if (token != DCOLON) {
+		ParseError(line, "Missing Double Colon");
+		return false;
+	}
+	if (len == "") {
+		if (!VarList(in, line, type)) {
+			ParseError(line, "Missing Variable List");
+			return false;
+		}
+	} else {
+		if (!VarList(in, line, type, stoi(len))) {
+			ParseError(line, "Missing Variable List");
+			return false;
+		}
+	}
+	return true;
+}
+
+//Converts the text of an input value or a binding to an INTEGER or REAL value; a quoted one is not a number
+static bool ParseNumber(string_view field, bool quoted, Token type, Value & val) {
+	const char * first = field.data();
+	const char * last = first + field.size();
+	if (!quoted && last - first > 1 && *first == '+' && first[1] != '-' && first[1] != '+') {
+		first++; //from_chars takes a minus sign only
+	}
+	from_chars_result res;
+	if (type == INTEGER) {
+		int ival = 0;
+		res = from_chars(first, last, ival);
+		val = Value(ival);
+	} else {
+		double rval = 0.0;
+		res = from_chars(first, last, rval);
+		val = Value(rval);
+	}
+	return !quoted && first != last && res.ec == errc() && res.ptr == last;
+}
+
+//Converts the text of an input value or a binding to a LOGICAL value: T or F, in either
+//case and optionally after a period, followed by anything, so that .TRUE. and true are read too
+static bool ParseLogical(string_view field, bool quoted, Value & val) {
+	size_t i = !field.empty() && field[0] == '.' ? 1 : 0;
+	if (quoted || i >= field.size() || (tolower(field[i]) != 't' && tolower(field[i]) != 'f')) {
+		return false;
+	}
+	val = Value(tolower(field[i]) == 't');
+	return true;
+}
+
+//Name of a type in the diagnostics of input values and bindings
+static string TypeName(Token type) {
+	return type == INTEGER ? "Integer" : type == REAL ? "Real" : "Logical";
+}
+
+bool BindingValue(Token type, int strlen, const string & text, bool quoted, Value & val) {
+	if (type == CHARACTER) {
+		val = Value(text);
+		val.FitString(strlen);
+		return true;
+	}
+	return type == LOGICAL ? ParseLogical(text, quoted, val) : ParseNumber(text, quoted, type, val);
+}
+
+//Gives a program variable the value it is bound to, if any, in place of its initializer.
+//The value is converted to the declared type as READ converts its input.
+static bool ApplyBinding(int line, const string & name, Token type, int strlen) {
+	auto bound = program->bindings.find(name);
+	if (bound == program->bindings.end()) {
+		return true;
+	}
+	Binding & binding = bound->second;
+	binding.used = true;
+	Value val;
+	if (!BindingValue(type, strlen, binding.text, binding.quoted, val)) {
+		ParseError(line, "Illegal " + TypeName(type) + " Binding Value \"" + binding.text + "\" for Variable " + name);
+		return false;
+	}
+	if (type == CHARACTER) {
+		ChargeCharacter(strlen);
+	}
+	program->TempsResults[name] = val;
+	program->initVar[name] = true;
+	return true;
+}
+
+//Var (ICONST) [= Expr] of the program: a LOGICAL array, with every element .FALSE. unless
+//it is initialized. The initializer is an expression over arrays, as in an assignment.
+static bool ArrayDecl(istream& in, int& line, Token type, const string & name) {
+	Parser::GetNextToken(in, line);
+	auto bound = program->bindings.find(name);
+	if (bound != program->bindings.end()) {
+		bound->second.used = true;
+		ParseError(line, "Illegal Binding for Array " + name);
+		return false;
+	}
+	if (type != LOGICAL) {
+		ParseError(line, "Illegal Type for an Array");
+		return false;
+	}
+	LexItem token = Parser::GetNextToken(in, line);
+	int size = 0;
+	string digits = token.GetLexeme();
+	if (token != ICONST || from_chars(digits.data(), digits.data() + digits.size(), size).ec != errc() || size < 1) {
+		ParseError(line, "Illegal Array Size");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	program->initVar[name] = true;
+	BitArray & array = program->arrays[name] = BitArray(size);
+	if (Parser::PeekToken(in, line) == ASSOP) {
+		Parser::GetNextToken(in, line);
+		Mask mask;
+		if (!MaskExpr(in, line, mask)) {
+			ParseError(line, "Incorrect initialization for a variable.");
+			return false;
+		}
+		if (!AssignMask(line, array, mask)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//VarList ::= Var [(ICONST)] [= Expr] {, Var [(ICONST)] [= Expr]}
+bool VarList(istream& in, int& line, LexItem & idtok, int strlen) {
+	Value declVal; //Initial value of every variable in the list
+
+	if (idtok.GetToken() == CHARACTER) {
+		declVal.SetType(VSTRING);
+		declVal.SetstrLen(strlen);
+		string initialStr(strlen, ' ');
+		declVal.SetString(initialStr);
+	} else if (idtok.GetToken() == REAL) {
+		declVal.SetType(VREAL);
+	} else if (idtok.GetToken() == INTEGER) {
+		declVal.SetType(VINT);
+	} else if (idtok.GetToken() == LOGICAL) {
+		declVal.SetType(VBOOL);
+	}
+
+	LexItem token;
+	do {
+		string identName;
+		Value exprVal = declVal;
+		Slot * slot = nullptr; //Storage of a subprogram variable
+
+		token = Parser::GetNextToken(in, line);
+		if (token == IDENT && frame != nullptr) {
+			identName = token.GetLexeme();
+			if (token.GetSlot() < 0) {
+				ParseError(line, "Incorrect Declaration in Subprogram");
+				return false;
+			}
+			slot = &frame->slots[token.GetSlot()];
+		} else if (token == IDENT) {
+			identName = token.GetLexeme();
+			if (program->defVar.find(identName) == program->defVar.end()) {
+				program->defVar[identName] = true;
+				program->SymTable[identName] = idtok.GetToken();
+				if (idtok.GetToken() != CHARACTER) { //Initialize if it's a character variable
+					program->initVar[identName] = false;
+				} else {
+					program->initVar[identName] = true;
+				}
+			} else {
+				ParseError(line, "Variable Redefinition");
+				return false;
+			}
+		} else {
+			ParseError(line, "Missing Variable Name");
+			return false;
+		}
+		if (slot == nullptr && Parser::PeekToken(in, line) == LPAREN) {
+			if (!ArrayDecl(in, line, idtok.GetToken(), identName)) {
+				return false;
+			}
+			token = Parser::GetNextToken(in, line);
+			continue;
+		}
+		if (idtok.GetToken() == CHARACTER) {
+			ChargeCharacter(strlen);
+		}
+		if (slot == nullptr) {
+			program->TempsResults[identName] = exprVal;
+		} else if (!frame->def->slots[token.GetSlot()].dummy) { //A dummy argument keeps the value it is bound to
+			*slot->val = exprVal;
+			*slot->init = idtok.GetToken() == CHARACTER;
+		}
+
+		token = Parser::GetNextToken(in, line);
+		if (token == ASSOP) {
+			if (!StoredExpr(in, line, exprVal, idtok.GetToken() == CHARACTER ? strlen : string::npos)) {
+				ParseError(line, "Incorrect initialization for a variable.");
+				return false;
+			}
+			if (exprVal.GetType() == VSTRING) {
+				exprVal.FitString(strlen); //Adjusting string to declared length
+			}
+			if (slot == nullptr) {
+				program->TempsResults[identName] = exprVal;
+				program->initVar[identName] = true;
+			} else {
+				*slot->val = exprVal;
+				*slot->init = true;
+			}
+			if (tracer != nullptr) {
+				tracer->Assign(line, identName, exprVal);
+			}
+
+			token = Parser::GetNextToken(in, line);
+		}
+		if (slot == nullptr && !program->bindings.empty() && !ApplyBinding(line, identName, idtok.GetToken(), strlen)) {
+			return false;
+		}
+	} while (token == COMMA);
+
+	Parser::PushBackToken(token);
+	return true;
+}
+
+//Stmt ::= AssignStmt | BlockIfStmt | PrintStmt | ReadStmt | SimpleIfStmt | DoConcurrentStmt | CallStmt | SelectStmt
+//       | OpenStmt | WriteStmt | CloseStmt
+bool Stmt(istream& in, int& line) {
+	if (!Safepoint(line)) {
+		return false;
+	}
+	LexItem token = Parser::GetNextToken(in, line);
+	if (tracer != nullptr) {
+		tracer->Statement(token.GetLinenum());
+	}
+	switch(token.GetToken()) {
+		case IDENT: {
+			Parser::PushBackToken(token);
+			return SimpleStmt(in, line);
+			break;
+		}
+		case PRINT: {
+			Parser::PushBackToken(token);
+			return PrintStmt(in, line);
+			break;
+		}
+		case IF: {
+			Parser::PushBackToken(token);
+			return BlockIfStmt(in, line);
+			break;
+		}
+		case DO: {
+			Parser::PushBackToken(token);
+			return DoConcurrentStmt(in, line);
+			break;
+		}
+		case SELECT: {
+			Parser::PushBackToken(token);
+			return SelectStmt(in, line);
+			break;
+		}
+		case CALL: {
+			Parser::PushBackToken(token);
+			return CallStmt(in, line);
+			break;
+		}
+		case READ: {
+			Parser::PushBackToken(token);
+			return ReadStmt(in, line);
+			break;
+		}
+		case OPEN: {
+			Parser::PushBackToken(token);
+			return OpenStmt(in, line);
+			break;
+		}
+		case WRITE: {
+			Parser::PushBackToken(token);
+			return WriteStmt(in, line);
+			break;
+		}
+		case CLOSE: {
+			Parser::PushBackToken(token);
+			return CloseStmt(in, line);
+			break;
+		}
+		default:
+			ParseError(line, "Missing Statement");
+			return false;
+	}
+	return true;
+}
+
+static bool ChargeOutput(size_t bytes, int line) {
+	if (budgets_set && budget_limit[BUDGET_OUTPUT] > 0
+		&& program->output_bytes.fetch_add(bytes, memory_order_relaxed) + bytes > budget_limit[BUDGET_OUTPUT]) {
+		return Trip(BUDGET_OUTPUT, line);
+	}
+	return true;
+}
+
+//Formats the values of a PRINT or WRITE list, from ValStack[first] on, into PrintLine as one
+//line, and charges it to the output budget
+static bool FormatRecord(size_t first, int line) {
+	PrintLine.clear();
+	for (size_t i = first; i < ValStack.size(); i++) {
+		ValStack[i].AppendTo(PrintLine);
+	}
+	ValStack.resize(first);
+	PrintLine += '\n';
+	return ChargeOutput(PrintLine.size(), line);
+}
+
+//PrintStmt ::= PRINT *, ExprList
+bool PrintStmt(istream& in, int& line) {
+	LexItem token;
+	size_t first = ValStack.size();
+
+	token = Parser::GetNextToken(in, line);
+	if (token != PRINT) {
+		ParseError(line, "Print statement syntax error.");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != DEF) {
+		ParseError(line, "Print statement syntax error.");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != COMMA) {
+		ParseError(line, "Print statement syntax error.");
+		return false;
+	}
+	if (!ExprList(in, line)) {
+		ValStack.resize(first);
+		ParseError(line, "Missing expression after Print Statement");
+		return false;
+	}
+	if (checking) {
+		ValStack.resize(first);
+		return true;
+	}
+	if (!FormatRecord(first, token.GetLinenum())) {
+		return false;
+	}
+	if (iterCtx == nullptr) {
+		program->written += PrintLine.size();
+	}
+	Out().write(PrintLine.data(), PrintLine.size()).flush();
+	return true;
+}
+
+//Takes READ input from the file instead of standard input
+bool OpenInput(const string & name) {
+	program->input_open = program->input.Open(name);
+	return program->input_open;
+}
+
+bool InputUsed() {
+	return main_program.input_open && main_program.input.Record() > 0;
+}
+
+bool UnitsUsed() {
+	return main_program.units_opened;
+}
+
+//The file of a unit is written by one statement at a time in program order, so a
+//unit cannot be used by the iterations of a DO CONCURRENT loop or what they call
+static bool UnitInConcurrent(const LexItem & statement) {
+	if (iterCtx == nullptr) {
+		return false;
+	}
+	ParseError(statement.GetLinenum(), "Runtime Error - " + statement.GetLexeme() + " Statement in DO CONCURRENT");
+	return true;
+}
+
+//The unit a READ or WRITE statement transfers data to or from, if it is open for the
+//direction and the form of the statement
+static Unit * TransferUnit(const LexItem & statement, int number, bool input, bool unformatted) {
+	auto found = program->units.find(number);
+	if (found == program->units.end()) {
+		ParseError(statement.GetLinenum(), "Runtime Error - Unit " + to_string(number) + " Not Open");
+		return nullptr;
+	}
+	if (UnitInConcurrent(statement)) {
+		return nullptr;
+	}
+	Unit & unit = found->second;
+	if (unit.input != input) {
+		ParseError(statement.GetLinenum(), "Runtime Error - Unit " + to_string(number) + " Not Open for " + (input ? "Reading" : "Writing"));
+		return nullptr;
+	}
+	if (unit.unformatted != unformatted) {
+		ParseError(statement.GetLinenum(), "Runtime Error - Unit " + to_string(number) + " Not Open for " + (unformatted ? "Unformatted" : "Formatted") + " Data");
+		return nullptr;
+	}
+	return &unit;
+}
+
+//Control list of READ or WRITE, after its left parenthesis: the unit, or * for standard
+//input or output, then * for list-directed data or nothing for an unformatted record
+//( (Expr | *) [, *] )
+static bool TransferControl(istream& in, int& line, const string & statement, Value & unit, bool & standard, bool & unformatted) {
+	standard = Parser::PeekToken(in, line) == DEF;
+	if (Parser::PeekToken(in, line) == MULT) { //* without a format: standard input and output are only formatted
+		ParseError(line, statement + " statement syntax error.");
+		return false;
+	} else if (standard) {
+		Parser::GetNextToken(in, line);
+	} else if (!Expr(in, line, unit)) {
+		ParseError(line, "Missing Unit Number");
+		return false;
+	} else if (!unit.IsInt()) {
+		ParseError(line, "Runtime Error - Illegal Type for Unit Number");
+		return false;
+	}
+	LexItem token = Parser::GetNextToken(in, line);
+	unformatted = token == RPAREN;
+	if (unformatted) {
+		return true;
+	}
+	if (token != COMMA) {
+		ParseError(line, statement + " statement syntax error.");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != MULT && token != DEF) {
+		ParseError(line, statement + " statement syntax error.");
+		return false;
+	}
+	if (Parser::GetNextToken(in, line) != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	return true;
+}
+
+//Stores the next input value into the variable, converted to its declared type
+static bool ReadValue(int line, InputReader & input, const VarRef & ref) {
+	string_view field;
+	bool quoted;
+	if (!input.NextField(field, quoted)) {
+		ParseError(line, "End of Input in Read Statement");
+		return false;
+	}
+	if (ref.type == CHARACTER) {
+		int len = ref.val->GetstrLen();
+		ref.val->SetString(string(field));
+		ref.val->FitString(len);
+		ChargeCharacter(len);
+		*ref.init = true;
+		return true;
+	}
+	Value val;
+	if (ref.type == LOGICAL ? !ParseLogical(field, quoted, val) : !ParseNumber(field, quoted, ref.type, val)) {
+		ParseError(line, "Illegal " + TypeName(ref.type) + " Input Value \"" + string(field) + "\" on Input Line " + to_string(input.Record()));
+		return false;
+	}
+	*ref.val = val;
+	*ref.init = true;
+	return true;
+}
+
+//Unformatted records hold each value as it is stored: an INTEGER as an int, a REAL as a
+//double, a LOGICAL as a four-byte word, CHARACTER data as its LEN characters and a
+//LOGICAL array as its 64-bit words of bits
+typedef int32_t StoredLogical;
+
+//Appends a value of the type to RecordBytes, converted as assignment leaves it in a variable
+static void AppendStored(Token type, const Value & val) {
+	if (type == INTEGER) {
+		int i = val.IsInt() ? val.GetInt() : (int) val.GetReal();
+		RecordBytes.append((const char *) &i, sizeof(i));
+	} else if (type == REAL) {
+		double r = val.IsReal() ? val.GetReal() : val.GetInt();
+		RecordBytes.append((const char *) &r, sizeof(r));
+	} else if (type == LOGICAL) {
+		StoredLogical b = val.GetBool();
+		RecordBytes.append((const char *) &b, sizeof(b));
+	} else {
+		RecordBytes.append(val.GetStringData(), val.GetStringSize());
+	}
+}
+
+//Copies the next value of an unformatted record into the variable; false when the record has too few bytes left
+static bool LoadStored(const VarRef & ref, const char * & at, const char * end) {
+	size_t len = ref.array != nullptr ? ref.array->Words().size() * sizeof(uint64_t)
+		: ref.type == INTEGER ? sizeof(int) : ref.type == REAL ? sizeof(double)
+		: ref.type == LOGICAL ? sizeof(StoredLogical) : ref.val->GetstrLen();
+	if ((size_t) (end - at) < len) {
+		return false;
+	}
+	if (ref.array != nullptr) {
+		ref.array->LoadWords(at);
+	} else if (ref.type == INTEGER) {
+		int i;
+		memcpy(&i, at, sizeof(i));
+		ref.val->SetType(VINT);
+		ref.val->SetInt(i);
+	} else if (ref.type == REAL) {
+		double r;
+		memcpy(&r, at, sizeof(r));
+		ref.val->SetType(VREAL);
+		ref.val->SetReal(r);
+	} else if (ref.type == LOGICAL) {
+		StoredLogical b;
+		memcpy(&b, at, sizeof(b));
+		ref.val->SetType(VBOOL);
+		ref.val->SetBool(b != 0);
+	} else {
+		ref.val->SetString(string(at, len));
+		ChargeCharacter(len);
+	}
+	if (ref.array == nullptr) {
+		*ref.init = true;
+	}
+	at += len;
+	return true;
+}
+
+//ReadStmt ::= READ *, Var {, Var} | READ ( (Expr | *) [, *] ) Var {, Var}
+//A formatted READ from a unit takes the next line of its file, an unformatted one the
+//next record, whose values are copied into the variables in the order WRITE laid them out
+bool ReadStmt(istream& in, int& line) {
+	LexItem statement = Parser::GetNextToken(in, line);
+	if (statement != READ) {
+		ParseError(line, "Read statement syntax error.");
+		return false;
+	}
+	Value number;
+	bool standard = true, unformatted = false;
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token == LPAREN) {
+		if (!TransferControl(in, line, "Read", number, standard, unformatted)) {
+			return false;
+		}
+	} else {
+		if (token != DEF) {
+			ParseError(line, "Read statement syntax error.");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+		if (token != COMMA) {
+			ParseError(line, "Read statement syntax error.");
+			return false;
+		}
+	}
+	InputReader * input = &program->input;
+	const char * record = nullptr;
+	const char * end = nullptr;
+	if (!checking && standard) {
+		if (!program->input_open) {
+			program->input_open = program->input.Open(program->input_name);
+		}
+		program->input.NextRecord();
+	} else if (!checking) {
+		Unit * unit = TransferUnit(statement, number.GetInt(), true, unformatted);
+		if (unit == nullptr) {
+			return false;
+		}
+		input = &unit->lines;
+		size_t len = 0;
+		UnitReader::Status status = unformatted ? unit->records.Next(record, len) : UnitReader::RECORD;
+		if (status != UnitReader::RECORD) {
+			ParseError(statement.GetLinenum(), string("Runtime Error - ") + (status == UnitReader::END ? "End of File" : "Bad Record") + " on Unit " + to_string(number.GetInt()));
+			return false;
+		}
+		if (!unformatted) {
+			input->NextRecord();
+		}
+		end = record + len;
+	}
+	do {
+		if (!Var(in, line, token)) {
+			ParseError(line, "Missing Variable in Read Statement");
+			return false;
+		}
+		VarRef ref;
+		Lookup(token, ref);
+		if (ref.array != nullptr && !unformatted) {
+			ParseError(line, "Illegal Use of Array");
+			return false;
+		}
+		if (ref.intent == INTENT_IN) {
+			ParseError(line, "Assignment to INTENT(IN) Argument");
+			return false;
+		}
+		if (!checking && unformatted && !LoadStored(ref, record, end)) {
+			ParseError(statement.GetLinenum(), "Runtime Error - Record Too Short on Unit " + to_string(number.GetInt()));
+			return false;
+		}
+		if (!checking && !unformatted && !ReadValue(line, *input, ref)) {
+			return false;
+		}
+		if (tracer != nullptr && ref.array == nullptr) {
+			tracer->Assign(line, token.GetLexeme(), *ref.val);
+		}
+		token = Parser::GetNextToken(in, line);
+	} while (token == COMMA);
+	Parser::PushBackToken(token);
+	return true;
+}
+
+//Specifiers of OPEN or CLOSE, by lowercase name. The first may be the unit number alone.
+//( [IDENT =] Expr {, IDENT = Expr} )
+static bool Specifiers(istream& in, int& line, const string & statement, const set<string> & allowed, map<string, Value> & specs) {
+	if (Parser::GetNextToken(in, line) != LPAREN) {
+		ParseError(line, "Missing Left Parenthesis");
+		return false;
+	}
+	LexItem token;
+	do {
+		string name = "unit";
+		token = Parser::PeekToken(in, line);
+		if (token == IDENT && Parser::PeekToken(in, line, 1) == ASSOP) {
+			Parser::GetNextToken(in, line);
+			Parser::GetNextToken(in, line);
+			name = token.GetLexeme();
+			for (char & c : name) {
+				c = tolower(c);
+			}
+		} else if (!specs.empty()) {
+			ParseError(line, "Missing Specifier Name in " + statement + " Statement");
+			return false;
+		}
+		if (!allowed.count(name) || specs.count(name)) {
+			ParseError(line, "Illegal Specifier in " + statement + " Statement");
+			return false;
+		}
+		Value val;
+		if (!Expr(in, line, val)) {
+			ParseError(line, "Missing Expression");
+			return false;
+		}
+		specs[name] = val;
+		token = Parser::GetNextToken(in, line);
+	} while (token == COMMA);
+	if (token != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	if (!specs.count("unit")) {
+		ParseError(line, "Missing Unit Number");
+		return false;
+	}
+	if (!specs["unit"].IsInt()) {
+		ParseError(line, "Runtime Error - Illegal Type for Unit Number");
+		return false;
+	}
+	return true;
+}
+
+//A CHARACTER specifier without the blanks a CHARACTER variable is padded with
+static string Trimmed(const Value & spec) {
+	string text = spec.GetString();
+	text.erase(text.find_last_not_of(' ') + 1);
+	return text;
+}
+
+//Whether a FORM or ACTION specifier chooses the second of its two words, in any case,
+//rather than the first, which is the default
+static bool SpecifierChoice(const map<string, Value> & specs, const string & name, const string & first, const string & second, int line, bool & chosen) {
+	chosen = false;
+	auto spec = specs.find(name);
+	if (spec == specs.end()) {
+		return true;
+	}
+	string upper = name;
+	transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+	if (!spec->second.IsString()) {
+		ParseError(line, "Runtime Error - Illegal Type for " + upper + " Specifier");
+		return false;
+	}
+	if (checking) {
+		return true;
+	}
+	string word = Trimmed(spec->second);
+	transform(word.begin(), word.end(), word.begin(), ::toupper);
+	chosen = word == second;
+	if (!chosen && word != first) {
+		ParseError(line, "Runtime Error - Illegal " + upper + " Specifier \"" + word + "\"");
+		return false;
+	}
+	return true;
+}
+
+//OpenStmt ::= OPEN ( [UNIT =] Expr, FILE = Expr [, FORM = Expr] [, ACTION = Expr] )
+//FORM is 'FORMATTED' (the default) or 'UNFORMATTED', ACTION 'WRITE' (the default), which
+//creates or empties the file, or 'READ'
+bool OpenStmt(istream& in, int& line) {
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != OPEN) {
+		ParseError(line, "Open statement syntax error.");
+		return false;
+	}
+	map<string, Value> specs;
+	if (!Specifiers(in, line, "OPEN", {"unit", "file", "form", "action"}, specs)) {
+		return false;
+	}
+	if (!specs.count("file")) {
+		ParseError(line, "Missing File Name");
+		return false;
+	}
+	if (!specs["file"].IsString()) {
+		ParseError(line, "Runtime Error - Illegal Type for File Name");
+		return false;
+	}
+	bool unformatted, input;
+	if (!SpecifierChoice(specs, "form", "FORMATTED", "UNFORMATTED", token.GetLinenum(), unformatted)
+		|| !SpecifierChoice(specs, "action", "WRITE", "READ", token.GetLinenum(), input)) {
+		return false;
+	}
+	if (checking) {
+		return true;
+	}
+	if (UnitInConcurrent(token)) {
+		return false;
+	}
+	int number = specs["unit"].GetInt();
+	auto opened = program->units.try_emplace(number);
+	if (!opened.second) {
+		ParseError(token.GetLinenum(), "Runtime Error - Unit " + to_string(number) + " Already Open");
+		return false;
+	}
+	Unit & unit = opened.first->second;
+	unit.path = Trimmed(specs["file"]);
+	unit.unformatted = unformatted;
+	unit.input = input;
+	program->units_opened = true;
+	bool connected = !unit.path.empty() && (!unit.input ? unit.writer.Open(unit.path, unit_buffer, unit_direct)
+		: unit.unformatted ? unit.records.Open(unit.path) : unit.lines.Open(unit.path));
+	if (!connected) {
+		ParseError(token.GetLinenum(), "Runtime Error - Cannot Open File \"" + unit.path + "\"");
+		program->units.erase(opened.first);
+		return false;
+	}
+	return true;
+}
+
+static bool ContinuesOperand(Token token);
+
+//Appends an item of an unformatted WRITE to RecordBytes. A variable that is set is copied
+//from where it is kept, by its declared type, and a LOGICAL array is written whole; any
+//other expression is evaluated first, and written by the type of its value.
+static bool RecordItem(istream& in, int& line) {
+	LexItem token = Parser::PeekToken(in, line);
+	VarRef ref;
+	if (token == IDENT && Lookup(token, ref) && (ref.array != nullptr || *ref.init || checking)
+		&& !ContinuesOperand(Parser::PeekToken(in, line, 1).GetToken())) {
+		Parser::GetNextToken(in, line);
+		if (checking) {
+			return true;
+		}
+		if (ref.array != nullptr) {
+			const vector<uint64_t> & words = ref.array->Words();
+			RecordBytes.append((const char *) words.data(), words.size() * sizeof(uint64_t));
+		} else {
+			AppendStored(ref.type, *ref.val);
+		}
+		return true;
+	}
+	Value val;
+	if (!Expr(in, line, val)) {
+		ParseError(line, "Missing Expression");
+		return false;
+	}
+	if (!checking) {
+		AppendStored(val.IsInt() ? INTEGER : val.IsReal() ? REAL : val.IsBool() ? LOGICAL : CHARACTER, val);
+	}
+	return true;
+}
+
+//Unformatted WRITE: the items are laid out in RecordBytes, from first on, and written
+//to the unit as one record
+static bool WriteRecord(istream& in, int& line, const LexItem & statement, int number) {
+	size_t first = RecordBytes.size();
+	LexItem token;
+	do {
+		if (!RecordItem(in, line)) {
+			RecordBytes.resize(first);
+			ParseError(line, "Missing expression after Write Statement");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+	} while (token == COMMA);
+	Parser::PushBackToken(token);
+	if (checking) {
+		RecordBytes.resize(first);
+		return true;
+	}
+	size_t len = RecordBytes.size() - first;
+	Unit * unit = TransferUnit(statement, number, false, true);
+	bool written = unit != nullptr && ChargeOutput(len + 2 * sizeof(RecordMarker), statement.GetLinenum());
+	if (written && len > (size_t) numeric_limits<RecordMarker>::max()) {
+		ParseError(statement.GetLinenum(), "Runtime Error - Record Too Long for Unit " + to_string(number));
+		written = false;
+	} else if (written && !unit->writer.WriteRecord(RecordBytes.data() + first, len)) {
+		ParseError(statement.GetLinenum(), "Runtime Error - Cannot Write to Unit " + to_string(number));
+		written = false;
+	}
+	RecordBytes.resize(first);
+	return written;
+}
+
+//WriteStmt ::= WRITE ( (Expr | *) [, *] ) ExprList
+bool WriteStmt(istream& in, int& line) {
+	size_t first = ValStack.size();
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != WRITE) {
+		ParseError(line, "Write statement syntax error.");
+		return false;
+	}
+	if (Parser::GetNextToken(in, line) != LPAREN) {
+		ParseError(line, "Missing Left Parenthesis");
+		return false;
+	}
+	Value unit;
+	bool standard, unformatted;
+	if (!TransferControl(in, line, "Write", unit, standard, unformatted)) {
+		return false;
+	}
+	if (unformatted) {
+		return WriteRecord(in, line, token, unit.GetInt());
+	}
+	if (!ExprList(in, line)) {
+		ValStack.resize(first);
+		ParseError(line, "Missing expression after Write Statement");
+		return false;
+	}
+	if (checking) {
+		ValStack.resize(first);
+		return true;
+	}
+	UnitWriter * writer = nullptr;
+	if (!standard) {
+		Unit * found = TransferUnit(token, unit.GetInt(), false, false);
+		if (found == nullptr) {
+			ValStack.resize(first);
+			return false;
+		}
+		writer = &found->writer;
+	}
+	if (!FormatRecord(first, token.GetLinenum())) {
+		return false;
+	}
+	if (writer != nullptr) {
+		if (!writer->Write(PrintLine.data(), PrintLine.size())) {
+			ParseError(token.GetLinenum(), "Runtime Error - Cannot Write to Unit " + to_string(unit.GetInt()));
+			return false;
+		}
+		return true;
+	}
+	if (iterCtx == nullptr) {
+		program->written += PrintLine.size();
+	}
+	Out().write(PrintLine.data(), PrintLine.size()).flush();
+	return true;
+}
+
+//CloseStmt ::= CLOSE ( [UNIT =] Expr )
+bool CloseStmt(istream& in, int& line) {
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != CLOSE) {
+		ParseError(line, "Close statement syntax error.");
+		return false;
+	}
+	map<string, Value> specs;
+	if (!Specifiers(in, line, "CLOSE", {"unit"}, specs)) {
+		return false;
+	}
+	if (checking) {
+		return true;
+	}
+	if (UnitInConcurrent(token)) {
+		return false;
+	}
+	int unit = specs["unit"].GetInt();
+	auto found = program->units.find(unit);
+	if (found == program->units.end()) { //Closing a unit that is not open does nothing, as in Fortran
+		return true;
+	}
+	bool written = found->second.writer.Close();
+	program->units.erase(found);
+	if (!written) {
+		ParseError(token.GetLinenum(), "Runtime Error - Cannot Write to Unit " + to_string(unit));
+		return false;
+	}
+	return true;
+}
+
+//Closes the units still open at the end of the program
+static bool CloseUnits(int line) {
+	bool written = true;
+	for (auto & unit : program->units) {
+		if (!unit.second.writer.Close()) {
+			ParseError(line, "Runtime Error - Cannot Write to Unit " + to_string(unit.first));
+			written = false;
+		}
+	}
+	program->units.clear();
+	return written;
+}
+
+//SimpleIfStatement ::= IF (RelExpr) Stmt
+//BlockIfStmt ::= IF (RelExpr) THEN {Stmt} [ELSE {Stmt}] END IF
+bool BlockIfStmt(istream& in, int& line) {
+	bool flag;
+	LexItem token = Parser::GetNextToken(in, line);
+	Value retVal;
+
+	if (token != IF) {
+		ParseError(line, "Missing IF");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != LPAREN) {
+		ParseError(line, "Missing Left Parenthesis");
+		return false;
+	}
+	if (!RelExpr(in, line, retVal)) {
+		ParseError(line, "Missing If-Statement Condition");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (retVal.GetType() != VBOOL) {
+		ParseError(line, "Runtime Error - Illegal Type for If-Statement Condition");
+		return false;
+	}
+	if (token != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	bool relExpr = retVal.GetBool();
+	if (tracer != nullptr) {
+		tracer->Branch(line, relExpr);
+	}
+	token = Parser::GetNextToken(in, line);
+	
+	//SimpleIfStmt
+	if (token != THEN) { 
+		if (relExpr || checking) {
+			Parser::PushBackToken(token);
+			if (SimpleStmt(in, line)) {
+				return true;
+			} else {
+				ParseError(line, "Missing Simple Statement");
+				return false;
+			}
+		} else {
+			return true;
+		}
+	}
+
+	//BlockIfStmt
+	if (relExpr || checking) {
+		while (true) {
+			token = Parser::GetNextToken(in, line);
+			if (token == ELSE || token == END) {
+				break;
+			} else {
+				Parser::PushBackToken(token);
+			}
+			if (!Stmt(in, line)) {
+				ParseError(line, "Missing Statement");
+				return false;
+			}
+		}
+	} else {
+		while (token != ELSE && token != END && token != DONE) {
+			token = Parser::GetNextToken(in, line);
+			if (token == DO && !SkipDoBody(in, line)) {
+				return false;
+			}
+			if (token == SELECT && !SkipSelect(in, line)) {
+				return false;
+			}
+		}
+	}
+
+	if (token == ELSE) {
+		if (!relExpr || checking) {
+			while (true) {
+				token = Parser::GetNextToken(in, line);
+				if (token == END) {
+					break;
+				} else {
+					Parser::PushBackToken(token);
+				}
+				if (!Stmt(in, line)) {
+					ParseError(line, "Missing Statement");
+					return false;
+				}
+			}
+		} else {
+			while (token != END && token != DONE) {
+				token = Parser::GetNextToken(in, line);
+				if (token == DO && !SkipDoBody(in, line)) {
+					return false;
+				}
+				if (token == SELECT && !SkipSelect(in, line)) {
+					return false;
+				}
+			}
+		}
+	} 
+
+	if (token == END) {
+		token = Parser::GetNextToken(in, line);
+		if (token != IF) {
+			ParseError(line, "Missing IF at end of IF statement");
+			return false;
+		}
+		return true;
+	} else {
+		ParseError(line, "Missing END");
+		return false;
+	}
+	return flag;
+}
+
+//Reads the tokens of a DO CONCURRENT body, up to and including its END DO
+static bool CollectDoBody(istream& in, int& line, vector<LexItem> & body) {
+	int depth = 0;
+	LexItem token = Parser::GetNextToken(in, line);
+	while (token != DONE) {
+		if (token == DO) {
+			depth++;
+		} else if (token == END) {
+			LexItem next = Parser::GetNextToken(in, line);
+			if (next == DO) {
+				if (depth == 0) {
+					return true;
+				}
+				depth--;
+				body.push_back(token);
+				token = next;
+			} else {
+				body.push_back(token);
+				token = next;
+				continue;
+			}
+		}
+		body.push_back(token);
+		token = Parser::GetNextToken(in, line);
+	}
+	return false;
+}
+
+//Skips a DO CONCURRENT construct in an IF branch that is not taken
+static bool SkipDoBody(istream& in, int& line) {
+	vector<LexItem> body;
+	if (!CollectDoBody(in, line, body)) {
+		ParseError(line, "Missing END DO");
+		return false;
+	}
+	return true;
+}
+
+//Reads the tokens of a SELECT CASE construct after its SELECT, up to and including its END SELECT
+static bool CollectSelect(istream& in, int& line, vector<LexItem> & tokens) {
+	int depth = 0;
+	LexItem token = Parser::GetNextToken(in, line);
+	while (token != DONE && token != ERR) {
+		tokens.push_back(token);
+		if (token == SELECT) {
+			depth++;
+		} else if (token == END && Parser::PeekToken(in, line) == SELECT) {
+			tokens.push_back(Parser::GetNextToken(in, line));
+			if (depth == 0) {
+				return true;
+			}
+			depth--;
+		}
+		token = Parser::GetNextToken(in, line);
+	}
+	return false;
+}
+
+//Skips a SELECT CASE construct in an IF branch that is not taken
+static bool SkipSelect(istream& in, int& line) {
+	vector<LexItem> tokens;
+	if (!CollectSelect(in, line, tokens)) {
+		ParseError(line, "Missing END SELECT");
+		return false;
+	}
+	return true;
+}
+
+int SelectTable::Dispatch(const Value & selector) const {
+	int arm = -1;
+	if (selector.IsInt()) {
+		long long v = selector.GetInt();
+		if (!jump.empty()) {
+			if (v >= base && v - base < (long long) jump.size()) {
+				arm = jump[v - base];
+			}
+		} else {
+			//The last range starting at or below v is the only one that can hold it
+			auto next = upper_bound(ranges.begin(), ranges.end(), v, [](long long x, const CaseRange & r) { return x < r.lo; });
+			if (next != ranges.begin() && v <= prev(next)->hi) {
+				arm = prev(next)->arm;
+			}
+		}
+	} else {
+		string text = selector.GetString();
+		auto found = strings.find(text.substr(0, text.find_last_not_of(' ') + 1));
+		if (found != strings.end()) {
+			arm = found->second;
+		}
+	}
+	return arm >= 0 ? arm : fallback;
+}
+
+//CaseValue ::= [+ | -] ICONST | SCONST
+static bool CaseConstant(const vector<LexItem> & toks, size_t & i, Token & type, int & ival, string & sval) {
+	int sign = 1;
+	if (i < toks.size() && (toks[i] == PLUS || toks[i] == MINUS)) {
+		sign = toks[i] == MINUS ? -1 : 1;
+		i++;
+	}
+	if (i < toks.size() && toks[i] == ICONST) {
+		long long v = sign * stoll(toks[i].GetLexeme());
+		if (v < INT_MIN || v > INT_MAX) {
+			return false;
+		}
+		type = INTEGER;
+		ival = (int) v;
+		i++;
+		return true;
+	}
+	if (sign == 1 && i < toks.size() && toks[i] == SCONST) {
+		type = CHARACTER;
+		sval = toks[i].GetLexeme();
+		sval = sval.substr(0, sval.find_last_not_of(' ') + 1);
+		i++;
+		return true;
+	}
+	return false;
+}
+
+//Compiles the construct whose arms start at toks[start]:
+//{CASE (CaseSelector {, CaseSelector}) {Stmt}} [CASE DEFAULT {Stmt}] END SELECT, in any order
+//CaseSelector ::= CaseValue | CaseValue : | : CaseValue | CaseValue : CaseValue
+static bool CompileSelect(const vector<LexItem> & toks, size_t start, int line, SelectTable & table) {
+	size_t i = start;
+	auto at = [&](size_t k) { return k < toks.size() ? toks[k].GetToken() : DONE; };
+	auto lineAt = [&](size_t k) { return k < toks.size() ? toks[k].GetLinenum() : line; };
+	while (at(i) == CASE) {
+		int arm = table.arms.size();
+		int caseLine = lineAt(i++);
+		if (at(i) == DEFAULT) {
+			if (table.fallback >= 0) {
+				ParseError(caseLine, "Duplicate CASE DEFAULT");
+				return false;
+			}
+			table.fallback = arm;
+			i++;
+		} else {
+			if (at(i) != LPAREN) {
+				ParseError(caseLine, "Missing Left Parenthesis");
+				return false;
+			}
+			do {
+				i++;
+				Token type = INTEGER, highType = INTEGER;
+				CaseRange range = {INT_MIN, INT_MAX, arm};
+				string text;
+				bool low = at(i) != COLON;
+				if (low && !CaseConstant(toks, i, type, range.lo, text)) {
+					ParseError(caseLine, "Illegal CASE Value");
+					return false;
+				}
+				if (at(i) == COLON) {
+					i++;
+					bool high = at(i) != RPAREN && at(i) != COMMA;
+					//Ranges are only of INTEGER values, and need at least one end
+					if ((!low && !high) || (high && !CaseConstant(toks, i, highType, range.hi, text)) || type == CHARACTER || highType == CHARACTER) {
+						ParseError(caseLine, "Illegal CASE Value");
+						return false;
+					}
+				} else {
+					range.hi = range.lo;
+				}
+				if (table.type != ERR && table.type != type) {
+					ParseError(caseLine, "Mixed Types of CASE Values");
+					return false;
+				}
+				table.type = type;
+				if (type == CHARACTER) {
+					if (!table.strings.emplace(text, arm).second) {
+						ParseError(caseLine, "Overlapping CASE Values");
+						return false;
+					}
+				} else if (range.lo <= range.hi) {
+					table.ranges.push_back(range);
+				}
+			} while (at(i) == COMMA);
+			if (at(i) != RPAREN) {
+				ParseError(caseLine, "Missing Right Parenthesis");
+				return false;
+			}
+			i++;
+		}
+		table.arms.push_back(i - start);
+		//The arm's statements run up to the next CASE or END SELECT of this construct
+		for (int depth = 0; at(i) != DONE; i++) {
+			if (at(i) == SELECT) {
+				depth++;
+			} else if (at(i) == END && at(i + 1) == SELECT) {
+				if (depth == 0) {
+					break;
+				}
+				depth--;
+				i++;
+			} else if (at(i) == CASE && depth == 0) {
+				break;
+			}
+		}
+	}
+	if (at(i) != END) {
+		ParseError(lineAt(i), table.arms.empty() ? "Missing CASE" : "Missing END SELECT");
+		return false;
+	}
+	table.endLine = lineAt(i + 1);
+	table.length = i + 2 - start;
 
-	static LexItem GetNextToken(istream& in, int& line) {
-		if(pushed_back) {
-			pushed_back = false;
-			return pushed_token;
+	sort(table.ranges.begin(), table.ranges.end(), [](const CaseRange & a, const CaseRange & b) { return a.lo < b.lo; });
+	long long covered = 0;
+	for (size_t k = 0; k < table.ranges.size(); k++) {
+		if (k > 0 && table.ranges[k].lo <= table.ranges[k - 1].hi) {
+			ParseError(line, "Overlapping CASE Values");
+			return false;
 		}
-		return getNextToken(in, line);
+		covered += (long long) table.ranges[k].hi - table.ranges[k].lo + 1;
 	}
-	static void PushBackToken(LexItem & t) {
-		if(pushed_back) {
-			abort();
+	//A jump table when at least a quarter of its entries lead to an arm
+	if (!table.ranges.empty()) {
+		long long span = (long long) table.ranges.back().hi - table.ranges.front().lo + 1;
+		if (span <= 4 * covered && span <= 1 << 16) {
+			table.base = table.ranges.front().lo;
+			table.jump.assign(span, -1);
+			for (const CaseRange & r : table.ranges) {
+				fill(table.jump.begin() + (r.lo - table.base), table.jump.begin() + (r.hi - table.base) + 1, r.arm);
+			}
 		}
-		pushed_back = true;
-		pushed_token = t;	
 	}
+	return true;
 }
 
-static int error_count = 0;
-int ErrCount(){
-    return error_count;
+//Runs the statements of the arm starting at pos of the tokens being replayed, up to its CASE or END SELECT
+static bool RunArm(istream& in, int& line, size_t pos) {
+	Parser::replay_pos = pos;
+	Parser::ahead = Parser::Lookahead();
+	LexItem token = Parser::GetNextToken(in, line);
+	while (token != CASE && token != END && token != DONE) {
+		Parser::PushBackToken(token);
+		if (!Stmt(in, line)) {
+			ParseError(line, "Missing Statement");
+			return false;
+		}
+		token = Parser::GetNextToken(in, line);
+	}
+	return true;
 }
 
-void ParseError(int line, string msg){
-	++error_count;
-	cout << line << ": " << msg << endl;
+static bool StatementStart(const vector<LexItem> & body, size_t i) {
+	Token t = body[i].GetToken();
+	if (t == PRINT || t == READ || t == IF || t == THEN || t == ELSE || t == END || t == DO || t == CALL || t == SELECT || t == CASE
+		|| t == OPEN || t == WRITE || t == CLOSE) {
+		return true;
+	}
+	return t == IDENT && i + 1 < body.size() && body[i + 1] == ASSOP;
 }
 
-//Prog ::= PROGRAM IDENT {Decl} {Stmt} END PROGRAM IDENT
-bool Prog(istream& in, int& line) {
-    LexItem token = Parser::GetNextToken(in, line);
-    if (token != PROGRAM) {
-        ParseError(line, "Missing Program");
-        return false;
-    }
-    token = Parser::GetNextToken(in, line);
-	if (token != IDENT) {
-		ParseError(line, "Missing Program name");
-		return false;
-	}
-	
-	token = Parser::GetNextToken(in, line);
-	while (token == REAL || token == INTEGER || token == CHARACTER) { //Iterating through declarations, ending when token isn't a Type
-		Parser::PushBackToken(token);
-		if (!Decl(in, line)) {
-			ParseError(line, "Incorrect Declaration in Program");
+//Iterations of a DO CONCURRENT body may run in any order and at the same time,
+//so the only assignments allowed are reductions, Var = Var (+ | - | *) Operand,
+//whose operands are folded in iteration order after the loop. A reduction
+//variable may not be referenced anywhere else in the body.
+static bool CheckConcurrentBody(const vector<LexItem> & body, const string & index, set<string> & reductions) {
+	set<string> indices;
+	indices.insert(index);
+	vector<bool> exempt(body.size(), false); //Identifiers that are index bindings or part of a reduction
+
+	for (size_t i = 0; i < body.size(); i++) {
+		if (body[i] == READ) { //Iterations would take their values in no particular order
+			ParseError(body[i].GetLinenum(), "READ Statement in DO CONCURRENT");
 			return false;
 		}
-		token = Parser::GetNextToken(in, line);
-		//cout << "Prog Decl " << token << endl;
+		//or write a unit's file in no particular order; WRITE (*, *) is buffered like PRINT
+		if (body[i] == OPEN || body[i] == CLOSE || (body[i] == WRITE && !(i + 2 < body.size() && body[i + 2] == DEF))) {
+			ParseError(body[i].GetLinenum(), body[i].GetLexeme() + " Statement in DO CONCURRENT");
+			return false;
+		}
+		if (body[i] == DO) {
+			if (i + 3 < body.size() && body[i + 3] == IDENT) {
+				string name = body[i + 3].GetLexeme();
+				if (!indices.insert(name).second) {
+					ParseError(body[i].GetLinenum(), "DO CONCURRENT Index Variable Reused in Nested Loop");
+					return false;
+				}
+				exempt[i + 3] = true;
+				i += 3;
+			}
+			continue;
+		}
+		//An element of an array shares its word with the elements other iterations may store
+		if (body[i] == IDENT && i + 1 < body.size() && body[i + 1] == LPAREN && program->arrays.count(body[i].GetLexeme())) {
+			size_t k = i + 1;
+			for (int parens = 0; k < body.size(); k++) {
+				if (body[k] == LPAREN) {
+					parens++;
+				} else if (body[k] == RPAREN && --parens == 0) {
+					break;
+				}
+			}
+			if (k + 1 < body.size() && body[k + 1] == ASSOP) {
+				ParseError(body[i].GetLinenum(), "Illegal Assignment to Shared Variable in DO CONCURRENT");
+				return false;
+			}
+			continue;
+		}
+		if (body[i] != IDENT || i + 1 >= body.size() || body[i + 1] != ASSOP) {
+			continue;
+		}
+		string name = body[i].GetLexeme();
+		int stmtLine = body[i].GetLinenum();
+		if (indices.count(name)) {
+			ParseError(stmtLine, "Assignment to DO CONCURRENT Index Variable");
+			return false;
+		}
+		auto sym = program->SymTable.find(name);
+		bool numeric = sym != program->SymTable.end() && (sym->second == INTEGER || sym->second == REAL);
+		if (!numeric || i + 3 >= body.size() || body[i + 2] != IDENT || body[i + 2].GetLexeme() != name
+			|| (body[i + 3] != PLUS && body[i + 3] != MINUS && body[i + 3] != MULT)) {
+			ParseError(stmtLine, "Illegal Assignment to Shared Variable in DO CONCURRENT");
+			return false;
+		}
+		//The operand is evaluated on its own, so it must bind tighter than the reduction operator
+		Token op = body[i + 3].GetToken();
+		int parens = 0;
+		for (size_t k = i + 4; k < body.size() && !StatementStart(body, k); k++) {
+			if (body[k] == LPAREN) {
+				parens++;
+			} else if (body[k] == RPAREN) {
+				parens--;
+			} else if (parens == 0 && (body[k] == PLUS || body[k] == MINUS || body[k] == CAT || body[k] == EQ || body[k] == LTHAN
+				|| body[k] == GTHAN || body[k] == AND || body[k] == OR || (op == MULT && (body[k] == MULT || body[k] == DIV)))) {
+				ParseError(stmtLine, "Illegal Assignment to Shared Variable in DO CONCURRENT");
+				return false;
+			}
+		}
+		reductions.insert(name);
+		exempt[i] = true;
+		exempt[i + 2] = true;
 	}
 
-	while (token == IF || token == PRINT || token == IDENT) { //Iterating through statements, ending when token isn't a statement
-		Parser::PushBackToken(token);
-		if (!Stmt(in, line)) {
-			ParseError(token.GetLinenum(), "Incorrect Statement in Program");
+	for (size_t i = 0; i < body.size(); i++) {
+		if (body[i] != IDENT || exempt[i]) {
+			continue;
+		}
+		string name = body[i].GetLexeme();
+		if (program->Subprograms.count(name) && ((i + 1 < body.size() && body[i + 1] == LPAREN) || (i > 0 && body[i - 1] == CALL))) {
+			continue;
+		}
+		if (program->defVar.find(name) == program->defVar.end()) {
+			if (i + 1 < body.size() && body[i + 1] == LPAREN && IntrinsicOf(name) != INTRINSIC_NONE) {
+				continue;
+			}
+			ParseError(body[i].GetLinenum(), "Undeclared Variable");
+			return false;
+		}
+		if (reductions.count(name)) {
+			ParseError(body[i].GetLinenum(), "Reduction Variable Referenced Outside Its Reduction");
 			return false;
 		}
-		token = Parser::GetNextToken(in, line);
-		//cout << "Prog Stmt " << token << endl;
 	}
-	
-	if (token != END) {
-		ParseError(line, "Missing END of Program");
+	return true;
+}
+
+//SelectStmt ::= SELECT CASE (Expr) {CASE (CaseSelector {, CaseSelector}) {Stmt}} [CASE DEFAULT {Stmt}] END SELECT
+//The construct is compiled the first time it runs from recorded tokens and then jumps
+//straight to its arm; read from the input, it is recorded first, and only runs once.
+bool SelectStmt(istream& in, int& line) {
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != SELECT) {
+		ParseError(line, "Missing SELECT");
 		return false;
 	}
+	int selectLine = token.GetLinenum();
+	int selectPos = token.GetPos();
 	token = Parser::GetNextToken(in, line);
-	if (token != PROGRAM) {
-		ParseError(line, "Missing Program");
+	if (token != CASE) {
+		ParseError(line, "Missing CASE");
 		return false;
 	}
 	token = Parser::GetNextToken(in, line);
-	if (token != IDENT) {
-		ParseError(line, "Missing Program name");
+	if (token != LPAREN) {
+		ParseError(line, "Missing Left Parenthesis");
 		return false;
 	}
-	return true;
-}
-
-
-//Decl ::= Type :: VarList
-//Type ::= INTEGER | REAL | CHARACTER [(LEN = ICONST)]
-bool Decl(istream& in, int& line) {
-	string len;
-	LexItem token = Parser::GetNextToken(in, line);
-	if (token != INTEGER && token != REAL && token != CHARACTER) {
-		ParseError(line, "Missing Type");
+	Value selector;
+	if (!Expr(in, line, selector)) {
+		ParseError(line, "Missing SELECT CASE Expression");
 		return false;
 	}
-	LexItem type = token;
 	token = Parser::GetNextToken(in, line);
+	if (token != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	if (selector.GetType() != VINT && selector.GetType() != VSTRING) {
+		ParseError(line, "Runtime Error - Illegal Type for SELECT CASE Expression");
+		return false;
+	}
 
-	if (token == LPAREN) { //Type has a length
-		token = Parser::GetNextToken(in, line);
-		if (token != LEN) {
-			ParseError(line, "Missing Length");
+	const vector<LexItem> * replayed = Parser::replay;
+	size_t start;
+	vector<LexItem> recorded;
+	SelectTable compiled;
+	const SelectTable * table = &compiled;
+	bool cache = false;
+	if (replayed != nullptr) {
+		//The same position in another vector is the same construct, recorded again
+		start = Parser::replay_pos - Parser::ahead.count;
+		lock_guard<mutex> lock(program->select_lock);
+		auto found = program->selects.find(selectPos);
+		if (found != program->selects.end()) {
+			table = &found->second;
+		}
+		cache = found == program->selects.end() && selectPos >= 0;
+	} else {
+		start = 0;
+		if (!CollectSelect(in, line, recorded)) {
+			ParseError(line, "Missing END SELECT");
 			return false;
 		}
-		token = Parser::GetNextToken(in, line);
-		if (token != ASSOP) {
-			ParseError(line, "Missing Assignment Operator");
+	}
+	const vector<LexItem> & toks = replayed != nullptr ? *replayed : recorded;
+	if (table == &compiled) {
+		if (!CompileSelect(toks, start, line, compiled)) {
 			return false;
 		}
+		if (cache) {
+			lock_guard<mutex> lock(program->select_lock);
+			table = &program->selects.emplace(selectPos, move(compiled)).first->second;
+		}
+	}
+	if ((table->type == INTEGER && !selector.IsInt()) || (table->type == CHARACTER && !selector.IsString())) {
+		ParseError(selectLine, "Runtime Error - Illegal Type for SELECT CASE Expression");
+		return false;
+	}
+
+	Parser::Lookahead savedAhead = move(Parser::ahead);
+	size_t savedPos = Parser::replay_pos;
+	int savedLine = line;
+	Parser::replay = &toks;
+	bool status = true;
+	if (checking) {
+		for (size_t arm = 0; arm < table->arms.size() && status; arm++) {
+			status = RunArm(in, line, start + table->arms[arm]);
+		}
+	} else {
+		int arm = table->Dispatch(selector);
+		if (arm >= 0) {
+			status = RunArm(in, line, start + table->arms[arm]);
+		}
+	}
+	Parser::replay = replayed;
+	if (replayed != nullptr) {
+		Parser::replay_pos = start + table->length;
+		Parser::ahead = Parser::Lookahead();
+	} else {
+		Parser::replay_pos = savedPos;
+		Parser::ahead = move(savedAhead);
+	}
+	if (status) { //After an error, line stays where it was found
+		line = replayed != nullptr ? table->endLine : savedLine; //The input has been read up to the END SELECT
+	}
+	return status;
+}
+
+//Executes a recorded DO CONCURRENT or subprogram body once; only a subprogram body starts with declarations
+static bool ExecBody(istream& in, int& line, const vector<LexItem> & body, bool declarations = false) {
+	const vector<LexItem> * savedReplay = Parser::replay;
+	size_t savedPos = Parser::replay_pos;
+	Parser::Lookahead savedAhead = move(Parser::ahead); //A CALL without arguments leaves the token after it read ahead
+	Parser::replay = &body;
+	Parser::replay_pos = 0;
+	Parser::ahead = Parser::Lookahead();
+
+	bool status = true;
+	LexItem token = Parser::GetNextToken(in, line);
+	while (declarations && (token == REAL || token == INTEGER || token == CHARACTER || token == LOGICAL)) {
+		Parser::PushBackToken(token);
+		if (!Decl(in, line)) {
+			ParseError(line, "Incorrect Declaration in Subprogram");
+			status = false;
+			token = LexItem(DONE, "", line);
+			break;
+		}
 		token = Parser::GetNextToken(in, line);
-		if (token != ICONST) {
-			ParseError(line, "Incorrect Initialization of a String Length");
-			return false;
+	}
+	while (token != DONE) {
+		Parser::PushBackToken(token);
+		if (!Stmt(in, line)) {
+			ParseError(line, "Missing Statement");
+			status = false;
+			break;
 		}
-		len =  token.GetLexeme();
 		token = Parser::GetNextToken(in, line);
-		if (token != RPAREN) {
-			ParseError(line, "Missing Right Parenthesis");
+	}
+
+	Parser::ahead = move(savedAhead);
+	Parser::replay = savedReplay;
+	Parser::replay_pos = savedPos;
+	return status;
+}
+
+//Splits the iteration space into chunks run on the work-stealing pool. Each chunk
+//buffers its own output, so PRINT lines and diagnostics appear exactly as they
+//would in a serial run, and execution stops at the first iteration that fails.
+static bool RunConcurrent(istream& in, int line, const string & index, const vector<LexItem> & body, const set<string> & reductions, int lower, int upper) {
+	if (upper < lower) {
+		return true;
+	}
+	for (const string & var : reductions) {
+		if (!program->initVar[var]) {
+			ParseError(line, "Using Uninitialized Variable");
 			return false;
 		}
-	} else {
-		Parser::PushBackToken(token);
 	}
 
+	WorkStealingPool & pool = Pool();
+	long long count = (long long) upper - lower + 1;
+	long long chunkSize = max(1LL, count / (pool.Size() * 8LL));
+	size_t chunks = (count + chunkSize - 1) / chunkSize;
+	vector<IterContext> results(chunks);
+	atomic<long long> firstFailed(count);
+
+	ProgramContext * owner = program;
+	pool.Run(chunks, [&](size_t c) {
+		IterContext & ctx = results[c];
+		ctx.reductions = &reductions;
+		iterCtx = &ctx;
+		program = owner;
+		try {
+			long long end = min(count, (long long) (c + 1) * chunkSize);
+			for (long long i = (long long) c * chunkSize; i < end && i < firstFailed.load(); i++) {
+				ctx.locals[index] = Value((int) (lower + i));
+				int iterLine = line;
+				if (!Safepoint(line) || !ExecBody(in, iterLine, body)) {
+					ctx.failed = i;
+					long long seen = firstFailed.load();
+					while (i < seen && !firstFailed.compare_exchange_weak(seen, i));
+					break;
+				}
+			}
+		} catch (...) {
+			iterCtx = nullptr;
+			throw;
+		}
+		iterCtx = nullptr;
+	});
+
+	if (mem_report) {
+		long long buffered = 0;
+		for (IterContext & ctx : results) {
+			buffered += ctx.out.tellp();
+		}
+		ChargeTransient(MEM_OUTPUT, buffered);
+	}
+	for (IterContext & ctx : results) {
+		string text = ctx.out.str();
+		program->written += text.size();
+		*program->out << text;
+		program->error_count += ctx.errors;
+		for (const Contribution & c : ctx.contributions) {
+			Value & var = program->TempsResults[c.var];
+			if (c.op == PLUS) {
+				var = var + c.val;
+			} else if (c.op == MINUS) {
+				var = var - c.val;
+			} else {
+				var = var * c.val;
+			}
+		}
+		if (ctx.failed >= 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//Checks a DO CONCURRENT body once, as a single iteration run on the calling thread
+static bool CheckIteration(istream& in, int line, const string & index, const vector<LexItem> & body, const set<string> & reductions) {
+	if (iterCtx != nullptr) {
+		iterCtx->locals[index] = Value(1);
+		bool status = ExecBody(in, line, body);
+		iterCtx->locals.erase(index);
+		return status;
+	}
+	IterContext ctx;
+	ctx.reductions = &reductions;
+	ctx.locals[index] = Value(1);
+	iterCtx = &ctx;
+	bool status = ExecBody(in, line, body);
+	iterCtx = nullptr;
+	*program->out << ctx.out.str();
+	program->error_count += ctx.errors;
+	return status;
+}
+
+//DoConcurrentStmt ::= DO CONCURRENT (Var = Expr : Expr) {Stmt} END DO
+bool DoConcurrentStmt(istream& in, int& line) {
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != DO) {
+		ParseError(line, "Missing DO");
+		return false;
+	}
 	token = Parser::GetNextToken(in, line);
-	if (token != DCOLON) {
-		ParseError(line, "Missing Double Colon");
+	if (token != CONCURRENT) {
+		ParseError(line, "Missing CONCURRENT");
 		return false;
 	}
-	if (len == "") {
-		if (!VarList(in, line, type)) {
-			ParseError(line, "Missing Variable List");
+	token = Parser::GetNextToken(in, line);
+	if (token != LPAREN) {
+		ParseError(line, "Missing Left Parenthesis");
+		return false;
+	}
+	LexItem idtok;
+	if (!Var(in, line, idtok)) {
+		ParseError(line, "Missing DO CONCURRENT Index Variable");
+		return false;
+	}
+	string index = idtok.GetLexeme();
+	if (program->SymTable.find(index)->second != INTEGER) {
+		ParseError(line, "Illegal Type for DO CONCURRENT Index Variable");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != ASSOP) {
+		ParseError(line, "Missing Assignment Operator");
+		return false;
+	}
+	Value lower, upper;
+	if (!Expr(in, line, lower)) {
+		ParseError(line, "Missing DO CONCURRENT Lower Bound");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != COLON) {
+		ParseError(line, "Missing Colon");
+		return false;
+	}
+	if (!Expr(in, line, upper)) {
+		ParseError(line, "Missing DO CONCURRENT Upper Bound");
+		return false;
+	}
+	token = Parser::GetNextToken(in, line);
+	if (token != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	if (!lower.IsInt() || !upper.IsInt()) {
+		ParseError(line, "Runtime Error - Illegal Type for DO CONCURRENT Bound");
+		return false;
+	}
+	int headLine = line;
+
+	vector<LexItem> body;
+	if (!CollectDoBody(in, line, body)) {
+		ParseError(line, "Missing END DO");
+		return false;
+	}
+	if (iterCtx == nullptr) {
+		ChargeTransient(MEM_TOKENS, TokenBytes(body));
+	}
+	set<string> reductions;
+	if (!CheckConcurrentBody(body, index, reductions)) {
+		return false;
+	}
+
+	if (checking) {
+		return CheckIteration(in, line, index, body, reductions);
+	}
+	if (iterCtx != nullptr) {
+		//A nested construct runs serially inside the iteration of the enclosing one
+		for (long long i = lower.GetInt(); i <= upper.GetInt(); i++) {
+			iterCtx->locals[index] = Value((int) i);
+			if (!ExecBody(in, line, body)) {
+				iterCtx->locals.erase(index);
+				return false;
+			}
+		}
+		iterCtx->locals.erase(index);
+		return true;
+	}
+	return RunConcurrent(in, headLine, index, body, reductions, lower.GetInt(), upper.GetInt());
+}
+
+//Returns the position after the expression starting at i, or string::npos when there is none.
+//Only used to find the variables a subprogram declares; the expression itself is checked when it is evaluated.
+static size_t SkipExpr(const vector<LexItem> & body, size_t i) {
+	int depth = 0;
+	bool operand = true; //An operand is expected next
+	for (; i < body.size(); i++) {
+		Token t = body[i].GetToken();
+		if (operand) {
+			if (t == PLUS || t == MINUS || t == NOT) {
+				continue;
+			} else if (t == LPAREN) {
+				depth++;
+			} else if (t == IDENT && i + 1 < body.size() && body[i + 1] == LPAREN) { //Function reference
+				depth++;
+				i++;
+				if (i + 1 < body.size() && body[i + 1] == RPAREN) {
+					depth--;
+					i++;
+					operand = false;
+				}
+			} else if (t == IDENT || t == ICONST || t == RCONST || t == SCONST || t == BCONST) {
+				operand = false;
+			} else {
+				return string::npos;
+			}
+		} else if (t == RPAREN && depth > 0) {
+			depth--;
+		} else if ((t == COMMA && depth > 0) || t == PLUS || t == MINUS || t == MULT || t == DIV || t == POW || t == CAT
+			|| t == EQ || t == LTHAN || t == GTHAN || t == AND || t == OR) {
+			operand = true;
+		} else {
+			break;
+		}
+	}
+	return operand || depth > 0 ? string::npos : i;
+}
+
+//Gives every variable declared at the start of a subprogram body a slot of its frame,
+//and resolves the identifiers of the body to those slots
+static bool ResolveSlots(Subprogram & def, const string & name, const vector<string> & params, int line) {
+	vector<LexItem> & body = def.body;
+	map<string, int> index;
+	size_t i = 0;
+	while (i < body.size() && (body[i] == INTEGER || body[i] == REAL || body[i] == CHARACTER || body[i] == LOGICAL)) {
+		Token type = body[i++].GetToken();
+		int strlen = type == CHARACTER ? 1 : 0;
+		bool hasLen = false;
+		if (i < body.size() && body[i] == LPAREN) {
+			if (i + 4 >= body.size() || body[i + 1] != LEN || body[i + 2] != ASSOP || body[i + 3] != ICONST || body[i + 4] != RPAREN) {
+				ParseError(body[i].GetLinenum(), "Incorrect Declaration in Subprogram");
+				return false;
+			}
+			strlen = stoi(body[i + 3].GetLexeme());
+			hasLen = true;
+			i += 5;
+		}
+		Intent intent = INTENT_NONE;
+		if (i < body.size() && body[i] == COMMA) {
+			if (i + 4 < body.size() && body[i + 1] == INTENT && body[i + 2] == LPAREN && body[i + 3] == IDENT && body[i + 4] == RPAREN) {
+				intent = IntentOf(body[i + 3].GetLexeme());
+			}
+			if (intent == INTENT_NONE) {
+				ParseError(body[i].GetLinenum(), "Incorrect INTENT Specification");
+				return false;
+			}
+			i += 5;
+		}
+		if (i >= body.size() || body[i] != DCOLON) {
+			ParseError(i < body.size() ? body[i].GetLinenum() : line, "Missing Double Colon");
 			return false;
 		}
-	} else {
-		if (!VarList(in, line, type, stoi(len))) {
-			ParseError(line, "Missing Variable List");
+		do {
+			i++;
+			if (i >= body.size() || body[i] != IDENT) {
+				ParseError(i < body.size() ? body[i].GetLinenum() : line, "Missing Variable Name");
+				return false;
+			}
+			string var = body[i].GetLexeme();
+			bool dummy = find(params.begin(), params.end(), var) != params.end();
+			if (!index.emplace(var, def.slots.size()).second) {
+				ParseError(body[i].GetLinenum(), "Variable Redefinition");
+				return false;
+			}
+			if (intent != INTENT_NONE && !dummy) {
+				ParseError(body[i].GetLinenum(), "INTENT Attribute on a Variable That Is Not a Dummy Argument");
+				return false;
+			}
+			def.slots.push_back({var, type, dummy && !hasLen ? 0 : strlen, intent, dummy});
+			i++;
+			if (i < body.size() && body[i] == LPAREN) {
+				ParseError(body[i].GetLinenum(), "Array Declaration in a Subprogram");
+				return false;
+			}
+			if (i < body.size() && body[i] == ASSOP) {
+				if (dummy) {
+					ParseError(body[i].GetLinenum(), "Initialization of a Dummy Argument");
+					return false;
+				}
+				i = SkipExpr(body, i + 1);
+				if (i == string::npos) {
+					ParseError(line, "Incorrect initialization for a variable.");
+					return false;
+				}
+			}
+		} while (i < body.size() && body[i] == COMMA);
+	}
+
+	for (const string & param : params) {
+		auto slot = index.find(param);
+		if (slot == index.end()) {
+			ParseError(line, "Undeclared Dummy Argument " + param);
+			return false;
+		}
+		def.params.push_back(slot->second);
+	}
+	if (def.function) {
+		auto slot = index.find(name);
+		if (slot == index.end() || def.slots[slot->second].dummy) {
+			ParseError(line, "Undeclared Function Result " + name);
+			return false;
+		}
+		def.result = slot->second;
+	}
+	for (LexItem & tok : body) {
+		if (tok == DO) {
+			ParseError(tok.GetLinenum(), "DO CONCURRENT in a Subprogram");
 			return false;
 		}
+		if (tok == IDENT) {
+			auto slot = index.find(tok.GetLexeme());
+			tok.SetSlot(slot == index.end() ? -1 : slot->second);
+		}
 	}
 	return true;
 }
 
-//VarList ::= Var [= Expr] {, Var [= Expr]}
-bool VarList(istream& in, int& line, LexItem & idtok, int strlen) {
-	bool exprStatus = false;
-	string identName;
-	Value exprVal;
-
-	if (idtok.GetToken() == CHARACTER) {
-		exprVal.SetType(VSTRING);
-		exprVal.SetstrLen(strlen);
-		string initialStr(strlen, ' ');
-		exprVal.SetString(initialStr);
-	} else if (idtok.GetToken() == REAL) {
-		exprVal.SetType(VREAL);
-	} else if (idtok.GetToken() == INTEGER) {
-		exprVal.SetType(VINT);
+//Subprogram ::= SUBROUTINE IDENT [( [IDENT {, IDENT}] )] {Decl} {Stmt} END SUBROUTINE IDENT
+//             | FUNCTION IDENT ( [IDENT {, IDENT}] ) {Decl} {Stmt} END FUNCTION IDENT
+bool SubprogramDef(istream& in, int& line) {
+	LexItem kind = Parser::GetNextToken(in, line);
+	if (kind != SUBROUTINE && kind != FUNCTION) {
+		ParseError(line, "Missing SUBROUTINE or FUNCTION");
+		return false;
 	}
-
 	LexItem token = Parser::GetNextToken(in, line);
-	if (token == IDENT) {
-		identName = token.GetLexeme();
-		if (!(defVar.find(identName)->second)) {
-			defVar[identName] = true;
-			SymTable[identName] = idtok.GetToken();
-			if (idtok.GetToken() != CHARACTER) { //Initialize if it's a character variable
-				initVar[identName] = false;
-			} else {
-				initVar[identName] = true;
+	if (token != IDENT) {
+		ParseError(line, "Missing Subprogram Name");
+		return false;
+	}
+	string name = token.GetLexeme();
+	int headLine = line;
+	if (program->Subprograms.count(name)) {
+		ParseError(line, "Subprogram Redefinition");
+		return false;
+	}
+
+	vector<string> params;
+	token = Parser::GetNextToken(in, line);
+	if (token == LPAREN) {
+		token = Parser::GetNextToken(in, line);
+		while (token == IDENT) {
+			if (find(params.begin(), params.end(), token.GetLexeme()) != params.end()) {
+				ParseError(line, "Duplicate Dummy Argument");
+				return false;
 			}
-		} else {
-			ParseError(line, "Variable Redefinition");
+			params.push_back(token.GetLexeme());
+			token = Parser::GetNextToken(in, line);
+			if (token != COMMA) {
+				break;
+			}
+			token = Parser::GetNextToken(in, line);
+			if (token != IDENT) {
+				ParseError(line, "Missing Dummy Argument");
+				return false;
+			}
+		}
+		if (token != RPAREN) {
+			ParseError(line, "Missing Right Parenthesis");
 			return false;
 		}
-	} else {
-		ParseError(line, "Missing Variable Name");
+	} else if (kind == FUNCTION) {
+		ParseError(line, "Missing Left Parenthesis");
 		return false;
+	} else {
+		Parser::PushBackToken(token);
 	}
-	TempsResults[identName] = exprVal;
 
+	Subprogram def;
+	def.function = kind == FUNCTION;
 	token = Parser::GetNextToken(in, line);
-	if (token == ASSOP) {
-		if (!Expr(in, line, exprVal)) {
-			ParseError(line, "Incorrect initialization for a variable.");
+	while (true) {
+		if (token == DONE || token == ERR || token == PROGRAM || token == SUBROUTINE || token == FUNCTION) {
+			ParseError(line, kind == FUNCTION ? "Missing END FUNCTION" : "Missing END SUBROUTINE");
 			return false;
 		}
-		if (exprVal.GetType() == VSTRING) {
-			string initStr = exprVal.GetString();
-			if (initStr.length() > strlen) { //Adjusting string to declared length
-				initStr = initStr.substr(0, strlen);
-			} else if (initStr.length() < strlen) {
-				initStr.append(strlen - initStr.length(), ' ');
+		if (token == END) {
+			LexItem next = Parser::GetNextToken(in, line);
+			if (next == kind.GetToken()) {
+				break;
 			}
-			exprVal.SetString(initStr);
+			def.body.push_back(token);
+			token = next;
+			continue;
 		}
-		TempsResults[identName] = exprVal;
-		initVar[identName] = true;
-
+		def.body.push_back(token);
 		token = Parser::GetNextToken(in, line);
-		if (token == COMMA) {
-			return VarList(in, line, idtok, strlen);
-		} else {
-			Parser::PushBackToken(token);
-			return true;
-		}
-	} else if (token == COMMA) {
-		return VarList(in, line, idtok, strlen);
-	} else {
-		Parser::PushBackToken(token);
-		return true;
 	}
+	token = Parser::GetNextToken(in, line);
+	if (token != IDENT) {
+		ParseError(line, "Missing Subprogram Name");
+		return false;
+	}
+	if (!ResolveSlots(def, name, params, headLine)) {
+		return false;
+	}
+	program->Subprograms[name] = move(def);
 	return true;
 }
 
-//Stmt ::= AssignStmt | BlockIfStmt | PrintStmt | SimpleIfStmt
-bool Stmt(istream& in, int& line) {
-	LexItem token = Parser::GetNextToken(in, line);
-	switch(token.GetToken()) {
-		case IDENT: {
-			Parser::PushBackToken(token);
-			return SimpleStmt(in, line);
-			break;
+static bool OfType(const Value & val, Token type) {
+	return (type == INTEGER && val.IsInt()) || (type == REAL && val.IsReal()) || (type == CHARACTER && val.IsString())
+		|| (type == LOGICAL && val.IsBool());
+}
+
+//Arg ::= Var | Expr
+//A variable is passed by reference; any other expression is evaluated into the dummy argument's own slot
+static bool BindArgument(istream& in, int& line, const SlotInfo & dummy, Slot & slot) {
+	bool variable = Parser::PeekToken(in, line) == IDENT
+		&& (Parser::PeekToken(in, line, 1) == COMMA || Parser::PeekToken(in, line, 1) == RPAREN);
+	if (variable) {
+		LexItem token = Parser::GetNextToken(in, line);
+		VarRef ref;
+		if (!Lookup(token, ref)) {
+			ParseError(line, "Undeclared Variable");
+			return false;
 		}
-		case PRINT: {
-			Parser::PushBackToken(token);
-			return PrintStmt(in, line);
-			break;
+		if (ref.array != nullptr) {
+			ParseError(line, "Illegal Use of Array");
+			return false;
 		}
-		case IF: {
-			Parser::PushBackToken(token);
-			return BlockIfStmt(in, line);
-			break;
+		if (ref.type != dummy.type) {
+			ParseError(line, "Argument Type Mismatch for " + dummy.name);
+			return false;
 		}
-		default:
-			ParseError(line, "Missing Statement");
+		if (dummy.intent != INTENT_IN && ref.shared) {
+			ParseError(line, "Illegal Assignment to Shared Variable in DO CONCURRENT");
 			return false;
+		}
+		if (dummy.intent != INTENT_IN && ref.intent == INTENT_IN) {
+			ParseError(line, "INTENT(IN) Argument Passed to Modifiable Dummy Argument " + dummy.name);
+			return false;
+		}
+		slot.val = ref.val;
+		slot.init = ref.init;
+		if (dummy.intent == INTENT_OUT && !checking) {
+			*slot.init = false;
+		}
+		return true;
 	}
-	return true;
-}
-
-//PrintStmt ::= PRINT *, ExprList
-bool PrintStmt(istream& in, int& line) {
-	LexItem token;
-	ValQueue = new queue<Value>;
-
-	token = Parser::GetNextToken(in, line);
-	if (token != PRINT) {
-		ParseError(line, "Print statement syntax error.");
-		return false;
-	}
-	token = Parser::GetNextToken(in, line);
-	if (token != DEF) {
-		ParseError(line, "Print statement syntax error.");
+	if (dummy.intent == INTENT_OUT || dummy.intent == INTENT_INOUT) {
+		ParseError(line, "Actual Argument for " + dummy.name + " Must Be a Variable");
 		return false;
 	}
-	token = Parser::GetNextToken(in, line);
-	if (token != COMMA) {
-		ParseError(line, "Print statement syntax error.");
+	Value val;
+	if (!Expr(in, line, val)) {
+		ParseError(line, "Missing Argument");
 		return false;
 	}
-	if (!ExprList(in, line)) {
-		ParseError(line, "Missing expression after Print Statement");
+	if (!OfType(val, dummy.type)) {
+		ParseError(line, "Argument Type Mismatch for " + dummy.name);
 		return false;
 	}
-	while (!(*ValQueue).empty()) {
-		Value nextVal = (*ValQueue).front();
-		cout << nextVal;
-		ValQueue->pop();
+	if (val.IsString()) {
+		val.FitString(dummy.strlen > 0 ? dummy.strlen : val.GetString().length());
 	}
-	cout << endl;
+	slot.own = move(val);
+	slot.ownInit = true;
 	return true;
 }
 
-//SimpleIfStatement ::= IF (RelExpr) Stmt
-//BlockIfStmt ::= IF (RelExpr) THEN {Stmt} [ELSE {Stmt}] END IF
-bool BlockIfStmt(istream& in, int& line) {
-	bool flag;
+static bool BindArguments(istream& in, int& line, const Subprogram & def, Slot * slots) {
+	size_t count = 0;
 	LexItem token = Parser::GetNextToken(in, line);
-	Value retVal;
-
-	if (token != IF) {
-		ParseError(line, "Missing IF");
-		return false;
-	}
-	token = Parser::GetNextToken(in, line);
 	if (token != LPAREN) {
-		ParseError(line, "Missing Left Parenthesis");
-		return false;
+		Parser::PushBackToken(token);
+		if (def.function) {
+			ParseError(line, "Missing Left Parenthesis");
+			return false;
+		}
+	} else {
+		token = Parser::GetNextToken(in, line);
+		if (token != RPAREN) {
+			Parser::PushBackToken(token);
+			do {
+				if (count == def.params.size()) {
+					ParseError(line, "Incorrect Number of Arguments");
+					return false;
+				}
+				int param = def.params[count++];
+				if (!BindArgument(in, line, def.slots[param], slots[param])) {
+					return false;
+				}
+				token = Parser::GetNextToken(in, line);
+			} while (token == COMMA);
+			if (token != RPAREN) {
+				ParseError(line, "Missing Right Parenthesis");
+				return false;
+			}
+		}
 	}
-	if (!RelExpr(in, line, retVal)) {
-		ParseError(line, "Missing If-Statement Condition");
+	if (count != def.params.size()) {
+		ParseError(line, "Incorrect Number of Arguments");
 		return false;
 	}
-	token = Parser::GetNextToken(in, line);
-	if (retVal.GetType() != VBOOL) {
-		ParseError(line, "Runtime Error - Illegal Type for If-Statement Condition");
+	return true;
+}
+
+//Pushes a frame for def, binds the arguments that follow in the input, and runs the body.
+//The frame's slots are taken from the thread's call stack before the arguments are evaluated,
+//so calls made by the argument expressions are stacked above it.
+static bool Invoke(istream& in, int& line, const Subprogram & def, Value * result) {
+	if (call_depth >= max_call_depth) {
+		ParseError(line, "Call Depth Exceeds Maximum");
 		return false;
 	}
-	if (token != RPAREN) {
-		ParseError(line, "Missing Right Parenthesis");
+	if (CallStack.empty()) {
+		AllocateCallStack();
+	}
+	size_t base = stack_top;
+	if (base + def.slots.size() > CallStack.size()) {
+		ParseError(line, "Call Stack Overflow");
 		return false;
 	}
-	bool relExpr = retVal.GetBool();
-	token = Parser::GetNextToken(in, line);
-	
-	//SimpleIfStmt
-	if (token != THEN) { 
-		if (relExpr) {
-			Parser::PushBackToken(token);
-			if (SimpleStmt(in, line)) {
-				return true;
-			} else {
-				ParseError(line, "Missing Simple Statement");
-				return false;
-			}
-		} else {
-			return true;
-		}
+	Slot * slots = CallStack.data() + base;
+	for (size_t i = 0; i < def.slots.size(); i++) {
+		slots[i].ownInit = false;
+		slots[i].val = &slots[i].own;
+		slots[i].init = &slots[i].ownInit;
 	}
+	stack_top += def.slots.size();
 
-	//BlockIfStmt
-	if (relExpr) {
-		while (true) {
-			token = Parser::GetNextToken(in, line);
-			if (token == ELSE || token == END) {
-				break;
+	bool status = BindArguments(in, line, def, slots);
+	if (status && checking) {
+		//The body was checked on its own, before the program
+		if (result != nullptr) {
+			*result = Placeholder(def.slots[def.result].type, def.slots[def.result].strlen);
+		}
+	} else if (status) {
+		int callLine = line;
+		Frame callee = {&def, slots};
+		Frame * caller = frame;
+		frame = &callee;
+		++call_depth;
+		RaiseTo(deepest_call, call_depth);
+		RaiseTo(largest_frame, def.slots.size());
+		RaiseTo(stack_high_water, stack_top);
+		status = ExecBody(in, line, def.body, true);
+		--call_depth;
+		frame = caller;
+		line = callLine;
+		if (status && result != nullptr) {
+			if (!*slots[def.result].init) {
+				ParseError(line, "Function Result Not Assigned");
+				status = false;
 			} else {
-				Parser::PushBackToken(token);
-			}
-			if (!Stmt(in, line)) {
-				ParseError(line, "Missing Statement");
-				return false;
+				*result = *slots[def.result].val;
 			}
 		}
-	} else {
-		while (token != ELSE && token != END) {
-			token = Parser::GetNextToken(in, line);
-		}
 	}
+	stack_top = base;
+	if (frame == nullptr) {
+		call_failed = false;
+	} else if (!status) {
+		call_failed = true;
+	}
+	return status;
+}
 
-	if (token == ELSE) {
-		if (!relExpr) {
-			while (true) {
-				token = Parser::GetNextToken(in, line);
-				if (token == END) {
-					break;
-				} else {
-					Parser::PushBackToken(token);
-				}
-				if (!Stmt(in, line)) {
-					ParseError(line, "Missing Statement");
-					return false;
-				}
-			}
-		} else {
-			while (token != END) {
-				token = Parser::GetNextToken(in, line);
-			}
+//Checks the body of every subprogram once, in the order they were defined, with placeholder
+//values for the dummy arguments. Bodies are checked once all are defined, as they run.
+static bool CheckSubprograms(istream& in, int& line) {
+	vector<const Subprogram *> defs;
+	for (const auto & sub : program->Subprograms) {
+		if (!sub.second.body.empty()) {
+			defs.push_back(&sub.second);
 		}
-	} 
-
-	if (token == END) {
-		token = Parser::GetNextToken(in, line);
-		if (token != IF) {
-			ParseError(line, "Missing IF at end of IF statement");
+	}
+	sort(defs.begin(), defs.end(), [](const Subprogram * a, const Subprogram * b) {
+		return a->body.front().GetLinenum() < b->body.front().GetLinenum();
+	});
+	if (CallStack.empty()) {
+		AllocateCallStack();
+	}
+	for (const Subprogram * def : defs) {
+		if (def->slots.size() > CallStack.size()) {
+			ParseError(def->body.front().GetLinenum(), "Call Stack Overflow");
 			return false;
 		}
-		return true;
-	} else {
-		ParseError(line, "Missing END");
+		Slot * slots = CallStack.data();
+		for (size_t i = 0; i < def->slots.size(); i++) {
+			const SlotInfo & info = def->slots[i];
+			slots[i].own = info.dummy ? Placeholder(info.type, info.strlen) : Value();
+			slots[i].ownInit = info.dummy;
+			slots[i].val = &slots[i].own;
+			slots[i].init = &slots[i].ownInit;
+		}
+		stack_top = def->slots.size();
+		Frame callee = {def, slots};
+		frame = &callee;
+		int bodyLine = line;
+		bool status = ExecBody(in, bodyLine, def->body, true);
+		frame = nullptr;
+		call_failed = false;
+		stack_top = 0;
+		if (!status) {
+			ParseError(bodyLine, "Incorrect Subprogram Definition");
+			return false;
+		}
+	}
+	return true;
+}
+
+//CallStmt ::= CALL IDENT [( [Arg {, Arg}] )]
+bool CallStmt(istream& in, int& line) {
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != CALL) {
+		ParseError(line, "Missing CALL");
 		return false;
 	}
-	return flag;
+	token = Parser::GetNextToken(in, line);
+	if (token != IDENT) {
+		ParseError(line, "Missing Subroutine Name");
+		return false;
+	}
+	auto sub = program->Subprograms.find(token.GetLexeme());
+	if (sub == program->Subprograms.end() || sub->second.function) {
+		ParseError(line, "Undefined Subroutine");
+		return false;
+	}
+	return Invoke(in, line, sub->second, nullptr);
 }
 
-//SimpleStmt ::= AssignStmt | PrintStmt
+//SimpleStmt ::= AssignStmt | PrintStmt | ReadStmt | CallStmt | OpenStmt | WriteStmt | CloseStmt
 bool SimpleStmt(istream& in, int& line) {
 	LexItem token = Parser::GetNextToken(in, line);
 	switch(token.GetToken()) {
@@ -393,6 +3488,31 @@ bool SimpleStmt(istream& in, int& line) {
 			return PrintStmt(in, line);
 			break;
 		}
+		case CALL: {
+			Parser::PushBackToken(token);
+			return CallStmt(in, line);
+			break;
+		}
+		case READ: {
+			Parser::PushBackToken(token);
+			return ReadStmt(in, line);
+			break;
+		}
+		case OPEN: {
+			Parser::PushBackToken(token);
+			return OpenStmt(in, line);
+			break;
+		}
+		case WRITE: {
+			Parser::PushBackToken(token);
+			return WriteStmt(in, line);
+			break;
+		}
+		case CLOSE: {
+			Parser::PushBackToken(token);
+			return CloseStmt(in, line);
+			break;
+		}
 		default: {
 			ParseError(line, "Missing Simple Statement");
 			return false;
@@ -401,7 +3521,80 @@ bool SimpleStmt(istream& in, int& line) {
 	return true;
 }
 
-//AssignStmt ::= Var = Expr
+//( Expr ), the subscript of an element of array, numbered from 1. When checking, the
+//subscript is a placeholder, so only its type is checked and it stands for the first element.
+static bool Subscript(istream& in, int& line, const BitArray & array, size_t & index) {
+	Parser::GetNextToken(in, line);
+	Value val;
+	if (!EnterNesting(line)) {
+		return false;
+	}
+	bool status = Expr(in, line, val);
+	--expr_depth;
+	if (!status) {
+		if (!depth_exceeded) {
+			ParseError(line, "Missing Expression");
+		}
+		return false;
+	}
+	if (Parser::GetNextToken(in, line) != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	if (!val.IsInt()) {
+		ParseError(line, "Runtime Error - Illegal Type for Array Subscript");
+		return false;
+	}
+	if (checking) {
+		index = 0;
+		return true;
+	}
+	if (val.GetInt() < 1 || (size_t) val.GetInt() > array.Size()) {
+		ParseError(line, "Runtime Error - Array Subscript Out of Bounds");
+		return false;
+	}
+	index = val.GetInt() - 1;
+	return true;
+}
+
+//AssignStmt to a LOGICAL array: Var (Expr) = Expr stores one element, Var = Expr every
+//element, from an expression over arrays
+static bool ArrayAssignStmt(istream& in, int& line, const string & varName, BitArray & array) {
+	size_t index = 0;
+	bool element = Parser::PeekToken(in, line) == LPAREN;
+	if (element && !Subscript(in, line, array, index)) {
+		return false;
+	}
+	LexItem token = Parser::GetNextToken(in, line);
+	if (token != ASSOP) {
+		ParseError(line, "Missing Assignment Operator");
+		return false;
+	}
+	if (!element) {
+		Mask mask;
+		if (!MaskExpr(in, line, mask)) {
+			ParseError(token.GetLinenum(), "Missing Expression in Assignment Statement");
+			return false;
+		}
+		return AssignMask(token.GetLinenum(), array, mask);
+	}
+	Value retVal;
+	if (!Expr(in, line, retVal)) {
+		ParseError(token.GetLinenum(), "Missing Expression in Assignment Statement");
+		return false;
+	}
+	if (retVal.GetType() != VBOOL) {
+		ParseError(token.GetLinenum(), "Illegal mixed-mode assignment operation");
+		return false;
+	}
+	array.Set(index, retVal.GetBool());
+	if (tracer != nullptr) {
+		tracer->Assign(token.GetLinenum(), varName + "(" + to_string(index + 1) + ")", retVal);
+	}
+	return true;
+}
+
+//AssignStmt ::= Var [(Expr)] = Expr
 bool AssignStmt(istream& in, int& line) {
 	Value retVal;
 	LexItem token;
@@ -410,91 +3603,176 @@ bool AssignStmt(istream& in, int& line) {
 		return false;
 	}
 	string varName = token.GetLexeme();
+	VarRef ref;
+	Lookup(token, ref);
+	if (ref.array != nullptr) {
+		return ArrayAssignStmt(in, line, varName, *ref.array);
+	}
 	token = Parser::GetNextToken(in, line);
 	if (token != ASSOP) {
 		ParseError(line, "Missing Assignment Operator");
 		return false;
 	}
-	int originalStrlen;
-	retVal = TempsResults[varName];
+	if (frame == nullptr && iterCtx != nullptr && iterCtx->reductions->count(varName)) {
+		return ReductionStmt(in, line, varName);
+	}
+	if (ref.intent == INTENT_IN) {
+		ParseError(line, "Assignment to INTENT(IN) Argument");
+		return false;
+	}
+	int originalStrlen = 0;
+	retVal = *ref.val;
 	if (retVal.GetType() == VSTRING) {
 		originalStrlen = retVal.GetstrLen();
 	}
-	initVar[varName] = true;
-	if (!Expr(in, line, retVal)) {
+	*ref.init = true;
+	if (!StoredExpr(in, line, retVal, retVal.GetType() == VSTRING ? originalStrlen : string::npos)) {
 		ParseError(token.GetLinenum(), "Missing Expression in Assignment Statement");
 		return false;
 	}
 	if (retVal.GetType() == VSTRING) {
-		string resultStr = retVal.GetString();
-		if (resultStr.length() < originalStrlen) {
-			resultStr.append(originalStrlen - resultStr.length(), ' ');
-		} else if (resultStr.length() > originalStrlen) {
-			resultStr = resultStr.substr(0, originalStrlen);
-		}
-		retVal.SetString(resultStr);
-		retVal.SetstrLen(originalStrlen);
+		retVal.FitString(originalStrlen);
+		ChargeCharacter(originalStrlen);
 	}
-	if (SymTable[varName] == CHARACTER && retVal.GetType() != VSTRING) {
+	if (ref.type == CHARACTER && retVal.GetType() != VSTRING) {
+		ParseError(token.GetLinenum(), "Illegal mixed-mode assignment operation");
+		return false;
+	} else if (ref.type == INTEGER && retVal.GetType() == VSTRING) {
 		ParseError(token.GetLinenum(), "Illegal mixed-mode assignment operation");
 		return false;
-	} else if (SymTable[varName] == INTEGER && retVal.GetType() == VSTRING) {
+	} else if (ref.type == REAL && retVal.GetType() == VSTRING) {
 		ParseError(token.GetLinenum(), "Illegal mixed-mode assignment operation");
 		return false;
-	} else if (SymTable[varName] == REAL && retVal.GetType() == VSTRING) {
+	} else if ((ref.type == LOGICAL) != (retVal.GetType() == VBOOL)) {
 		ParseError(token.GetLinenum(), "Illegal mixed-mode assignment operation");
 		return false;
 	}
-	TempsResults[varName] = retVal;
+	*ref.val = move(retVal);
+	if (tracer != nullptr) {
+		tracer->Assign(token.GetLinenum(), varName, *ref.val);
+	}
+	return true;
+}
+
+//Var = Var (+ | - | *) Operand inside a DO CONCURRENT body. The operand is recorded
+//and folded into the variable in iteration order once the loop has finished.
+static bool ReductionStmt(istream& in, int& line, const string & varName) {
+	Parser::GetNextToken(in, line); //The variable itself, matched by CheckConcurrentBody
+	LexItem op = Parser::GetNextToken(in, line);
+	Value operand;
+	bool status = (op == MULT) ? TermExpr(in, line, operand) : MultExpr(in, line, operand);
+	if (!status) {
+		ParseError(line, "Missing Operand After Operator");
+		ParseError(op.GetLinenum(), "Missing Expression in Assignment Statement");
+		return false;
+	}
+	if (!operand.IsInt() && !operand.IsReal()) {
+		if (op == MULT) {
+			ParseError(line, "Illegal operand types for the operation.");
+		} else {
+			ParseError(op.GetLinenum(), "Illegal Operand Type for the Operation.");
+		}
+		ParseError(op.GetLinenum(), "Missing Expression in Assignment Statement");
+		return false;
+	}
+	iterCtx->contributions.push_back({varName, op.GetToken(), operand});
 	return true;
 }
 
 //ExprList ::= Expr {,Expr}
 bool ExprList(istream& in, int& line) {
-	Value retVal;
+	LexItem token;
+	do {
+		Value retVal;
+		if (!Expr(in, line, retVal)) {
+			ParseError(line, "Missing Expression");
+			return false;
+		}
+		ValStack.push_back(retVal);
+		token = Parser::GetNextToken(in, line);
+	} while (token == COMMA);
+
+	if (token.GetToken() == ERR) {
+		return false;
+	}
+	Parser::PushBackToken(token);
+	return true;
+}
 
+//RelExpr ::= Expr, a condition; the relational and logical operators are those of Expr
+bool RelExpr(istream& in, int& line, Value & retVal) {
 	if (!Expr(in, line, retVal)) {
-		ParseError(line, "Missing Expression");
 		return false;
 	}
-	ValQueue->push(retVal);
-	LexItem token = Parser::GetNextToken(in, line);
-	if (token == COMMA) {
-		if (!ExprList(in, line)) {
-			return false;
-		}
-	} else if (token.GetToken() == ERR) {
+	if (retVal.GetType() == VERR) {
+		ParseError(line, "Illegal Operand Types for a Relational Operation");
 		return false;
-	} else {
-		Parser::PushBackToken(token);
-		return true;
 	}
 	return true;
 }
 
-//RelExpr ::= Expr [( == | < | > ) Expr ]
-bool RelExpr(istream& in, int& line, Value & retVal) {
-	Value comp1, comp2;
-	if (!Expr(in, line, comp1)) {
+//Bounds the recursion of parenthesized expressions and ** chains so that deeply
+//nested input ends with a diagnostic instead of exhausting the stack
+static bool EnterNesting(int line) {
+	if (expr_depth == 0) {
+		depth_exceeded = false;
+	}
+	if (expr_depth >= max_depth) {
+		ParseError(line, "Expression Nesting Exceeds Maximum Depth");
+		depth_exceeded = true;
 		return false;
 	}
-	LexItem token = Parser::GetNextToken(in, line);
-	if (token == EQ || token == LTHAN || token == GTHAN) {
-		string op = token.GetLexeme();
-		if (!Expr(in, line, comp2)) {
-			return false;
-		}
-		if (op == "==") {
-			retVal = comp1 == comp2;
-		} else if (op == "<") {
-			retVal = comp1 < comp2;
-		} else if (op == ">") {
-			retVal = comp1 > comp2;
-		}
+	++expr_depth;
+	return true;
+}
+
+//The binary operators of expressions. An operator applies its operands, or reports
+//why it cannot, and the parser only knows its precedence and associativity. A // keeps
+//at most limit characters of what it appends to.
+typedef bool (*BinaryAction)(const LexItem & op, int line, Value & retVal, const Value & opVal, size_t limit);
+
+static bool AddAction(const LexItem & op, int, Value & retVal, const Value & opVal, size_t) {
+	retVal = op == PLUS ? retVal + opVal : retVal - opVal;
+	if (retVal.GetType() == VERR) {
+		ParseError(op.GetLinenum(), "Illegal Operand Type for the Operation.");
+		return false;
+	}
+	return true;
+}
+
+static bool CatAction(const LexItem & op, int, Value & retVal, const Value & opVal, size_t limit) {
+	retVal.Append(opVal, limit);
+	ChargeCharacter(opVal.GetStringSize());
+	if (retVal.GetType() == VERR) {
+		ParseError(op.GetLinenum(), "Illegal Operand Type for the Operation.");
+		return false;
+	}
+	return true;
+}
+
+static bool MultAction(const LexItem & op, int line, Value & retVal, const Value & opVal, size_t) {
+	if (op == MULT || checking) {
+		retVal = retVal * opVal; //When checking, a placeholder divisor may be zero; * has the same operand and result types
+	} else if ((opVal.GetType() == VINT && opVal.GetInt() == 0) || (opVal.GetType() == VREAL && opVal.GetReal() == 0.0)) {
+		ParseError(op.GetLinenum(), "Run-Time Error-Illegal division by Zero");
+		return false;
 	} else {
-		retVal = comp1;
-		Parser::PushBackToken(token);
+		retVal = retVal / opVal;
+	}
+	if (retVal.GetType() == VERR) {
+		ParseError(line, "Illegal operand types for the operation.");
+		return false;
 	}
+	return true;
+}
+
+static bool PowAction(const LexItem &, int, Value & retVal, const Value & opVal, size_t) {
+	retVal = retVal.Power(opVal);
+	return true;
+}
+
+static bool RelAction(const LexItem & op, int line, Value & retVal, const Value & opVal, size_t) {
+	retVal = op == EQ ? retVal == opVal : op == LTHAN ? retVal < opVal : retVal > opVal;
 	if (retVal.GetType() == VERR) {
 		ParseError(line, "Illegal Operand Types for a Relational Operation");
 		return false;
@@ -502,116 +3780,172 @@ bool RelExpr(istream& in, int& line, Value & retVal) {
 	return true;
 }
 
-//Expr ::= MultExpr {(+ | - | //) MultExpr}
-bool Expr(istream& in, int& line, Value & retVal) {
-	if (!MultExpr(in, line, retVal)) {
+static bool LogicalAction(const LexItem & op, int, Value & retVal, const Value & opVal, size_t) {
+	if (!retVal.IsBool() || !opVal.IsBool()) {
+		ParseError(op.GetLinenum(), "Illegal Operand Type for the Operation.");
 		return false;
 	}
-	LexItem token = Parser::GetNextToken(in, line);
+	retVal = Value(op == AND ? retVal.GetBool() && opVal.GetBool() : retVal.GetBool() || opVal.GetBool());
+	return true;
+}
 
-	while (token == PLUS || token == MINUS || token == CAT) {
-		string op = token.GetLexeme();
-		Value opVal;
-		if (!MultExpr(in, line, opVal)) {
+static bool IsFalse(const Value & val) {
+	return val.IsBool() && !val.GetBool();
+}
+
+static bool IsTrue(const Value & val) {
+	return val.IsBool() && val.GetBool();
+}
+
+//PREC_NOT is the precedence of the unary .NOT., which binds below the relational operators
+enum Precedence { PREC_NONE, PREC_OR, PREC_AND, PREC_NOT, PREC_REL, PREC_ADD, PREC_MULT, PREC_POW };
+
+struct BinaryOperator {
+	Precedence prec = PREC_NONE; //PREC_NONE for a token that is not a binary operator
+	bool right = false; //Right-associative
+	bool nests = false; //Counts towards the expression nesting depth, like a parenthesis
+	const char * missing = nullptr; //Reported when the right operand is missing, if anything is
+	BinaryAction apply = nullptr;
+	bool (*decides)(const Value & left) = nullptr; //Whether the left operand alone gives the result
+};
+
+static const array<BinaryOperator, DONE + 1> binary_operators = [] {
+	array<BinaryOperator, DONE + 1> table;
+	table[OR] = {PREC_OR, false, false, "Missing Operand After Operator", LogicalAction, IsTrue};
+	table[AND] = {PREC_AND, false, false, "Missing Operand After Operator", LogicalAction, IsFalse};
+	table[EQ] = {PREC_REL, false, false, nullptr, RelAction}; //a < b < c compares a LOGICAL, which is an error
+	table[LTHAN] = {PREC_REL, false, false, nullptr, RelAction};
+	table[GTHAN] = {PREC_REL, false, false, nullptr, RelAction};
+	table[PLUS] = {PREC_ADD, false, false, "Missing Operand After Operator", AddAction};
+	table[MINUS] = {PREC_ADD, false, false, "Missing Operand After Operator", AddAction};
+	table[CAT] = {PREC_ADD, false, false, "Missing Operand After Operator", CatAction};
+	table[MULT] = {PREC_MULT, false, false, "Missing Operand After Operator", MultAction};
+	table[DIV] = {PREC_MULT, false, false, "Missing Operand After Operator", MultAction};
+	table[POW] = {PREC_POW, true, true, "Missing exponent operand", PowAction};
+	return table;
+}();
+
+static bool Climb(istream& in, int& line, int minPrec, Value & retVal, size_t limit = string::npos);
+
+//Whether the token after an operand goes on with the expression
+static bool ContinuesOperand(Token token) {
+	return token == LPAREN || binary_operators[token].prec != PREC_NONE;
+}
+
+//NotExpr ::= .NOT. NotExpr | RelOperand
+static bool NotExpr(istream& in, int& line, Value & retVal) {
+	LexItem op = Parser::GetNextToken(in, line);
+	if (!EnterNesting(line)) {
+		return false;
+	}
+	bool status = Climb(in, line, PREC_NOT, retVal);
+	--expr_depth;
+	if (!status) {
+		if (!depth_exceeded) {
 			ParseError(line, "Missing Operand After Operator");
-			return false;
-		}
-		if (op == "+") {
-			retVal = retVal + opVal;
-		} else if (op == "-") {
-			retVal = retVal - opVal;
-		} else if (op == "//") {
-			retVal = retVal.Catenate(opVal);
-		}
-		if (retVal.GetType() == VERR) {
-			ParseError(token.GetLinenum(), "Illegal Operand Type for the Operation.");
-			return false;
 		}
-		token = Parser::GetNextToken(in, line);
+		return false;
 	}
-	Parser::PushBackToken(token);
+	if (!retVal.IsBool()) {
+		ParseError(op.GetLinenum(), "Illegal Operand Type for the Operation.");
+		return false;
+	}
+	retVal = Value(!retVal.GetBool());
 	return true;
 }
 
-//MultExpr ::= TermExpr {(* | / ) TermExpr}
-bool MultExpr(istream& in, int& line, Value & retVal) {
-	if (!TermExpr(in, line, retVal)) {
+//Precedence climbing: an operand, then every operator binding at least as tightly as
+//minPrec, each applied to what has been parsed so far and its right operand. The right
+//operand takes the operators that bind more tightly, or as tightly for a right-
+//associative one, so a - b - c is (a - b) - c and a ** b ** c is a ** (b ** c).
+//The token after the expression is only peeked at, so it is left where it was read.
+//When the left operand of .AND. or .OR. decides the result, the right one is parsed
+//and typed as --check does: nothing it calls runs and no error depending on the
+//values it computes is raised, so that i > 0 .AND. flags(i) is safe for any i.
+//Only a // chain at this level is limited; operands are parsed without a limit.
+static bool Climb(istream& in, int& line, int minPrec, Value & retVal, size_t limit) {
+	if (minPrec <= PREC_NOT && Parser::PeekToken(in, line) == NOT) {
+		if (!NotExpr(in, line, retVal)) {
+			return false;
+		}
+	} else if (!SFactor(in, line, retVal)) {
 		return false;
 	}
-
-	LexItem token = Parser::GetNextToken(in, line);
-	while (token == MULT || token == DIV) {
-		string op = token.GetLexeme();
+	while (true) {
+		const BinaryOperator & op = binary_operators[Parser::PeekToken(in, line).GetToken()];
+		if (op.prec == PREC_NONE || op.prec < minPrec) {
+			return true;
+		}
+		LexItem token = Parser::GetNextToken(in, line);
 		Value opVal;
-		if (!TermExpr(in, line, opVal)) {
-			ParseError(line, "Missing Operand After Operator");
+		if (op.nests && !EnterNesting(line)) {
 			return false;
 		}
-		if (op == "*") {
-			retVal = retVal * opVal;
-		} else if (op == "/") {
-			if (opVal.GetType() == VREAL && opVal.GetInt() == 0) {
-				ParseError(line, "Runtime Error - Division by Zero");
-				return false;
-			} else if (opVal.GetType() == VREAL && opVal.GetReal() == 0.0) {
-				ParseError(line, "Runtime Error - Division by Zero");
-				return false;
+		bool status;
+		if (op.decides != nullptr && !checking && op.decides(retVal)) {
+			checking = true;
+			status = Climb(in, line, op.prec + 1, opVal);
+			checking = false;
+		} else {
+			status = Climb(in, line, op.right ? op.prec : op.prec + 1, opVal);
+		}
+		if (op.nests) {
+			--expr_depth;
+		}
+		if (!status) {
+			if (op.missing != nullptr && (!op.nests || !depth_exceeded)) {
+				ParseError(line, op.missing);
 			}
-			retVal = retVal / opVal;
+			return false;
 		}
-		if (retVal.GetType() == VERR) {
-			ParseError(line, "Illegal operand types for the operation.");
+		if (op.apply != CatAction) {
+			limit = string::npos; //What the chain gives is not what is stored
+		}
+		if (!op.apply(token, line, retVal, opVal, limit)) {
 			return false;
 		}
-		token = Parser::GetNextToken(in, line);
 	}
-	Parser::PushBackToken(token);
-	return true;
+}
+
+//Expr ::= AndExpr {.OR. AndExpr}
+//AndExpr ::= NotExpr {.AND. NotExpr}
+//RelOperand ::= SumExpr [(== | < | >) SumExpr]
+//SumExpr ::= MultExpr {(+ | - | //) MultExpr}
+bool Expr(istream& in, int& line, Value & retVal) {
+	return Climb(in, line, PREC_OR, retVal);
+}
+
+//A // chain that is the whole expression is what gets stored, so it stops appending at
+//the destination length. A chain compared at this level gives a LOGICAL, which cannot
+//be stored into a CHARACTER variable.
+static bool StoredExpr(istream& in, int& line, Value & retVal, size_t limit) {
+	return Climb(in, line, PREC_OR, retVal, limit);
+}
+
+//MultExpr ::= TermExpr {(* | / ) TermExpr}
+bool MultExpr(istream& in, int& line, Value & retVal) {
+	return Climb(in, line, PREC_MULT, retVal);
 }
 
 //TermExpr ::= SFactor {** SFactor}
 bool TermExpr(istream& in, int& line, Value& retVal) {
-	if (!SFactor(in, line, retVal)) {
-		return false;
-	}
-	LexItem token = Parser::GetNextToken(in, line);
-
-	while (token == POW) {
-		Value opVal;
-		if (!TermExpr(in, line, opVal)) {
-			ParseError(line, "Missing exponent operand");
-		}
-		retVal = retVal.Power(opVal);
-		token = Parser::GetNextToken(in, line);
-	}
-	Parser::PushBackToken(token);
-	return true;
+	return Climb(in, line, PREC_POW, retVal);
 }
 
 //SFactor ::= [+ | -] Factor
 bool SFactor(istream& in, int& line, Value& retVal) {
 	int sign = 1;
-	LexItem token = Parser::GetNextToken(in, line);
+	Token token = Parser::PeekToken(in, line).GetToken();
 
-	if (token == MINUS) {
-		sign = -1;
-		if (retVal.GetType() == VSTRING) {
-			ParseError(line, "Run-Time Error: Illegal Operand Type for Sign Operator");
-			return false;
-		}
-	} else if (token == PLUS) {
-		sign = 1;
+	if (token == MINUS || token == PLUS) {
+		Parser::GetNextToken(in, line);
+		sign = token == MINUS ? -1 : 1;
 		if (retVal.GetType() == VSTRING) {
 			ParseError(line, "Run-Time Error: Illegal Operand Type for Sign Operator");
 			return false;
 		}
-	} else {
-		Parser::PushBackToken(token);
 	}
-	if (!Factor(in, line, sign, retVal)) {
-		return false;
-	}
-	return true;
+	return Factor(in, line, sign, retVal);
 }
 
 //Var ::= IDENT
@@ -621,7 +3955,7 @@ bool Var(istream& in, int& line, LexItem & idtok) {
 	
 	if (token == IDENT) {
 		varName = token.GetLexeme();
-		if (!(defVar.find(varName)->second)) {
+		if (frame != nullptr ? token.GetSlot() < 0 : program->defVar.find(varName) == program->defVar.end()) {
 			ParseError(line, "Undeclared Variable");
 			return false;
 		}
@@ -634,20 +3968,209 @@ bool Var(istream& in, int& line, LexItem & idtok) {
 	return false;
 }
 
-//Factor ::= IDENT | ICONST | RCONST | SCONST | (Expr)
+//Operand of an expression over arrays: an array variable, or a LOGICAL RelOperand standing for every element
+//MaskOperand ::= .NOT. MaskOperand | (MaskExpr) | IDENT | RelOperand
+static bool MaskOperand(istream& in, int& line, Mask & mask) {
+	LexItem token = Parser::PeekToken(in, line);
+	if (token == NOT || token == LPAREN) {
+		Parser::GetNextToken(in, line);
+		if (!EnterNesting(line)) {
+			return false;
+		}
+		bool status = token == NOT ? MaskOperand(in, line, mask) : MaskExpr(in, line, mask);
+		--expr_depth;
+		if (!status) {
+			if (!depth_exceeded) {
+				ParseError(line, token == NOT ? "Missing Operand After Operator" : "Missing Expression");
+			}
+			return false;
+		}
+		if (token == LPAREN && Parser::GetNextToken(in, line) != RPAREN) {
+			ParseError(line, "Missing Right Parenthesis");
+			return false;
+		}
+		if (token == NOT && mask.scalar) {
+			mask.value = !mask.value;
+		} else if (token == NOT) {
+			mask.Own().Not();
+		}
+		return true;
+	}
+	VarRef ref;
+	if (token == IDENT && Parser::PeekToken(in, line, 1) != LPAREN && Lookup(token, ref) && ref.array != nullptr) {
+		Parser::GetNextToken(in, line);
+		mask.scalar = false;
+		mask.borrowed = ref.array;
+		return true;
+	}
+	Value val;
+	if (!Climb(in, line, PREC_REL, val)) {
+		return false;
+	}
+	if (!val.IsBool()) {
+		ParseError(line, "Illegal Operand Type for the Operation.");
+		return false;
+	}
+	mask.scalar = true;
+	mask.value = val.GetBool();
+	return true;
+}
+
+//Applies .AND. or .OR. element by element, a word at a time; a scalar either decides
+//every element or leaves the array as it is
+static bool CombineMasks(const LexItem & op, Mask & left, Mask & right) {
+	bool conjunction = op == AND;
+	if (left.scalar && right.scalar) {
+		left.value = conjunction ? left.value && right.value : left.value || right.value;
+		return true;
+	}
+	if (!left.scalar && !right.scalar && left.Bits().Size() != right.Bits().Size()) {
+		ParseError(op.GetLinenum(), "Runtime Error - Array Sizes Do Not Conform");
+		return false;
+	}
+	if (left.scalar || (!right.scalar && left.borrowed != nullptr && right.borrowed == nullptr)) {
+		swap(left, right); //Into the array, or the array already copied
+	}
+	if (right.scalar) {
+		if (right.value != conjunction) {
+			left.own = BitArray(left.Bits().Size(), right.value);
+			left.borrowed = nullptr;
+		}
+	} else if (conjunction) {
+		left.Own().And(right.Bits());
+	} else {
+		left.Own().Or(right.Bits());
+	}
+	return true;
+}
+
+static bool MaskClimb(istream& in, int& line, int minPrec, Mask & mask) {
+	if (!MaskOperand(in, line, mask)) {
+		return false;
+	}
+	while (true) {
+		Token t = Parser::PeekToken(in, line).GetToken();
+		const BinaryOperator & op = binary_operators[t];
+		if ((t != AND && t != OR) || op.prec < minPrec) {
+			return true;
+		}
+		LexItem token = Parser::GetNextToken(in, line);
+		Mask right;
+		if (!MaskClimb(in, line, op.prec + 1, right)) {
+			ParseError(line, op.missing);
+			return false;
+		}
+		if (!CombineMasks(token, mask, right)) {
+			return false;
+		}
+	}
+}
+
+//MaskExpr ::= MaskOperand {(.AND. | .OR.) MaskOperand}, with the precedence of Expr
+static bool MaskExpr(istream& in, int& line, Mask & mask) {
+	return MaskClimb(in, line, PREC_OR, mask);
+}
+
+//Stores the value of an expression over arrays into every element of array
+static bool AssignMask(int line, BitArray & array, Mask & mask) {
+	if (mask.scalar) {
+		array.Fill(mask.value);
+		return true;
+	}
+	if (mask.Bits().Size() != array.Size()) {
+		ParseError(line, "Runtime Error - Array Sizes Do Not Conform");
+		return false;
+	}
+	if (mask.borrowed != &array) {
+		array = mask.borrowed != nullptr ? *mask.borrowed : move(mask.own);
+	}
+	return true;
+}
+
+//COUNT, ANY or ALL (MaskExpr): how many elements of the array are .TRUE., whether any is and whether all are
+static bool IntrinsicCall(istream& in, int& line, Intrinsic intrinsic, const string & name, Value & retVal) {
+	Parser::GetNextToken(in, line);
+	Mask mask;
+	if (!EnterNesting(line)) {
+		return false;
+	}
+	bool status = MaskExpr(in, line, mask);
+	--expr_depth;
+	if (!status) {
+		if (!depth_exceeded) {
+			ParseError(line, "Missing Expression");
+		}
+		return false;
+	}
+	if (Parser::GetNextToken(in, line) != RPAREN) {
+		ParseError(line, "Missing Right Parenthesis");
+		return false;
+	}
+	if (mask.scalar) {
+		ParseError(line, "Illegal Argument for " + name);
+		return false;
+	}
+	const BitArray & bits = mask.Bits();
+	if (intrinsic == INTRINSIC_COUNT) {
+		retVal = Value((int) bits.Count());
+	} else {
+		retVal = Value(intrinsic == INTRINSIC_ANY ? bits.Any() : bits.All());
+	}
+	return true;
+}
+
+//Factor ::= IDENT | IDENT ( [Arg {, Arg}] ) | ICONST | RCONST | SCONST | BCONST | (Expr)
 bool Factor(istream& in, int& line, int sign, Value& retVal) {
 	LexItem token = Parser::GetNextToken(in, line);
 	if (token == IDENT) {
-		string lexeme = token.GetLexeme();
-		if (!(defVar.find(lexeme)->second)) {
+		if (!program->Subprograms.empty()) {
+			auto sub = program->Subprograms.find(token.GetLexeme());
+			if (sub != program->Subprograms.end() && Parser::PeekToken(in, line) == LPAREN) {
+				if (!sub->second.function) {
+					ParseError(line, "Subroutine Referenced as a Function");
+					return false;
+				}
+				if (!Invoke(in, line, sub->second, &retVal)) {
+					return false;
+				}
+				if (retVal.GetType() == VINT || retVal.GetType() == VREAL) {
+					retVal = retVal * sign;
+				}
+				return true;
+			}
+		}
+		VarRef ref;
+		if (!Lookup(token, ref)) {
+			Intrinsic intrinsic = IntrinsicOf(token.GetLexeme());
+			if (intrinsic != INTRINSIC_NONE && Parser::PeekToken(in, line) == LPAREN) {
+				if (!IntrinsicCall(in, line, intrinsic, token.GetLexeme(), retVal)) {
+					return false;
+				}
+				if (retVal.GetType() == VINT) {
+					retVal = retVal * sign;
+				}
+				return true;
+			}
 			ParseError(line, "Undeclared Variable");
 			return false;
 		}
-		if (!initVar[lexeme]) {
+		if (ref.array != nullptr) {
+			size_t index;
+			if (Parser::PeekToken(in, line) != LPAREN) {
+				ParseError(token.GetLinenum(), "Illegal Use of Array");
+				return false;
+			}
+			if (!Subscript(in, line, *ref.array, index)) {
+				return false;
+			}
+			retVal = Value(ref.array->Get(index));
+			return true;
+		}
+		if (!*ref.init && !checking) { //Whether it is set depends on the path taken
 			ParseError(line, "Using Uninitialized Variable");
 			return false;
 		}
-		retVal = TempsResults[lexeme];
+		retVal = *ref.val;
 		if (retVal.GetType() == VINT || retVal.GetType() == VREAL) {
 			retVal = retVal * sign;
 		}
@@ -666,6 +4189,9 @@ bool Factor(istream& in, int& line, int sign, Value& retVal) {
 		retVal.SetType(VREAL);
 		retVal.SetReal(stod(token.GetLexeme()) * sign);
 		return true;
+	} else if (token == BCONST) {
+		retVal = Value(token.GetLexeme() == ".TRUE.");
+		return true;
 	} else if (token == SCONST) {
 		retVal.SetType(VSTRING);
 		string strLexeme = token.GetLexeme();
@@ -677,8 +4203,15 @@ bool Factor(istream& in, int& line, int sign, Value& retVal) {
 		retVal.SetString(strLexeme);
 		return true;
 	} else if (token == LPAREN) {
-		if (!Expr(in, line, retVal)) {
-			ParseError(line, "Missing Expression");
+		if (!EnterNesting(line)) {
+			return false;
+		}
+		bool status = Expr(in, line, retVal);
+		--expr_depth;
+		if (!status) {
+			if (!depth_exceeded) {
+				ParseError(line, "Missing Expression");
+			}
 			return false;
 		}
 		token = Parser::GetNextToken(in, line);
@@ -2,6 +2,8 @@
 #define INTERPRETER_H_
 
 #include <iostream>
+#include <vector>
+#include <cstdint>
 
 using namespace std;
 
@@ -15,8 +17,16 @@ extern bool VarList(istream& in, int& line, LexItem & idtok, int strlen = 1 );
 extern bool Stmt(istream& in, int& line);
 extern bool SimpleStmt(istream& in, int& line);
 extern bool PrintStmt(istream& in, int& line);
+extern bool ReadStmt(istream& in, int& line);
+extern bool OpenStmt(istream& in, int& line);
+extern bool WriteStmt(istream& in, int& line);
+extern bool CloseStmt(istream& in, int& line);
 extern bool BlockIfStmt(istream& in, int& line);
 extern bool SimpleIfStmt(istream& in, int& line);
+extern bool DoConcurrentStmt(istream& in, int& line);
+extern bool SelectStmt(istream& in, int& line);
+extern bool SubprogramDef(istream& in, int& line);
+extern bool CallStmt(istream& in, int& line);
 extern bool AssignStmt(istream& in, int& line);
 extern bool Var(istream& in, int& line, LexItem & idtok);
 extern bool ExprList(istream& in, int& line);
@@ -27,6 +37,70 @@ extern bool TermExpr(istream& in, int& line, Value & retVal);
 extern bool SFactor(istream& in, int& line, Value & retVal);
 extern bool Factor(istream& in, int& line, int sign, Value & retVal);
 
+//Execution budgets, checked at statement boundaries and DO CONCURRENT iterations
+enum Budget { BUDGET_STATEMENTS, BUDGET_TIME, BUDGET_CHARACTER, BUDGET_OUTPUT, BUDGET_COUNT };
+
 extern int ErrCount();
+extern void SetThreadCount(unsigned count);
+extern void SetMaxDepth(int depth);
+extern int MaxDepth();
+extern void SetMaxCallDepth(int depth);
+extern void PrintStats(ostream & out);
+//Appends the statements, assignments, IF decisions and errors of the run to a
+//memory-mapped ring of capacity bytes in path, decoded by tools/tracedump.cpp
+extern bool OpenTrace(const string & path, size_t capacity);
+
+//Memory accounting behind --mem-report, by the subsystem the bytes belong to
+enum MemSubsystem { MEM_SOURCE, MEM_TOKENS, MEM_SYMBOLS, MEM_VARIABLES, MEM_STRINGS, MEM_OUTPUT, MEM_COUNT };
+extern void EnableMemReport();
+//Bytes of a buffer the interpreter does not own, e.g. the source read into memory
+extern void ChargeMemory(MemSubsystem subsystem, long long bytes);
+extern long long TokenBytes(const vector<LexItem> & tokens);
+//Live and peak bytes of each subsystem, then the top variables by footprint
+extern void PrintMemReport(ostream & out, int top);
+extern void SetBudget(Budget budget, double limit);
+extern bool BudgetsSet();
+extern int Finish(bool status, ostream & out);
+
+//Checkpoints of the main program every `every` top-level statements, written to path
+extern void SetCheckpoint(const string & path, long long every, uint64_t sourceHash);
+extern bool LoadCheckpoint(istream& in, int& line, long long & outputOffset);
+extern bool ResumeProg(istream& in, int& line);
+
+//Incremental re-execution: snapshots every `every` top-level statements, kept across runs
+//in a cache file, let a run of an edited program start at its first changed statement
+extern void SetIncremental(long long every);
+extern bool LoadIncremental(const string & path, const string & config, const string & source, istream& in, int& line, string & output, bool & resumed);
+extern bool SaveIncremental(const string & path, const string & config, const string & source, const string & output);
+
+//A program with its own variables, subprograms, output, READ input and budget use.
+//Prog and the functions above work on the one main runs.
+struct ProgramContext;
+extern ProgramContext * NewProgram(ostream & out, const string & inputName);
+extern void DeleteProgram(ProgramContext * context);
+//Runs the whole program on the calling thread, closing its output with Finish; returns the exit status.
+//With tokens, the program is read from them instead of in, e.g. when many programs share one lexing.
+extern int RunProgram(ProgramContext * context, istream & in, const vector<LexItem> * tokens = nullptr);
+//Gives a variable of the program an initial value in place of the one it is declared with
+extern void BindVariable(ProgramContext * context, const string & name, const string & text, bool quoted);
+//The value a variable of the type is given by a binding of text, as READ converts its
+//input; false when the text is not a value of the type
+extern bool BindingValue(Token type, int strlen, const string & text, bool quoted, Value & val);
+//Bound names the program has not declared
+extern vector<string> UnusedBindings(ProgramContext * context);
+//Lets a scheduler preempt programs run on the calling thread: every few statements
+//sliceOver is asked whether the time slice is over, and if so yield switches away
+extern void SetPreemption(bool (*sliceOver)(), void (*yield)());
+//Checks the grammar and the declaration and type rules without executing the program,
+//writing diagnostics to out; returns the number of errors. Threads may check programs in parallel.
+extern int CheckProgram(istream & in, ostream & out);
+extern void ReplayTokens(const vector<LexItem> * tokens);
+extern bool OpenInput(const string & name);
+//Whether the program run by main has read a record of its input
+extern bool InputUsed();
+//Buffer size of each unit connected by OPEN, and whether the units' files are written with direct I/O
+extern void SetUnitBuffer(size_t bytes, bool direct);
+//Whether the program run by main has opened a file with OPEN
+extern bool UnitsUsed();
 
 #endif
@@ -2,7 +2,7 @@
 
 LexItem getNextToken(istream& in, int& linenumber) {
     enum TokState {
-        START, INID, INSTRING, ININT, INREAL, INMULT, INDIV, INDOT, INEQ, INCOMMENT, INDCOLON
+        START, INID, INSTRING, ININT, INREAL, INMULT, INDIV, INDOT, INDOTWORD, INEQ, INCOMMENT, INDCOLON
     };
     TokState lexstate = START;
     string lexeme;
@@ -28,7 +28,7 @@ LexItem getNextToken(istream& in, int& linenumber) {
                     lexstate = INMULT;
                 } else if (ch == '/') { //Can be DIV, or CONCAT
                     lexstate = INDIV;
-                } else if (ch == '.') { //Can be DOT, or RCONST
+                } else if (ch == '.') { //Can be DOT, RCONST, a logical operator or BCONST
                     lexstate = INDOT;
                 } else if (ch == '=') { //Can be ASSOP, or EQ
                     lexstate = INEQ;
@@ -81,6 +81,10 @@ LexItem getNextToken(istream& in, int& linenumber) {
                 if (isdigit(ch)) {
                     lexeme += ch;
                 } else if (ch == '.') {
+                    if (isalpha(in.peek())) { //1.and.
+                        in.putback(ch);
+                        return LexItem(ICONST, lexeme, linenumber);
+                    }
                     if (!isdigit(in.peek())) { //in the case of 1.123.3
                         return LexItem(ERR, lexeme, linenumber);
                     }
@@ -94,6 +98,9 @@ LexItem getNextToken(istream& in, int& linenumber) {
             case INREAL:
                 if (isdigit(ch)) {
                     lexeme += ch;
+                } else if (ch == '.' && isalpha(in.peek())) { //1.5.and.
+                    in.putback(ch);
+                    return LexItem(RCONST, lexeme, linenumber);
                 } else if (ch == '.') {
                     lexeme += ch;
                     linenumber++;
@@ -108,11 +115,25 @@ LexItem getNextToken(istream& in, int& linenumber) {
                 if (isdigit(ch)) {
                     lexeme += ch;
                     lexstate = INREAL;
+                } else if (isalpha(ch)) {
+                    lexeme += ch;
+                    lexstate = INDOTWORD;
                 } else {
                     in.putback(ch);
                     return LexItem(DOT, lexeme, linenumber);
                 }
                 break;
+            case INDOTWORD:
+                if (isalpha(ch)) {
+                    lexeme += ch;
+                } else if (ch == '.') {
+                    lexeme += ch;
+                    return dotted_word(lexeme, linenumber);
+                } else {
+                    in.putback(ch);
+                    return LexItem(ERR, lexeme, linenumber);
+                }
+                break;
             case INSTRING:
                 if (ch == '\n') {
                     linenumber++;
@@ -165,9 +186,8 @@ LexItem getNextToken(istream& in, int& linenumber) {
                     lexeme += ch;
                     return LexItem(DCOLON, lexeme, linenumber);
                 } else {
-                    lexeme += ch;
-                    linenumber++;
-                    return LexItem(ERR, lexeme, linenumber);
+                    in.putback(ch);
+                    return LexItem(COLON, lexeme, linenumber);
                 }
                 break;
             default:
@@ -178,7 +198,7 @@ LexItem getNextToken(istream& in, int& linenumber) {
 }
 
 LexItem id_or_kw(const string& lexeme, int linenum) {
-    std::map<string, Token> keywordMap = {
+    static const std::map<string, Token> keywordMap = {
         {"if", IF},
         {"else", ELSE},
         {"print", PRINT},
@@ -189,6 +209,20 @@ LexItem id_or_kw(const string& lexeme, int linenum) {
         {"then", THEN},
         {"program", PROGRAM},
         {"len", LEN},
+        {"do", DO},
+        {"concurrent", CONCURRENT},
+        {"subroutine", SUBROUTINE},
+        {"function", FUNCTION},
+        {"call", CALL},
+        {"intent", INTENT},
+        {"read", READ},
+        {"select", SELECT},
+        {"case", CASE},
+        {"default", DEFAULT},
+        {"logical", LOGICAL},
+        {"open", OPEN},
+        {"write", WRITE},
+        {"close", CLOSE},
     };
     std::string lowerLexeme = lexeme;
     for (int i = 0; i < lowerLexeme.length(); i++) { //Convert to lower since reserved words are not case sensitive
@@ -202,6 +236,26 @@ LexItem id_or_kw(const string& lexeme, int linenum) {
     }
  }
 
+//.AND., .OR., .NOT., .TRUE. or .FALSE., in any case; a logical constant's lexeme is .TRUE. or .FALSE.
+LexItem dotted_word(const string& lexeme, int linenum) {
+    std::string lowerLexeme = lexeme;
+    for (size_t i = 0; i < lowerLexeme.length(); i++) {
+        lowerLexeme[i] = tolower(lowerLexeme[i]);
+    }
+    if (lowerLexeme == ".and.") {
+        return LexItem(AND, lexeme, linenum);
+    } else if (lowerLexeme == ".or.") {
+        return LexItem(OR, lexeme, linenum);
+    } else if (lowerLexeme == ".not.") {
+        return LexItem(NOT, lexeme, linenum);
+    } else if (lowerLexeme == ".true.") {
+        return LexItem(BCONST, ".TRUE.", linenum);
+    } else if (lowerLexeme == ".false.") {
+        return LexItem(BCONST, ".FALSE.", linenum);
+    }
+    return LexItem(ERR, lexeme, linenum);
+}
+
 ostream& operator<<(ostream& out, const LexItem& tok) {
     if (tok.GetToken() == ICONST) {
         out << "ICONST: (" << tok.GetLexeme() << ")";
@@ -224,6 +278,20 @@ ostream& operator<<(ostream& out, const LexItem& tok) {
     else if (tok.GetToken() == THEN) {out << "THEN";}
     else if (tok.GetToken() == PROGRAM) {out << "PROGRAM";}
     else if (tok.GetToken() == LEN) {out << "LEN";}
+    else if (tok.GetToken() == DO) {out << "DO";}
+    else if (tok.GetToken() == CONCURRENT) {out << "CONCURRENT";}
+    else if (tok.GetToken() == SUBROUTINE) {out << "SUBROUTINE";}
+    else if (tok.GetToken() == FUNCTION) {out << "FUNCTION";}
+    else if (tok.GetToken() == CALL) {out << "CALL";}
+    else if (tok.GetToken() == INTENT) {out << "INTENT";}
+    else if (tok.GetToken() == READ) {out << "READ";}
+    else if (tok.GetToken() == SELECT) {out << "SELECT";}
+    else if (tok.GetToken() == CASE) {out << "CASE";}
+    else if (tok.GetToken() == DEFAULT) {out << "DEFAULT";}
+    else if (tok.GetToken() == LOGICAL) {out << "LOGICAL";}
+    else if (tok.GetToken() == OPEN) {out << "OPEN";}
+    else if (tok.GetToken() == WRITE) {out << "WRITE";}
+    else if (tok.GetToken() == CLOSE) {out << "CLOSE";}
     else if (tok.GetToken() == PLUS) {out << "PLUS";}
     else if (tok.GetToken() == MINUS) {out << "MINUS";}
     else if (tok.GetToken() == MULT) {out << "MULT";}
@@ -234,11 +302,25 @@ ostream& operator<<(ostream& out, const LexItem& tok) {
     else if (tok.GetToken() == GTHAN) {out << "GTHAN";}
     else if (tok.GetToken() == LTHAN) {out << "LTHAN";}
     else if (tok.GetToken() == CAT) {out << "CAT";}
+    else if (tok.GetToken() == AND) {out << "AND";}
+    else if (tok.GetToken() == OR) {out << "OR";}
+    else if (tok.GetToken() == NOT) {out << "NOT";}
     else if (tok.GetToken() == COMMA) {out << "COMMA";}
     else if (tok.GetToken() == LPAREN) {out << "LPAREN";}
     else if (tok.GetToken() == RPAREN) {out << "RPAREN";}
     else if (tok.GetToken() == DOT) {out << "DOT";}
     else if (tok.GetToken() == DCOLON) {out << "DCOLON";}
+    else if (tok.GetToken() == COLON) {out << "COLON";}
     else if (tok.GetToken() == DEF) {out << "DEF";}
     return out;
-}
\ No newline at end of file
+}
+
+//Lexes the whole input; the last token is DONE, or the first ERR
+void Tokenize(istream& in, int& linenumber, vector<LexItem>& tokens) {
+    LexItem tok;
+    do {
+        tok = getNextToken(in, linenumber);
+        tok.SetPos(tokens.size());
+        tokens.push_back(tok);
+    } while (tok != DONE && tok != ERR);
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <vector>
 using namespace std;
 
 
@@ -12,16 +13,19 @@ enum Token {
 	//Keywords or reserved words
 	IF, ELSE, PRINT, INTEGER, REAL,
 	CHARACTER, END, THEN, PROGRAM,
-	TRUE, FALSE, LEN,
+	TRUE, FALSE, LEN, DO, CONCURRENT,
+	SUBROUTINE, FUNCTION, CALL, INTENT,
+	READ, SELECT, CASE, DEFAULT, LOGICAL,
+	OPEN, WRITE, CLOSE,
 	//Identifiers
 	IDENT, 
 	//Constants
 	ICONST, RCONST, SCONST, BCONST,
 	//Operators
 	PLUS, MINUS, MULT, DIV, ASSOP, EQ, POW,
-	GTHAN, LTHAN, CAT,
+	GTHAN, LTHAN, CAT, AND, OR, NOT,
 	//Delimiters
-	COMMA, LPAREN, RPAREN, DOT, DCOLON, DEF,
+	COMMA, LPAREN, RPAREN, DOT, DCOLON, COLON, DEF,
 	//Error
 	ERR,
 	//On EOF
@@ -31,18 +35,24 @@ enum Token {
 
 class LexItem {
 	Token	token;
+	int	pos; //Position of the token in the program's tokens, -1 when it has none
 	string	lexeme;
 	int	lnum;
+	int	slot; //Frame slot of an identifier in a subprogram body, -1 when not resolved
 
 public:
 	LexItem() {
 		token = ERR;
+		pos = -1;
 		lnum = -1;
+		slot = -1;
 	}
 	LexItem(Token token, string lexeme, int line) {
 		this->token = token;
+		this->pos = -1;
 		this->lexeme = lexeme;
 		this->lnum = line;
+		this->slot = -1;
 	}
 
 	bool operator==(const Token token) const { return this->token == token; }
@@ -51,13 +61,19 @@ public:
 	Token	GetToken() const { return token; }
 	string	GetLexeme() const { return lexeme; }
 	int	GetLinenum() const { return lnum; }
+	int	GetSlot() const { return slot; }
+	int	GetPos() const { return pos; }
+	void	SetPos(int p) { pos = p; }
+	void	SetSlot(int s) { slot = s; }
 };
 
 
 
 extern ostream& operator<<(ostream& out, const LexItem& tok);
 extern LexItem id_or_kw(const string& lexeme, int linenum);
+extern LexItem dotted_word(const string& lexeme, int linenum);
 extern LexItem getNextToken(istream& in, int& linenum);
+extern void Tokenize(istream& in, int& linenum, vector<LexItem>& tokens);
 
 
 #endif
@@ -0,0 +1,814 @@
+#include <map>
+#include <cmath>
+
+#include "lockstep.h"
+#include "interpreter.h"
+
+//Precedence of the binary operators, as Climb in interpreter.cpp ranks them
+enum Precedence { PREC_NONE, PREC_OR, PREC_AND, PREC_NOT, PREC_REL, PREC_ADD, PREC_MULT, PREC_POW };
+
+static Precedence PrecedenceOf(Token token) {
+	switch (token) {
+		case OR: return PREC_OR;
+		case AND: return PREC_AND;
+		case EQ: case LTHAN: case GTHAN: return PREC_REL;
+		case PLUS: case MINUS: case CAT: return PREC_ADD;
+		case MULT: case DIV: return PREC_MULT;
+		case POW: return PREC_POW;
+		default: return PREC_NONE;
+	}
+}
+
+enum NodeKind { NODE_CONST, NODE_VAR, NODE_NOT, NODE_BINARY };
+
+//An expression node; its value has the same type in every lane
+struct Node {
+	NodeKind kind;
+	ValType type;
+	Token op = ERR; //Of a binary node
+	int left = -1, right = -1; //Operands
+	int var = -1; //Of a variable
+	int sign = 1; //Applied to a numeric variable
+	Value constant;
+};
+
+enum StmtKind { STMT_DECLARE, STMT_ASSIGN, STMT_PRINT, STMT_IF };
+
+struct LockstepStmt {
+	StmtKind kind;
+	int var = -1; //Declared or assigned
+	int binding = -1; //Column of the CSV record a declared variable is bound to
+	vector<int> exprs; //Initializer, value assigned, items printed or condition
+	bool block = false; //IF ... THEN rather than an IF with one statement
+	vector<LockstepStmt> then, other;
+	//Whether the lanes skipping a body stop where it ends: a nested block IF stops them earlier
+	bool thenSkips = true;
+	bool otherSkips = true;
+};
+
+struct Variable {
+	Token type;
+	int strlen;
+};
+
+struct LockstepProgram {
+	vector<Node> nodes;
+	vector<Variable> vars;
+	map<string, int> index;
+	vector<LockstepStmt> stmts;
+};
+
+static ValType ValueType(Token type) {
+	return type == INTEGER ? VINT : type == REAL ? VREAL : type == LOGICAL ? VBOOL : VSTRING;
+}
+
+//Whether a variable of the type may hold a value of vtype, as AssignStmt allows
+static bool Holds(Token type, ValType vtype) {
+	if (type == CHARACTER) {
+		return vtype == VSTRING;
+	}
+	if (type == LOGICAL) {
+		return vtype == VBOOL;
+	}
+	return vtype == VINT || vtype == VREAL;
+}
+
+//The value a variable starts with, as VarList declares it
+static Value DeclaredValue(Token type, int strlen) {
+	Value val;
+	val.SetType(ValueType(type));
+	if (type == CHARACTER) {
+		val.SetstrLen(strlen);
+		val.SetString(string(strlen, ' '));
+	}
+	return val;
+}
+
+//A value of the type, to find the type an operator gives
+static Value Sample(ValType type) {
+	return type == VINT ? Value(1) : type == VREAL ? Value(1.0) : type == VBOOL ? Value(true) : Value(string());
+}
+
+//Compiles the tokens as the interpreter would read them, keeping the type each variable
+//holds at each point; false where a lane could go another way than the others
+class Compiler {
+	const vector<LexItem> & tokens;
+	const vector<string> & names;
+	int maxDepth;
+	LockstepProgram & prog;
+	size_t pos = 0;
+	int depth = 0;
+	vector<ValType> types; //Of the value each variable holds
+
+	Token Peek() const {
+		return pos < tokens.size() ? tokens[pos].GetToken() : DONE;
+	}
+
+	const LexItem & Next() {
+		static const LexItem done(DONE, "", 0);
+		return pos < tokens.size() ? tokens[pos++] : done;
+	}
+
+	int Add(const Node & node) {
+		prog.nodes.push_back(node);
+		return prog.nodes.size() - 1;
+	}
+
+	bool Enter() {
+		if (depth >= maxDepth) {
+			return false;
+		}
+		depth++;
+		return true;
+	}
+
+	//seed is the value the interpreter evaluates into, whose type and length a leftmost constant takes on
+	int Expr(const Value & seed) {
+		depth = 0;
+		return Climb(PREC_OR, seed);
+	}
+
+	int Climb(int minPrec, const Value & seed) {
+		int node = minPrec <= PREC_NOT && Peek() == NOT ? Not(seed) : SFactor(seed);
+		while (node >= 0) {
+			Token op = Peek();
+			Precedence prec = PrecedenceOf(op);
+			if (prec == PREC_NONE || prec < minPrec) {
+				return node;
+			}
+			pos++;
+			if (op == POW && !Enter()) {
+				return -1;
+			}
+			int right = Climb(op == POW ? prec : prec + 1, Value());
+			if (op == POW) {
+				depth--;
+			}
+			node = right < 0 ? -1 : Binary(op, node, right);
+		}
+		return -1;
+	}
+
+	int Not(const Value & seed) {
+		pos++;
+		if (!Enter()) {
+			return -1;
+		}
+		int operand = Climb(PREC_NOT, seed);
+		depth--;
+		if (operand < 0 || prog.nodes[operand].type != VBOOL) {
+			return -1;
+		}
+		Node node;
+		node.kind = NODE_NOT;
+		node.type = VBOOL;
+		node.left = operand;
+		return Add(node);
+	}
+
+	int Binary(Token op, int left, int right) {
+		Value a = Sample(prog.nodes[left].type), b = Sample(prog.nodes[right].type), result;
+		switch (op) {
+			case PLUS: result = a + b; break;
+			case MINUS: result = a - b; break;
+			case MULT: result = a * b; break;
+			case DIV: result = a / b; break;
+			case POW: result = a.Power(b); break;
+			case EQ: result = a == b; break;
+			case LTHAN: result = a < b; break;
+			case GTHAN: result = a > b; break;
+			case CAT: result = a.Catenate(b); break;
+			default: result = a.IsBool() && b.IsBool() ? Value(true) : Value(); break;
+		}
+		if (result.IsErr()) {
+			return -1;
+		}
+		Node node;
+		node.kind = NODE_BINARY;
+		node.type = result.GetType();
+		node.op = op;
+		node.left = left;
+		node.right = right;
+		return Add(node);
+	}
+
+	int SFactor(const Value & seed) {
+		int sign = 1;
+		if (Peek() == MINUS || Peek() == PLUS) {
+			sign = Next().GetToken() == MINUS ? -1 : 1;
+			if (seed.IsString()) {
+				return -1;
+			}
+		}
+		return Factor(sign, seed);
+	}
+
+	//The constants are evaluated with the code of Factor
+	int Factor(int sign, const Value & seed) {
+		const LexItem & token = Next();
+		Node node;
+		node.kind = NODE_CONST;
+		Value val = seed;
+		try {
+			switch (token.GetToken()) {
+				case IDENT: {
+					auto var = prog.index.find(token.GetLexeme());
+					if (var == prog.index.end()) {
+						return -1; //A function or intrinsic call, or an error
+					}
+					node.kind = NODE_VAR;
+					node.var = var->second;
+					node.type = types[var->second];
+					node.sign = sign;
+					return Add(node);
+				}
+				case ICONST:
+					if (val.IsInt()) {
+						val.SetInt(stoi(token.GetLexeme()) * sign);
+					} else if (val.IsReal()) {
+						val.SetReal(stod(token.GetLexeme()) * sign);
+					} else {
+						val.SetType(VINT);
+						val.SetInt(stoi(token.GetLexeme()) * sign);
+					}
+					break;
+				case RCONST:
+					val.SetType(VREAL);
+					val.SetReal(stod(token.GetLexeme()) * sign);
+					break;
+				case BCONST:
+					val = Value(token.GetLexeme() == ".TRUE.");
+					break;
+				case SCONST: {
+					val.SetType(VSTRING);
+					string text = token.GetLexeme();
+					if (val.GetstrLen() > 0) {
+						text.resize(val.GetstrLen(), ' ');
+					}
+					val.SetString(text);
+					break;
+				}
+				case LPAREN: {
+					if (!Enter()) {
+						return -1;
+					}
+					int inner = Climb(PREC_OR, seed);
+					depth--;
+					return inner >= 0 && Next().GetToken() == RPAREN ? inner : -1;
+				}
+				default:
+					return -1;
+			}
+		} catch (const exception &) {
+			return -1; //A constant stoi or stod cannot read
+		}
+		node.type = val.GetType();
+		node.constant = val;
+		return Add(node);
+	}
+
+	bool Decl() {
+		Token type = Next().GetToken();
+		int strlen = 1;
+		if (Peek() == LPAREN) {
+			pos++;
+			if (type != CHARACTER || Next().GetToken() != LEN || Next().GetToken() != ASSOP || Peek() != ICONST) {
+				return false;
+			}
+			const string & len = Next().GetLexeme();
+			if (len.size() > 5 || (strlen = stoi(len)) > 65536 || Next().GetToken() != RPAREN) {
+				return false;
+			}
+		}
+		if (Next().GetToken() != DCOLON) {
+			return false; //INTENT is only declared in subprograms
+		}
+		while (true) {
+			const LexItem & name = Next();
+			if (name.GetToken() != IDENT || prog.index.count(name.GetLexeme()) || Peek() == LPAREN) {
+				return false;
+			}
+			LockstepStmt stmt;
+			stmt.kind = STMT_DECLARE;
+			stmt.var = prog.vars.size();
+			prog.index[name.GetLexeme()] = stmt.var; //Declared while its initializer is evaluated
+			prog.vars.push_back({type, strlen});
+			types.push_back(ValueType(type));
+			if (Peek() == ASSOP) {
+				pos++;
+				int expr = Expr(DeclaredValue(type, strlen));
+				if (expr < 0 || !Holds(type, prog.nodes[expr].type)) {
+					return false;
+				}
+				stmt.exprs.push_back(expr);
+				types[stmt.var] = prog.nodes[expr].type;
+			}
+			for (size_t i = 0; i < names.size(); i++) {
+				if (names[i] == name.GetLexeme()) {
+					stmt.binding = i; //The last column of a name binds it
+					types[stmt.var] = ValueType(type);
+				}
+			}
+			prog.stmts.push_back(stmt);
+			if (Peek() != COMMA) {
+				return true;
+			}
+			pos++;
+		}
+	}
+
+	bool Stmt(vector<LockstepStmt> & body) {
+		switch (Peek()) {
+			case IDENT: return Assign(body);
+			case PRINT: return Print(body);
+			case IF: return If(body);
+			default: return false;
+		}
+	}
+
+	bool Assign(vector<LockstepStmt> & body) {
+		auto var = prog.index.find(Next().GetLexeme());
+		if (var == prog.index.end() || Next().GetToken() != ASSOP) {
+			return false;
+		}
+		LockstepStmt stmt;
+		stmt.kind = STMT_ASSIGN;
+		stmt.var = var->second;
+		const Variable & v = prog.vars[stmt.var];
+		Value seed = Sample(types[stmt.var]);
+		seed.SetstrLen(seed.IsString() ? v.strlen : 0); //The variable's current value
+		int expr = Expr(seed);
+		if (expr < 0 || !Holds(v.type, prog.nodes[expr].type)) {
+			return false;
+		}
+		stmt.exprs.push_back(expr);
+		types[stmt.var] = prog.nodes[expr].type;
+		body.push_back(stmt);
+		return true;
+	}
+
+	bool Print(vector<LockstepStmt> & body) {
+		pos++;
+		if (Next().GetToken() != DEF || Next().GetToken() != COMMA) {
+			return false;
+		}
+		LockstepStmt stmt;
+		stmt.kind = STMT_PRINT;
+		do {
+			int expr = Expr(Value());
+			if (expr < 0) {
+				return false;
+			}
+			stmt.exprs.push_back(expr);
+			if (Peek() != COMMA) {
+				break;
+			}
+			pos++;
+		} while (true);
+		body.push_back(stmt);
+		return true;
+	}
+
+	//Whether the tokens in [first, last) hold one of the tokens the skipping of a body stops at
+	bool Contains(size_t first, size_t last, Token a, Token b) const {
+		for (size_t i = first; i < last; i++) {
+			if (tokens[i].GetToken() == a || tokens[i].GetToken() == b) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Both branches must leave every variable with values of one type
+	bool If(vector<LockstepStmt> & body) {
+		pos++;
+		if (Next().GetToken() != LPAREN) {
+			return false;
+		}
+		int cond = Expr(Value());
+		if (cond < 0 || Next().GetToken() != RPAREN || prog.nodes[cond].type != VBOOL) {
+			return false;
+		}
+		LockstepStmt stmt;
+		stmt.kind = STMT_IF;
+		stmt.exprs.push_back(cond);
+		if (Peek() != THEN) {
+			if ((Peek() != IDENT && Peek() != PRINT) || !Stmt(stmt.then)) {
+				return false;
+			}
+			body.push_back(stmt);
+			return true;
+		}
+		pos++;
+		stmt.block = true;
+		vector<ValType> before = types;
+		size_t first = pos;
+		while (Peek() != ELSE && Peek() != END) {
+			if (!Stmt(stmt.then)) {
+				return false;
+			}
+		}
+		stmt.thenSkips = !Contains(first, pos, ELSE, END);
+		vector<ValType> after = types;
+		types = before;
+		if (Next().GetToken() == ELSE) {
+			first = pos;
+			while (Peek() != END) {
+				if (!Stmt(stmt.other)) {
+					return false;
+				}
+			}
+			stmt.otherSkips = !Contains(first, pos, END, END);
+			pos++;
+		}
+		if (types != after || Next().GetToken() != IF) {
+			return false;
+		}
+		body.push_back(stmt);
+		return true;
+	}
+
+public:
+	Compiler(const vector<LexItem> & tokens, const vector<string> & names, int maxDepth, LockstepProgram & prog)
+		: tokens(tokens), names(names), maxDepth(maxDepth), prog(prog) {}
+
+	//PROGRAM IDENT {Decl} {Stmt} END PROGRAM IDENT
+	bool Program() {
+		if (Next().GetToken() != PROGRAM || Next().GetToken() != IDENT) {
+			return false;
+		}
+		while (Peek() == INTEGER || Peek() == REAL || Peek() == CHARACTER || Peek() == LOGICAL) {
+			if (!Decl()) {
+				return false;
+			}
+		}
+		while (Peek() != END) {
+			if (!Stmt(prog.stmts)) {
+				return false;
+			}
+		}
+		pos++;
+		return Next().GetToken() == PROGRAM && Next().GetToken() == IDENT;
+	}
+};
+
+LockstepProgram * CompileLockstep(const vector<LexItem> & tokens, const vector<string> & names, int maxDepth) {
+	LockstepProgram * prog = new LockstepProgram;
+	if (!Compiler(tokens, names, maxDepth, *prog).Program()) {
+		delete prog;
+		return nullptr;
+	}
+	return prog;
+}
+
+void DeleteLockstep(LockstepProgram * program) {
+	delete program;
+}
+
+bool LockstepDeclares(const LockstepProgram & program, const string & name) {
+	return program.index.count(name) > 0;
+}
+
+//A value for each lane, in the vector of its type
+struct Column {
+	vector<int> ints;
+	vector<double> reals;
+	vector<char> bools;
+	vector<string> strings;
+
+	void Allocate(ValType type, size_t lanes) {
+		switch (type) {
+			case VINT: ints.resize(lanes); break;
+			case VREAL: reals.resize(lanes); break;
+			case VBOOL: bools.resize(lanes); break;
+			default: strings.resize(lanes); break;
+		}
+	}
+};
+
+//The lanes of a numeric column of the type of the second argument
+static int * Numeric(Column & column, int) {
+	return column.ints.data();
+}
+
+static double * Numeric(Column & column, double) {
+	return column.reals.data();
+}
+
+//Calls f with the lanes of two numeric columns, int or double as their types are
+template <class F> static void Numbers(const Column & a, ValType ta, const Column & b, ValType tb, F f) {
+	if (ta == VINT && tb == VINT) {
+		f(a.ints.data(), b.ints.data());
+	} else if (ta == VINT) {
+		f(a.ints.data(), b.reals.data());
+	} else if (tb == VINT) {
+		f(a.reals.data(), b.ints.data());
+	} else {
+		f(a.reals.data(), b.reals.data());
+	}
+}
+
+//The state of the lanes running together: every operator is a loop over all of them,
+//and a mask tells which lanes the statement or operand being run is for
+class Lanes {
+	const LockstepProgram & prog;
+	const vector<vector<Field>> & rows;
+	size_t first, n;
+	vector<Column> vars, temps;
+	vector<vector<char>> init; //Whether each variable is set in each lane
+	vector<vector<char>> decided; //Lanes an .AND. or .OR. evaluates its right operand for
+
+	void Drop(const char * mask, const vector<char> & when) {
+		for (size_t k = 0; k < n; k++) {
+			alive[k] &= !(mask[k] && when[k]);
+		}
+	}
+
+	const Column & Eval(int id, const char * mask) {
+		const Node & node = prog.nodes[id];
+		Column & out = temps[id];
+		switch (node.kind) {
+			case NODE_CONST:
+				return out;
+			case NODE_VAR: {
+				const vector<char> & set = init[node.var];
+				for (size_t k = 0; k < n; k++) {
+					alive[k] &= !mask[k] || set[k]; //Using Uninitialized Variable
+				}
+				const Column & val = vars[node.var];
+				if (node.sign == 1 || node.type == VSTRING || node.type == VBOOL) {
+					return val;
+				}
+				if (node.type == VINT) {
+					for (size_t k = 0; k < n; k++) {
+						out.ints[k] = val.ints[k] * node.sign;
+					}
+				} else {
+					for (size_t k = 0; k < n; k++) {
+						out.reals[k] = val.reals[k] * node.sign;
+					}
+				}
+				return out;
+			}
+			case NODE_NOT: {
+				const Column & val = Eval(node.left, mask);
+				for (size_t k = 0; k < n; k++) {
+					out.bools[k] = !val.bools[k];
+				}
+				return out;
+			}
+			default:
+				break;
+		}
+		if (node.op == AND || node.op == OR) {
+			//The right operand is only evaluated, and only raises errors, where the left one does not decide
+			bool conjunction = node.op == AND;
+			const Column & a = Eval(node.left, mask);
+			vector<char> & right = decided[id];
+			for (size_t k = 0; k < n; k++) {
+				right[k] = mask[k] && a.bools[k] == conjunction;
+			}
+			const Column & b = Eval(node.right, right.data());
+			for (size_t k = 0; k < n; k++) {
+				out.bools[k] = conjunction ? a.bools[k] && b.bools[k] : a.bools[k] || b.bools[k];
+			}
+			return out;
+		}
+		const Column & a = Eval(node.left, mask);
+		const Column & b = Eval(node.right, mask);
+		ValType ta = prog.nodes[node.left].type, tb = prog.nodes[node.right].type;
+		if (node.op == CAT || (node.op == EQ && ta == VSTRING)) {
+			for (size_t k = 0; k < n; k++) {
+				if (!mask[k] || !alive[k]) {
+					continue;
+				}
+				if (node.op == EQ) {
+					out.bools[k] = a.strings[k] == b.strings[k];
+				} else {
+					out.strings[k].assign(a.strings[k]).append(b.strings[k]);
+				}
+			}
+			return out;
+		}
+		Numbers(a, ta, b, tb, [&](auto x, auto y) {
+			using T = decltype(x[0] + y[0]);
+			switch (node.op) {
+				case EQ: case LTHAN: case GTHAN:
+					for (size_t k = 0; k < n; k++) {
+						out.bools[k] = node.op == EQ ? x[k] == y[k] : node.op == LTHAN ? x[k] < y[k] : x[k] > y[k];
+					}
+					return;
+				case POW:
+					for (size_t k = 0; k < n; k++) {
+						out.reals[k] = pow(x[k], y[k]);
+					}
+					return;
+				default:
+					break;
+			}
+			T * z = Numeric(out, T());
+			if (node.op == DIV) {
+				for (size_t k = 0; k < n; k++) {
+					alive[k] &= !mask[k] || y[k] != 0; //Illegal division by Zero
+				}
+				for (size_t k = 0; k < n; k++) {
+					bool divides = mask[k] && alive[k];
+					z[k] = divides ? x[k] / (divides ? y[k] : 1) : T(0);
+				}
+				return;
+			}
+			for (size_t k = 0; k < n; k++) {
+				z[k] = node.op == PLUS ? x[k] + y[k] : node.op == MINUS ? x[k] - y[k] : x[k] * y[k];
+			}
+		});
+		return out;
+	}
+
+	//Stores the value in the lanes of mask, fitted to the variable's length
+	void Store(int var, ValType type, const Column & val, const char * mask) {
+		Column & dest = vars[var];
+		vector<char> & set = init[var];
+		switch (type) {
+			case VINT:
+				for (size_t k = 0; k < n; k++) {
+					dest.ints[k] = mask[k] ? val.ints[k] : dest.ints[k];
+				}
+				break;
+			case VREAL:
+				for (size_t k = 0; k < n; k++) {
+					dest.reals[k] = mask[k] ? val.reals[k] : dest.reals[k];
+				}
+				break;
+			case VBOOL:
+				for (size_t k = 0; k < n; k++) {
+					dest.bools[k] = mask[k] ? val.bools[k] : dest.bools[k];
+				}
+				break;
+			default:
+				for (size_t k = 0; k < n; k++) {
+					if (mask[k] && alive[k]) {
+						if (&dest != &val) {
+							dest.strings[k].assign(val.strings[k]);
+						}
+						dest.strings[k].resize(prog.vars[var].strlen, ' ');
+					}
+				}
+				break;
+		}
+		for (size_t k = 0; k < n; k++) {
+			set[k] |= mask[k];
+		}
+	}
+
+	//Declares the variable as VarList does: its initial value, then its initializer, then its binding
+	void Declare(const LockstepStmt & stmt, const char * mask) {
+		const Variable & var = prog.vars[stmt.var];
+		Column & col = vars[stmt.var];
+		for (size_t k = 0; k < n; k++) {
+			init[stmt.var][k] = var.type == CHARACTER;
+			if (var.type == CHARACTER) {
+				col.strings[k].assign(var.strlen, ' ');
+			}
+		}
+		if (!stmt.exprs.empty()) {
+			Store(stmt.var, prog.nodes[stmt.exprs[0]].type, Eval(stmt.exprs[0], mask), mask);
+		}
+		if (stmt.binding < 0) {
+			return;
+		}
+		Value val;
+		for (size_t k = 0; k < n; k++) {
+			const Field & field = rows[first + k][stmt.binding];
+			if (!alive[k] || !BindingValue(var.type, var.strlen, field.text, field.quoted, val)) {
+				alive[k] = 0;
+				continue;
+			}
+			switch (var.type) {
+				case INTEGER: col.ints[k] = val.GetInt(); break;
+				case REAL: col.reals[k] = val.GetReal(); break;
+				case LOGICAL: col.bools[k] = val.GetBool(); break;
+				default: col.strings[k] = val.GetString(); break;
+			}
+			init[stmt.var][k] = 1;
+		}
+	}
+
+	void Print(const LockstepStmt & stmt, const char * mask) {
+		vector<const Column *> items;
+		for (int expr : stmt.exprs) {
+			items.push_back(&Eval(expr, mask));
+		}
+		for (size_t k = 0; k < n; k++) {
+			if (!mask[k] || !alive[k]) {
+				continue;
+			}
+			string & line = output[k];
+			for (size_t i = 0; i < items.size(); i++) {
+				const Column & col = *items[i];
+				switch (prog.nodes[stmt.exprs[i]].type) {
+					case VINT: Value(col.ints[k]).AppendTo(line); break;
+					case VREAL: Value(col.reals[k]).AppendTo(line); break;
+					case VBOOL: Value(bool(col.bools[k])).AppendTo(line); break;
+					default: line += col.strings[k]; break;
+				}
+			}
+			line += '\n';
+		}
+	}
+
+	//A simple IF whose condition is false leaves its statement to be read as the next
+	//one, which is an error; a block IF skips to the first ELSE or END after THEN
+	void If(const LockstepStmt & stmt, const char * mask) {
+		const Column & cond = Eval(stmt.exprs[0], mask);
+		vector<char> taken(n), skipped(n);
+		for (size_t k = 0; k < n; k++) {
+			taken[k] = mask[k] && alive[k] && cond.bools[k];
+			skipped[k] = mask[k] && alive[k] && !cond.bools[k];
+		}
+		if (!stmt.block || !stmt.thenSkips) {
+			Drop(mask, skipped);
+		}
+		if (stmt.block && !stmt.otherSkips) {
+			Drop(mask, taken);
+		}
+		Run(stmt.then, taken.data());
+		if (stmt.block) {
+			Run(stmt.other, skipped.data());
+		}
+	}
+
+public:
+	vector<char> alive; //Lanes whose run has not gone where the others cannot follow
+	vector<string> output; //Printed by each lane
+
+	Lanes(const LockstepProgram & prog, const vector<vector<Field>> & rows, size_t first, size_t n)
+		: prog(prog), rows(rows), first(first), n(n), vars(prog.vars.size()), temps(prog.nodes.size()),
+		init(prog.vars.size(), vector<char>(n)), decided(prog.nodes.size()), alive(n, 1), output(n) {
+		for (size_t v = 0; v < prog.vars.size(); v++) {
+			Token type = prog.vars[v].type;
+			vars[v].Allocate(ValueType(type), n);
+			if (type == INTEGER || type == REAL) {
+				vars[v].Allocate(type == INTEGER ? VREAL : VINT, n); //Both hold either
+			}
+		}
+		for (size_t id = 0; id < prog.nodes.size(); id++) {
+			const Node & node = prog.nodes[id];
+			Column & col = temps[id];
+			if (node.kind == NODE_CONST) {
+				switch (node.type) {
+					case VINT: col.ints.assign(n, node.constant.GetInt()); break;
+					case VREAL: col.reals.assign(n, node.constant.GetReal()); break;
+					case VBOOL: col.bools.assign(n, node.constant.GetBool()); break;
+					default: col.strings.assign(n, node.constant.GetString()); break;
+				}
+			} else if (node.kind != NODE_VAR || node.sign != 1) {
+				col.Allocate(node.type, n);
+			}
+			if (node.op == AND || node.op == OR) {
+				decided[id].resize(n);
+			}
+		}
+	}
+
+	void Run(const vector<LockstepStmt> & body, const char * within) {
+		vector<char> mask(n);
+		for (const LockstepStmt & stmt : body) {
+			for (size_t k = 0; k < n; k++) {
+				mask[k] = within[k] && alive[k];
+			}
+			switch (stmt.kind) {
+				case STMT_DECLARE:
+					Declare(stmt, mask.data());
+					break;
+				case STMT_ASSIGN: {
+					vector<char> & set = init[stmt.var];
+					for (size_t k = 0; k < n; k++) {
+						set[k] |= mask[k]; //AssignStmt marks the variable set before evaluating its value
+					}
+					const Node & value = prog.nodes[stmt.exprs[0]];
+					Store(stmt.var, value.type, Eval(stmt.exprs[0], mask.data()), mask.data());
+					break;
+				}
+				case STMT_PRINT:
+					Print(stmt, mask.data());
+					break;
+				case STMT_IF:
+					If(stmt, mask.data());
+					break;
+			}
+		}
+	}
+};
+
+void RunLockstep(const LockstepProgram & program, const vector<vector<Field>> & rows, size_t first, size_t last,
+	vector<string> & output, vector<char> & finished) {
+	size_t n = last - first;
+	Lanes lanes(program, rows, first, n);
+	vector<char> all(n, 1);
+	lanes.Run(program.stmts, all.data());
+	output.resize(n);
+	finished.assign(lanes.alive.begin(), lanes.alive.end());
+	for (size_t k = 0; k < n; k++) {
+		output[k] = finished[k] ? move(lanes.output[k]) : string();
+	}
+}
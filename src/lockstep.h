@@ -0,0 +1,39 @@
+#ifndef LOCKSTEP_H_
+#define LOCKSTEP_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "lex.h"
+
+//A value of a CSV record, bound to the variable its column names
+struct Field {
+	string text;
+	bool quoted;
+};
+
+//Lock-step execution of the runs of a --batch sweep. A program made only of scalar
+//declarations, assignments, PRINT and IF is compiled once, and the runs of many rows
+//execute it side by side: every variable is a column holding one lane per row, every
+//operator is a loop over the lanes, and an IF splits the lanes it runs in into those
+//that take each branch with masks. A lane whose run would raise an error, or would take
+//a path that the interpreter reads differently from the structure of the program, is
+//dropped from the others, and its row is left to be run on its own.
+struct LockstepProgram;
+
+//Compiles a program whose variables named by names are bound by every row; nullptr
+//when the program is not one that lock-step runs can execute
+extern LockstepProgram * CompileLockstep(const vector<LexItem> & tokens, const vector<string> & names, int maxDepth);
+extern void DeleteLockstep(LockstepProgram * program);
+
+//Runs rows [first, last) side by side. finished[i] tells whether row first + i ran to
+//its end, and output[i] then holds what it printed.
+extern void RunLockstep(const LockstepProgram & program, const vector<vector<Field>> & rows, size_t first, size_t last,
+	vector<string> & output, vector<char> & finished);
+
+//Whether the program declares the variable
+extern bool LockstepDeclares(const LockstepProgram & program, const string & name);
+
+#endif
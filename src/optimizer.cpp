@@ -0,0 +1,733 @@
+#include "optimizer.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+
+//Static view of a value: what the interpreter will hold at run time, as far as it is known.
+//T_NONE is the unset Value the interpreter evaluates PRINT items and conditions into.
+enum VType { T_NONE, T_INT, T_REAL, T_STR, T_UNKNOWN };
+
+//Numeric or CHARACTER, which AssignStmt enforces even when the exact type is not known
+enum VClass { C_NUM, C_STR, C_UNKNOWN };
+
+enum NodeKind { N_LEAF, N_SIGN, N_PAREN, N_BINARY };
+
+struct Node {
+	NodeKind kind;
+	size_t begin, end; //Token span [begin, end)
+	int left, right;
+	Token op;
+};
+
+enum StmtKind { S_DECL, S_ASSIGN, S_PRINT, S_BLOCK };
+
+struct Statement {
+	StmtKind kind;
+	size_t begin, end;
+	size_t target; //Token of the assigned or declared variable
+	Token declType;
+	vector<int> exprs; //The assigned value, or the PRINT list
+};
+
+struct VarInfo {
+	Token declared;
+	VType type;
+	VClass cls;
+	bool init;
+};
+
+struct Replacement {
+	size_t begin, end;
+	string ident; //Empty to delete the span
+};
+
+//Recursive descent over the token vector that follows the same grammar, and the same
+//token consumption, as the interpreter. Only top-level statements are recorded; IF,
+//DO CONCURRENT and SELECT CASE constructs are kept whole as S_BLOCK.
+class ProgramParser {
+	const vector<LexItem> & toks;
+	size_t pos;
+	int maxDepth;
+	int depth;
+
+	Token Peek(size_t ahead = 0) const {
+		return pos + ahead < toks.size() ? toks[pos + ahead].GetToken() : DONE;
+	}
+	bool Accept(Token t) {
+		if (Peek() != t) {
+			return false;
+		}
+		pos++;
+		return true;
+	}
+	int AddNode(NodeKind kind, size_t begin, size_t end, int left, int right, Token op) {
+		nodes.push_back({kind, begin, end, left, right, op});
+		return nodes.size() - 1;
+	}
+
+	int Factor() {
+		size_t begin = pos;
+		Token t = Peek();
+		if (t == IDENT || t == ICONST || t == RCONST || t == SCONST) {
+			pos++;
+			return AddNode(N_LEAF, begin, pos, -1, -1, t);
+		}
+		if (t != LPAREN || depth >= maxDepth) {
+			return -1;
+		}
+		pos++;
+		depth++;
+		int inner = Expr();
+		depth--;
+		if (inner < 0 || !Accept(RPAREN)) {
+			return -1;
+		}
+		return AddNode(N_PAREN, begin, pos, inner, -1, LPAREN);
+	}
+
+	int SFactor() {
+		size_t begin = pos;
+		if (Peek() == PLUS || Peek() == MINUS) {
+			Token sign = Peek();
+			pos++;
+			int factor = Factor();
+			return factor < 0 ? -1 : AddNode(N_SIGN, begin, pos, factor, -1, sign);
+		}
+		return Factor();
+	}
+
+	int TermExpr() {
+		int left = SFactor();
+		if (left < 0 || Peek() != POW) {
+			return left;
+		}
+		pos++;
+		if (depth >= maxDepth) {
+			return -1;
+		}
+		depth++;
+		int right = TermExpr();
+		depth--;
+		return right < 0 ? -1 : AddNode(N_BINARY, nodes[left].begin, pos, left, right, POW);
+	}
+
+	int MultExpr() {
+		int left = TermExpr();
+		while (left >= 0 && (Peek() == MULT || Peek() == DIV)) {
+			Token op = Peek();
+			pos++;
+			int right = TermExpr();
+			left = right < 0 ? -1 : AddNode(N_BINARY, nodes[left].begin, pos, left, right, op);
+		}
+		return left;
+	}
+
+	int Expr() {
+		int left = MultExpr();
+		while (left >= 0 && (Peek() == PLUS || Peek() == MINUS || Peek() == CAT)) {
+			Token op = Peek();
+			pos++;
+			int right = MultExpr();
+			left = right < 0 ? -1 : AddNode(N_BINARY, nodes[left].begin, pos, left, right, op);
+		}
+		return left;
+	}
+
+	bool RelExpr() {
+		if (Expr() < 0) {
+			return false;
+		}
+		if (Peek() == EQ || Peek() == LTHAN || Peek() == GTHAN) {
+			pos++;
+			return Expr() >= 0;
+		}
+		return true;
+	}
+
+	bool Assign(bool top) {
+		Statement s = {S_ASSIGN, pos, 0, pos, IDENT, {}};
+		pos += 2; //IDENT =
+		int value = Expr();
+		if (value < 0) {
+			return false;
+		}
+		s.end = pos;
+		s.exprs.push_back(value);
+		targets[s.target] = top ? s.end : 0;
+		if (top) {
+			stmts.push_back(s);
+		}
+		return true;
+	}
+
+	bool Print(bool top) {
+		Statement s = {S_PRINT, pos, 0, 0, PRINT, {}};
+		pos++;
+		if (!Accept(DEF) || !Accept(COMMA)) {
+			return false;
+		}
+		do {
+			int item = Expr();
+			if (item < 0) {
+				return false;
+			}
+			s.exprs.push_back(item);
+		} while (Accept(COMMA));
+		if (Peek() == ERR) {
+			return false;
+		}
+		s.end = pos;
+		if (top) {
+			stmts.push_back(s);
+		}
+		return true;
+	}
+
+	bool SimpleStmt(bool top) {
+		if (Peek() == IDENT && Peek(1) == ASSOP) {
+			return Assign(top);
+		}
+		if (Peek() == PRINT) {
+			return Print(top);
+		}
+		return false;
+	}
+
+	//Statements up to, but not including, the ELSE, CASE or END that closes a block
+	bool Block() {
+		while (Peek() == IF || Peek() == PRINT || Peek() == IDENT || Peek() == DO || Peek() == SELECT) {
+			if (!Stmt(false)) {
+				return false;
+			}
+		}
+		return Peek() == ELSE || Peek() == CASE || Peek() == END;
+	}
+
+	bool If() {
+		pos++;
+		if (!Accept(LPAREN) || !RelExpr() || !Accept(RPAREN)) {
+			return false;
+		}
+		if (!Accept(THEN)) {
+			return SimpleStmt(false);
+		}
+		if (!Block()) {
+			return false;
+		}
+		if (Accept(ELSE) && (!Block() || Peek() != END)) {
+			return false;
+		}
+		return Accept(END) && Accept(IF);
+	}
+
+	bool Do() {
+		pos++;
+		if (!Accept(CONCURRENT) || !Accept(LPAREN) || !Accept(IDENT) || !Accept(ASSOP)
+			|| Expr() < 0 || !Accept(COLON) || Expr() < 0 || !Accept(RPAREN)) {
+			return false;
+		}
+		if (!Block() || Peek() != END) {
+			return false;
+		}
+		return Accept(END) && Accept(DO);
+	}
+
+	//The CASE values are constants, which the interpreter checks when it compiles the construct
+	bool Select() {
+		pos++;
+		if (!Accept(CASE) || !Accept(LPAREN) || Expr() < 0 || !Accept(RPAREN)) {
+			return false;
+		}
+		while (Accept(CASE)) {
+			if (!Accept(DEFAULT)) {
+				if (!Accept(LPAREN)) {
+					return false;
+				}
+				while (Peek() == ICONST || Peek() == SCONST || Peek() == PLUS || Peek() == MINUS || Peek() == COLON || Peek() == COMMA) {
+					pos++;
+				}
+				if (!Accept(RPAREN)) {
+					return false;
+				}
+			}
+			if (!Block() || Peek() == ELSE) {
+				return false;
+			}
+		}
+		return Accept(END) && Accept(SELECT);
+	}
+
+	bool Stmt(bool top) {
+		size_t begin = pos;
+		bool status;
+		if (Peek() == IF) {
+			status = If();
+		} else if (Peek() == DO) {
+			status = Do();
+		} else if (Peek() == SELECT) {
+			status = Select();
+		} else {
+			return SimpleStmt(top);
+		}
+		if (status && top) {
+			stmts.push_back({S_BLOCK, begin, pos, 0, IF, {}});
+		}
+		return status;
+	}
+
+	bool Decl() {
+		Token type = Peek();
+		pos++;
+		if (Accept(LPAREN) && !(Accept(LEN) && Accept(ASSOP) && Accept(ICONST) && Accept(RPAREN))) {
+			return false;
+		}
+		if (!Accept(DCOLON)) {
+			return false;
+		}
+		do {
+			Statement s = {S_DECL, pos, 0, pos, type, {}};
+			if (!Accept(IDENT)) {
+				return false;
+			}
+			if (Accept(ASSOP)) {
+				int value = Expr();
+				if (value < 0) {
+					return false;
+				}
+				s.exprs.push_back(value);
+			}
+			s.end = pos;
+			stmts.push_back(s);
+		} while (Accept(COMMA));
+		return true;
+	}
+
+public:
+	vector<Node> nodes;
+	vector<Statement> stmts;
+	map<size_t, size_t> targets; //Assigned variable token -> end of its statement when top-level, else 0
+
+	ProgramParser(const vector<LexItem> & t, int limit) : toks(t), pos(0), maxDepth(limit), depth(0) {}
+
+	//Prog ::= PROGRAM IDENT {Decl} {Stmt} END PROGRAM IDENT
+	bool Parse() {
+		if (!Accept(PROGRAM) || !Accept(IDENT)) {
+			return false;
+		}
+		while (Peek() == INTEGER || Peek() == REAL || Peek() == CHARACTER) {
+			if (!Decl()) {
+				return false;
+			}
+		}
+		while (Peek() == IF || Peek() == PRINT || Peek() == IDENT || Peek() == DO || Peek() == SELECT) {
+			if (!Stmt(true)) {
+				return false;
+			}
+		}
+		return Accept(END) && Accept(PROGRAM) && Accept(IDENT);
+	}
+};
+
+class Optimizer {
+	vector<LexItem> & toks;
+	int maxDepth;
+	vector<Node> nodes;
+	map<string, VarInfo> vars;
+
+	//Available expressions: key -> variable holding its value, and the keys depending on each variable
+	map<string, string> avail;
+	map<string, set<string> > dependents;
+
+	string Lexeme(size_t i) const { return toks[i].GetLexeme(); }
+
+	static VClass ClassOfType(VType t) {
+		if (t == T_INT || t == T_REAL) {
+			return C_NUM;
+		}
+		return t == T_STR ? C_STR : C_UNKNOWN;
+	}
+
+	static VType DeclaredType(Token t) {
+		return t == INTEGER ? T_INT : t == REAL ? T_REAL : T_STR;
+	}
+
+	void Declare(const Statement & s) {
+		VarInfo info = {s.declType, DeclaredType(s.declType), ClassOfType(DeclaredType(s.declType)), s.declType == CHARACTER};
+		if (!s.exprs.empty()) {
+			info.type = TypeOf(s.exprs[0], DeclaredType(s.declType));
+			info.cls = ClassOf(s.exprs[0]);
+			info.init = true;
+		}
+		vars[Lexeme(s.target)] = info;
+	}
+
+	//The type the interpreter gives node n when seed is the Value it evaluates into
+	VType TypeOf(int n, VType seed) {
+		const Node & node = nodes[n];
+		if (node.kind == N_LEAF) {
+			if (node.op == IDENT) {
+				auto it = vars.find(Lexeme(node.begin));
+				return it == vars.end() ? T_UNKNOWN : it->second.type;
+			}
+			if (node.op == ICONST) {
+				return seed == T_REAL ? T_REAL : seed == T_UNKNOWN ? T_UNKNOWN : T_INT;
+			}
+			return node.op == RCONST ? T_REAL : T_STR;
+		}
+		if (node.kind != N_BINARY) {
+			return TypeOf(node.left, seed);
+		}
+		VType left = TypeOf(node.left, seed), right = TypeOf(node.right, T_NONE);
+		if (left == T_UNKNOWN || right == T_UNKNOWN) {
+			return T_UNKNOWN;
+		}
+		if (node.op == CAT) {
+			return left == T_STR && right == T_STR ? T_STR : T_UNKNOWN;
+		}
+		if (left == T_STR || right == T_STR) {
+			return T_UNKNOWN;
+		}
+		if (node.op == POW) {
+			return T_REAL;
+		}
+		return left == T_INT && right == T_INT ? T_INT : T_REAL;
+	}
+
+	VClass ClassOf(int n) {
+		const Node & node = nodes[n];
+		if (node.kind == N_LEAF) {
+			if (node.op == IDENT) {
+				auto it = vars.find(Lexeme(node.begin));
+				return it == vars.end() ? C_UNKNOWN : it->second.cls;
+			}
+			return node.op == SCONST ? C_STR : C_NUM;
+		}
+		if (node.kind != N_BINARY) {
+			return ClassOf(node.left);
+		}
+		VClass left = ClassOf(node.left), right = ClassOf(node.right);
+		if (node.op == CAT) {
+			return left == C_STR && right == C_STR ? C_STR : C_UNKNOWN;
+		}
+		return left == C_NUM && right == C_NUM ? C_NUM : C_UNKNOWN;
+	}
+
+	//The leftmost operand is the only one the interpreter evaluates into the seed Value
+	bool LeftmostIsIntConst(int n) const {
+		while (nodes[n].kind != N_LEAF) {
+			n = nodes[n].left;
+		}
+		return nodes[n].op == ICONST;
+	}
+
+	//Identical tokens evaluated into the same kind of seed give identical values
+	string Key(int n, VType seed) {
+		VType type = TypeOf(n, seed);
+		if (type != T_INT && type != T_REAL) {
+			return "";
+		}
+		string key;
+		for (size_t i = nodes[n].begin; i < nodes[n].end; i++) {
+			key += to_string(toks[i].GetToken()) + ":" + Lexeme(i) + " ";
+		}
+		if (LeftmostIsIntConst(n)) {
+			key += seed == T_REAL ? "|R" : "|I";
+		}
+		return key;
+	}
+
+	void Reads(int n, set<string> & names) const {
+		for (size_t i = nodes[n].begin; i < nodes[n].end; i++) {
+			if (toks[i] == IDENT) {
+				names.insert(Lexeme(i));
+			}
+		}
+	}
+
+	void Kill(const string & name) {
+		auto it = dependents.find(name);
+		if (it == dependents.end()) {
+			return;
+		}
+		for (const string & key : it->second) {
+			avail.erase(key);
+		}
+		dependents.erase(it);
+	}
+
+	//Replaces the largest subexpressions of n that are already held by a variable
+	void Reuse(int n, VType seed, vector<Replacement> & edits) {
+		const Node & node = nodes[n];
+		if (node.kind == N_LEAF) {
+			return;
+		}
+		if (node.kind == N_BINARY) {
+			auto it = avail.find(Key(n, seed));
+			if (it != avail.end()) {
+				edits.push_back({node.begin, node.end, it->second});
+				return;
+			}
+			Reuse(node.left, seed, edits);
+			Reuse(node.right, T_NONE, edits);
+			return;
+		}
+		Reuse(node.left, seed, edits);
+	}
+
+	//Records that name now holds the value of n, evaluated into a Value of type seed
+	void Define(const string & name, int n, VType seed) {
+		while (nodes[n].kind == N_PAREN) {
+			n = nodes[n].left;
+		}
+		if (nodes[n].kind != N_BINARY) {
+			return;
+		}
+		set<string> names;
+		Reads(n, names);
+		string key = Key(n, seed);
+		if (key.empty() || names.count(name)) {
+			return;
+		}
+		avail[key] = name;
+		dependents[name].insert(key);
+		for (const string & read : names) {
+			dependents[read].insert(key);
+		}
+	}
+
+	//Variables assigned anywhere inside a block lose what is known about their type
+	void ForgetAssigned(const Statement & s, const map<size_t, size_t> & targets) {
+		for (auto it = targets.lower_bound(s.begin); it != targets.end() && it->first < s.end; ++it) {
+			auto var = vars.find(Lexeme(it->first));
+			if (var != vars.end()) {
+				var->second.type = T_UNKNOWN;
+				if (var->second.cls != ClassOfType(DeclaredType(var->second.declared))) {
+					var->second.cls = C_UNKNOWN;
+				}
+			}
+		}
+	}
+
+	void Assigned(const string & name, int value) {
+		auto it = vars.find(name);
+		if (it != vars.end()) {
+			it->second.type = TypeOf(value, it->second.type);
+			it->second.cls = ClassOfType(DeclaredType(it->second.declared));
+			it->second.init = true;
+		}
+	}
+
+	bool ConstantOk(size_t i) const {
+		errno = 0;
+		if (toks[i] == ICONST) {
+			long v = strtol(Lexeme(i).c_str(), NULL, 10);
+			return errno == 0 && v <= INT_MAX;
+		}
+		double v = strtod(Lexeme(i).c_str(), NULL);
+		return errno == 0 && isfinite(v);
+	}
+
+	bool NonZeroConstant(int n) const {
+		const Node & node = nodes[n];
+		return node.kind == N_LEAF && (node.op == ICONST || node.op == RCONST) && ConstantOk(node.begin)
+			&& strtod(Lexeme(node.begin).c_str(), NULL) != 0;
+	}
+
+	//True when evaluating n can raise none of the interpreter's run-time errors
+	bool ErrorFree(int n, VClass want, const string & target) {
+		const Node & node = nodes[n];
+		switch (node.kind) {
+			case N_LEAF: {
+				if (node.op == IDENT) {
+					auto it = vars.find(Lexeme(node.begin));
+					return it != vars.end() && it->second.cls == want && (it->second.init || Lexeme(node.begin) == target);
+				}
+				if (node.op == SCONST) {
+					return want == C_STR;
+				}
+				return want == C_NUM && ConstantOk(node.begin);
+			}
+			case N_SIGN:
+				return want == C_NUM && ErrorFree(node.left, want, target);
+			case N_PAREN:
+				return ErrorFree(node.left, want, target);
+			default:
+				if ((node.op == CAT) != (want == C_STR)) {
+					return false;
+				}
+				if (node.op == DIV && !NonZeroConstant(node.right)) {
+					return false;
+				}
+				return ErrorFree(node.left, want, target) && ErrorFree(node.right, want, target);
+		}
+	}
+
+	//The leftmost operand of the assignment at target is an integer constant
+	bool SeededByTarget(size_t target) const {
+		size_t i = target + 2;
+		while (toks[i] == PLUS || toks[i] == MINUS || toks[i] == LPAREN) {
+			i++;
+		}
+		return toks[i] == ICONST;
+	}
+
+	void Apply(vector<Replacement> & edits) {
+		if (edits.empty()) {
+			return;
+		}
+		sort(edits.begin(), edits.end(), [](const Replacement & a, const Replacement & b) { return a.begin < b.begin; });
+		vector<LexItem> result;
+		result.reserve(toks.size());
+		size_t next = 0;
+		for (const Replacement & r : edits) {
+			result.insert(result.end(), toks.begin() + next, toks.begin() + r.begin);
+			if (!r.ident.empty()) {
+				result.push_back(LexItem(IDENT, r.ident, toks[r.end - 1].GetLinenum()));
+			}
+			next = r.end;
+		}
+		result.insert(result.end(), toks.begin() + next, toks.end());
+		toks.swap(result);
+	}
+
+public:
+	Optimizer(vector<LexItem> & t, int limit) : toks(t), maxDepth(limit) {}
+
+	bool ValueNumbering() {
+		ProgramParser parser(toks, maxDepth);
+		if (!parser.Parse()) {
+			return false;
+		}
+		nodes.swap(parser.nodes);
+		vars.clear();
+		vector<Replacement> edits;
+		for (const Statement & s : parser.stmts) {
+			if (s.kind == S_BLOCK) {
+				avail.clear();
+				dependents.clear();
+				ForgetAssigned(s, parser.targets);
+				continue;
+			}
+			if (s.kind == S_PRINT) {
+				for (int item : s.exprs) {
+					Reuse(item, T_NONE, edits);
+				}
+				continue;
+			}
+			string name = Lexeme(s.target);
+			if (s.kind == S_DECL) {
+				Declare(s);
+				if (!s.exprs.empty() && s.declType != CHARACTER) {
+					Define(name, s.exprs[0], DeclaredType(s.declType));
+				}
+				continue;
+			}
+			auto var = vars.find(name);
+			if (var == vars.end()) {
+				break; //Undeclared, execution stops here
+			}
+			VType seed = var->second.type;
+			Reuse(s.exprs[0], seed, edits);
+			Kill(name);
+			Assigned(name, s.exprs[0]);
+			if (var->second.declared != CHARACTER) {
+				Define(name, s.exprs[0], seed);
+			}
+		}
+		Apply(edits);
+		return true;
+	}
+
+	bool DeadStores() {
+		ProgramParser parser(toks, maxDepth);
+		if (!parser.Parse()) {
+			return false;
+		}
+		nodes.swap(parser.nodes);
+		vars.clear();
+
+		//Next occurrence of the same identifier, so liveness scans skip everything else
+		vector<size_t> next(toks.size(), toks.size());
+		map<string, size_t> seen;
+		for (size_t i = toks.size(); i-- > 0;) {
+			if (toks[i] == IDENT) {
+				auto it = seen.find(Lexeme(i));
+				if (it != seen.end()) {
+					next[i] = it->second;
+				}
+				seen[Lexeme(i)] = i;
+			}
+		}
+
+		vector<bool> candidate(parser.stmts.size(), false);
+		vector<bool> keepsType(parser.stmts.size(), false);
+		for (size_t k = 0; k < parser.stmts.size(); k++) {
+			const Statement & s = parser.stmts[k];
+			if (s.kind == S_DECL) {
+				Declare(s);
+			} else if (s.kind == S_BLOCK) {
+				ForgetAssigned(s, parser.targets);
+			} else if (s.kind == S_ASSIGN) {
+				string name = Lexeme(s.target);
+				auto var = vars.find(name);
+				if (var == vars.end()) {
+					break;
+				}
+				VClass want = ClassOfType(DeclaredType(var->second.declared));
+				candidate[k] = var->second.cls == want && ErrorFree(s.exprs[0], want, name);
+				VType before = var->second.type;
+				Assigned(name, s.exprs[0]);
+				keepsType[k] = before != T_UNKNOWN && var->second.type == before;
+			}
+		}
+
+		//Backwards, so a store only read by a removed store is removed as well
+		vector<bool> removed(toks.size(), false);
+		vector<Replacement> edits;
+		for (size_t k = parser.stmts.size(); k-- > 0;) {
+			if (!candidate[k]) {
+				continue;
+			}
+			const Statement & s = parser.stmts[k];
+			bool live = false;
+			for (size_t i = next[s.target]; i < toks.size(); i = next[i]) {
+				if (i < s.end || removed[i]) {
+					continue;
+				}
+				auto target = parser.targets.find(i);
+				if (target == parser.targets.end()) {
+					live = true; //Read
+					break;
+				}
+				if (target->second != 0) {
+					//Overwritten by a top-level assignment, live only if that assignment reads it,
+					//or if its leading integer constant takes the type of the value being removed
+					size_t read = next[i];
+					live = (read < target->second && !removed[read]) || (!keepsType[k] && SeededByTarget(i));
+					break;
+				}
+			}
+			if (!live) {
+				edits.push_back({s.begin, s.end, ""});
+				for (size_t i = s.begin; i < s.end; i++) {
+					removed[i] = true;
+				}
+			}
+		}
+		Apply(edits);
+		return true;
+	}
+};
+
+void Optimize(vector<LexItem> & tokens, int maxDepth) {
+	Optimizer opt(tokens, maxDepth);
+	if (opt.ValueNumbering()) {
+		opt.DeadStores();
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+#include <vector>
+
+using namespace std;
+
+#include "lex.h"
+
+//Rewrites the tokens of a whole program before it is interpreted:
+// - local value numbering: within a run of straight-line statements, an expression
+//   already computed into a variable that is unchanged since is replaced by that variable
+// - dead-store elimination: an assignment whose value is overwritten before it is read,
+//   or never read at all, is removed when its evaluation cannot raise an error
+//The tokens are left unchanged when the program does not parse.
+extern void Optimize(vector<LexItem> & tokens, int maxDepth);
+
+#endif
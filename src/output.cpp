@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include "output.h"
+
+AsyncWriter::AsyncWriter(streambuf * sink, size_t capacity) : head(0), tail(0), closing(false), producerParked(false), consumerParked(false), sink(sink) {
+	size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	ring.resize(size);
+	mask = size - 1;
+	writer = thread(&AsyncWriter::WriterLoop, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+	Close();
+}
+
+//The parked flags and the indices are all sequentially consistent, so either the
+//pushing side sees the flag or the parking side sees the new index before it sleeps
+void AsyncWriter::WakeConsumer() {
+	if (consumerParked.load()) {
+		lock_guard<mutex> guard(parkLock);
+		dataReady.notify_one();
+	}
+}
+
+void AsyncWriter::Push(const char * data, size_t len) {
+	size_t pos = head.load(memory_order_relaxed);
+	while (len > 0) {
+		size_t room = ring.size() - (pos - tail.load(memory_order_acquire));
+		if (room == 0) {
+			unique_lock<mutex> guard(parkLock);
+			producerParked.store(true);
+			spaceFreed.wait(guard, [&] { return pos - tail.load() < ring.size(); });
+			producerParked.store(false);
+			continue;
+		}
+		size_t at = pos & mask;
+		size_t n = min(min(room, len), ring.size() - at);
+		copy(data, data + n, ring.begin() + at);
+		data += n;
+		len -= n;
+		pos += n;
+		head.store(pos);
+		WakeConsumer();
+	}
+}
+
+void AsyncWriter::WriterLoop() {
+	size_t pos = tail.load(memory_order_relaxed);
+	for (;;) {
+		size_t end = head.load(memory_order_acquire);
+		if (end == pos) {
+			sink->pubsync();
+			//A busy producer refills the ring within a few yields; parking is far more costly
+			for (int spin = 0; spin < 64 && head.load(memory_order_acquire) == pos; spin++) {
+				this_thread::yield();
+			}
+			if (head.load(memory_order_acquire) != pos) {
+				continue;
+			}
+			unique_lock<mutex> guard(parkLock);
+			consumerParked.store(true);
+			dataReady.wait(guard, [&] { return head.load() != pos || closing.load(); });
+			consumerParked.store(false);
+			if (head.load() == pos) {
+				break; //Closing and nothing left
+			}
+			continue;
+		}
+		size_t at = pos & mask;
+		size_t n = min(end - pos, ring.size() - at);
+		sink->sputn(ring.data() + at, n);
+		pos += n;
+		tail.store(pos);
+		if (producerParked.load()) {
+			lock_guard<mutex> guard(parkLock);
+			spaceFreed.notify_one();
+		}
+	}
+	sink->pubsync();
+}
+
+void AsyncWriter::Close() {
+	if (!writer.joinable()) {
+		return;
+	}
+	{
+		lock_guard<mutex> guard(parkLock);
+		closing.store(true);
+		dataReady.notify_one();
+	}
+	writer.join();
+}
+
+AsyncOutput::AsyncOutput(ostream & stream, size_t capacity) : stream(stream), original(stream.rdbuf()), writer(original, capacity) {
+	setp(batch, batch + sizeof(batch));
+	stream.rdbuf(this);
+}
+
+AsyncOutput::~AsyncOutput() {
+	Forward();
+	writer.Close();
+	stream.rdbuf(original);
+}
+
+void AsyncOutput::Forward() {
+	if (pptr() != pbase()) {
+		writer.Push(pbase(), pptr() - pbase());
+		setp(batch, batch + sizeof(batch));
+	}
+}
+
+int AsyncOutput::overflow(int c) {
+	Forward();
+	if (c != traits_type::eof()) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+streamsize AsyncOutput::xsputn(const char * s, streamsize n) {
+	if (n > epptr() - pptr()) {
+		Forward();
+		if (n > epptr() - pptr()) {
+			writer.Push(s, n);
+			return n;
+		}
+	}
+	copy(s, s + n, pptr());
+	pbump(n);
+	return n;
+}
+
+int AsyncOutput::sync() {
+	Forward();
+	return 0;
+}
+
+OutputCapture::OutputCapture(ostream & stream) : stream(stream), original(stream.rdbuf()) {
+	stream.rdbuf(this);
+}
+
+OutputCapture::~OutputCapture() {
+	stream.rdbuf(original);
+}
+
+int OutputCapture::overflow(int c) {
+	if (c == traits_type::eof()) {
+		return traits_type::not_eof(c);
+	}
+	text += traits_type::to_char_type(c);
+	return original->sputc(traits_type::to_char_type(c));
+}
+
+streamsize OutputCapture::xsputn(const char * s, streamsize n) {
+	text.append(s, n);
+	return original->sputn(s, n);
+}
+
+int OutputCapture::sync() {
+	return original->pubsync();
+}
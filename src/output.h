@@ -0,0 +1,100 @@
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+//Single-producer/single-consumer byte ring buffer drained by a writer thread.
+//The producer and the consumer only share the two running indices; the mutex
+//and condition variables are used to park a side that has nothing to do, never
+//to guard the buffer itself. Push blocks while the ring is full.
+class AsyncWriter {
+	vector<char> ring;
+	size_t mask;
+
+	atomic<size_t> head; //Bytes pushed so far, written by the producer
+	atomic<size_t> tail; //Bytes written out so far, written by the consumer
+	atomic<bool> closing;
+	atomic<bool> producerParked;
+	atomic<bool> consumerParked;
+
+	mutex parkLock;
+	condition_variable spaceFreed;
+	condition_variable dataReady;
+
+	streambuf * sink;
+	thread writer;
+
+	void WriterLoop();
+	void WakeConsumer();
+
+public:
+	//The capacity is rounded up to a power of two
+	AsyncWriter(streambuf * sink, size_t capacity);
+	~AsyncWriter();
+
+	AsyncWriter(const AsyncWriter &) = delete;
+	AsyncWriter & operator=(const AsyncWriter &) = delete;
+
+	void Push(const char * data, size_t len);
+
+	size_t Capacity() const { return ring.size(); }
+
+	//Waits until everything pushed has reached the sink, flushes it and stops the thread
+	void Close();
+};
+
+//Stream buffer that batches the characters of a stream and hands them to an
+//AsyncWriter on every flush. Installing it as the buffer of cout moves all
+//writes to standard output onto the writer thread, in order.
+class AsyncOutput : public streambuf {
+	ostream & stream;
+	streambuf * original;
+	AsyncWriter writer;
+	char batch[4096];
+
+	void Forward();
+
+protected:
+	int overflow(int c) override;
+	streamsize xsputn(const char * s, streamsize n) override;
+	int sync() override;
+
+public:
+	AsyncOutput(ostream & stream, size_t capacity);
+	//Restores the original buffer of the stream after the final flush
+	~AsyncOutput();
+
+	//Bytes of the ring and the batch buffer
+	size_t Capacity() const { return writer.Capacity() + sizeof(batch); }
+};
+
+//Stream buffer that passes the characters of a stream on to its original buffer
+//and keeps a copy of them, for a run whose whole output is saved afterwards
+class OutputCapture : public streambuf {
+	ostream & stream;
+	streambuf * original;
+	string text;
+
+protected:
+	int overflow(int c) override;
+	streamsize xsputn(const char * s, streamsize n) override;
+	int sync() override;
+
+public:
+	OutputCapture(ostream & stream);
+	~OutputCapture();
+
+	const string & Text() const { return text; }
+};
+
+#endif
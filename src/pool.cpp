@@ -0,0 +1,110 @@
+#include "pool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) : workers(threadCount == 0 ? 1 : threadCount), generation(0), active(0), stopping(false), job(nullptr), remaining(0) {
+	for (size_t i = 1; i < workers.size(); i++) {
+		threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		lock_guard<mutex> guard(stateLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (thread & t : threads) {
+		t.join();
+	}
+}
+
+//Pops from the front of our own deque, otherwise steals from the back of another one
+bool WorkStealingPool::NextTask(size_t self, size_t & task) {
+	{
+		Worker & own = workers[self];
+		lock_guard<mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker & victim = workers[(self + i) % workers.size()];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::Drain(size_t self) {
+	size_t task;
+	while (remaining.load() > 0 && NextTask(self, task)) {
+		try {
+			(*job)(task);
+		} catch (...) {
+			lock_guard<mutex> guard(stateLock);
+			if (!failure) {
+				failure = current_exception();
+			}
+		}
+		remaining.fetch_sub(1);
+	}
+}
+
+void WorkStealingPool::WorkerLoop(size_t self) {
+	size_t seen = 0;
+	while (true) {
+		{
+			unique_lock<mutex> guard(stateLock);
+			wake.wait(guard, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		Drain(self);
+		{
+			lock_guard<mutex> guard(stateLock);
+			active--;
+		}
+		finished.notify_all();
+	}
+}
+
+void WorkStealingPool::Run(size_t tasks, const function<void(size_t)> & fn) {
+	if (tasks == 0) {
+		return;
+	}
+	lock_guard<mutex> serial(runLock);
+
+	size_t per = (tasks + workers.size() - 1) / workers.size();
+	for (size_t i = 0; i < workers.size(); i++) {
+		lock_guard<mutex> guard(workers[i].lock);
+		for (size_t t = i * per; t < tasks && t < (i + 1) * per; t++) {
+			workers[i].tasks.push_back(t);
+		}
+	}
+	job = &fn;
+	failure = nullptr;
+	remaining.store(tasks);
+	{
+		lock_guard<mutex> guard(stateLock);
+		active = threads.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	Drain(0);
+	{
+		unique_lock<mutex> guard(stateLock);
+		finished.wait(guard, [&] { return active == 0; });
+	}
+	job = nullptr;
+	if (failure) {
+		rethrow_exception(failure);
+	}
+}
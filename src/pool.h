@@ -0,0 +1,58 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <exception>
+
+using namespace std;
+
+//Fixed set of worker threads running indexed tasks. Every Run call deals the
+//task indices out to per-worker deques in contiguous blocks; a worker takes
+//from the front of its own deque and, once it is empty, steals from the back
+//of the others. The calling thread takes part as worker 0.
+class WorkStealingPool {
+	struct Worker {
+		mutex lock;
+		deque<size_t> tasks;
+	};
+
+	vector<Worker> workers;
+	vector<thread> threads;
+
+	mutex runLock; //Serializes Run calls
+	mutex stateLock;
+	condition_variable wake;
+	condition_variable finished;
+	size_t generation;
+	size_t active; //Threads still working on the current generation
+	bool stopping;
+
+	const function<void(size_t)> * job;
+	atomic<size_t> remaining;
+	exception_ptr failure;
+
+	bool NextTask(size_t self, size_t & task);
+	void Drain(size_t self);
+	void WorkerLoop(size_t self);
+
+public:
+	explicit WorkStealingPool(unsigned threadCount);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+	unsigned Size() const { return workers.size(); }
+
+	//Runs fn(0) .. fn(tasks - 1) across the pool and returns once all of them
+	//have finished. An exception thrown by a task is rethrown here.
+	void Run(size_t tasks, const function<void(size_t)> & fn);
+};
+
+#endif
@@ -1,7 +1,21 @@
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "interpreter.h"
+#include "optimizer.h"
+#include "output.h"
+#include "scheduler.h"
+#include "checkpoint.h"
+#include "check.h"
+#include "batch.h"
+#include "cache.h"
 
 using namespace std;
 
@@ -10,30 +24,367 @@ int main(int argc, char *argv[]) {
 
 	istream *in = NULL;
 	ifstream file;
+	bool optimize = false;
+	bool stats = false;
+	bool memReport = false;
+	int memTop = 10;
+	unsigned hostThreads = 0;
+	double sliceMs = 1.0;
+	vector<string> files;
+	long long checkpointEvery = 0;
+	string checkpointPath;
+	bool resume = false;
+	bool incremental = false;
+	long long snapshotEvery = 100;
+	bool check = false;
+	string batchPath;
+	string tracePath;
+	long traceSize = 16 << 20;
+	string cacheDir;
+	long long cacheSize = 256LL << 20;
+	unsigned threads = 0;
+	bool asyncOutput = false;
+	long outputBuffer = 1 << 20;
+	long unitBuffer = 4 << 20;
+	bool directIO = false;
 		
 	for( int i=1; i<argc; i++) {
 		string arg = argv[i];
 	
-		if( in != NULL ) {
-			cerr << "ONLY ONE FILE NAME ALLOWED" << endl;
-			return 0;
-		} else {
-			file.open(arg.c_str());
-			if( file.is_open() == false ) {
-				cerr << "CANNOT OPEN " << arg << endl;
+		if( arg == "--threads" ) {
+			if( i + 1 >= argc || atoi(argv[i+1]) <= 0 ) {
+				cerr << "INVALID THREAD COUNT" << endl;
+				return 0;
+			}
+			threads = atoi(argv[++i]);
+			SetThreadCount(threads);
+		} else if( arg == "--max-depth" ) {
+			if( i + 1 >= argc || atoi(argv[i+1]) <= 0 ) {
+				cerr << "INVALID MAXIMUM DEPTH" << endl;
+				return 0;
+			}
+			SetMaxDepth(atoi(argv[++i]));
+		} else if( arg == "--max-call-depth" ) {
+			if( i + 1 >= argc || atoi(argv[i+1]) <= 0 ) {
+				cerr << "INVALID MAXIMUM CALL DEPTH" << endl;
+				return 0;
+			}
+			SetMaxCallDepth(atoi(argv[++i]));
+		} else if( arg == "--batch" ) {
+			if( i + 1 >= argc ) {
+				cerr << "MISSING BINDINGS FILE NAME" << endl;
+				return 0;
+			}
+			batchPath = argv[++i];
+		} else if( arg == "--trace" ) {
+			if( i + 1 >= argc ) {
+				cerr << "MISSING TRACE FILE NAME" << endl;
+				return 0;
+			}
+			tracePath = argv[++i];
+		} else if( arg == "--trace-size" ) {
+			if( i + 1 >= argc || atol(argv[i+1]) < 64 ) {
+				cerr << "INVALID TRACE SIZE" << endl;
+				return 0;
+			}
+			traceSize = atol(argv[++i]);
+		} else if( arg == "--cache" ) {
+			if( i + 1 >= argc ) {
+				cerr << "MISSING CACHE DIRECTORY NAME" << endl;
+				return 0;
+			}
+			cacheDir = argv[++i];
+		} else if( arg == "--cache-size" ) {
+			if( i + 1 >= argc || atoll(argv[i+1]) <= 0 ) {
+				cerr << "INVALID CACHE SIZE" << endl;
+				return 0;
+			}
+			cacheSize = atoll(argv[++i]);
+		} else if( arg == "--check" ) {
+			check = true;
+		} else if( arg == "--mem-report" ) {
+			memReport = true;
+		} else if( arg == "--mem-top" ) {
+			if( i + 1 >= argc || atoi(argv[i+1]) <= 0 ) {
+				cerr << "INVALID VARIABLE COUNT" << endl;
+				return 0;
+			}
+			memTop = atoi(argv[++i]);
+		} else if( arg == "--stats" ) {
+			stats = true;
+		} else if( arg == "--async-output" ) {
+			asyncOutput = true;
+		} else if( arg == "--output-buffer" ) {
+			if( i + 1 >= argc || atol(argv[i+1]) <= 0 ) {
+				cerr << "INVALID OUTPUT BUFFER SIZE" << endl;
+				return 0;
+			}
+			outputBuffer = atol(argv[++i]);
+		} else if( arg == "--unit-buffer" ) {
+			if( i + 1 >= argc || atol(argv[i+1]) <= 0 ) {
+				cerr << "INVALID UNIT BUFFER SIZE" << endl;
+				return 0;
+			}
+			unitBuffer = atol(argv[++i]);
+		} else if( arg == "--direct-io" ) {
+			directIO = true;
+		} else if( arg == "--input" ) {
+			if( i + 1 >= argc ) {
+				cerr << "MISSING INPUT FILE NAME" << endl;
 				return 0;
 			}
-			in = &file;
+			if( !OpenInput(argv[++i]) ) {
+				cerr << "CANNOT OPEN " << argv[i] << endl;
+				return 0;
+			}
+		} else if( arg == "--max-statements" || arg == "--max-time" || arg == "--max-character-bytes" || arg == "--max-output-bytes" ) {
+			if( i + 1 >= argc || atof(argv[i+1]) <= 0 ) {
+				cerr << "INVALID BUDGET FOR " << arg << endl;
+				return 0;
+			}
+			Budget budget = arg == "--max-statements" ? BUDGET_STATEMENTS : arg == "--max-time" ? BUDGET_TIME
+				: arg == "--max-character-bytes" ? BUDGET_CHARACTER : BUDGET_OUTPUT;
+			SetBudget(budget, atof(argv[++i]));
+		} else if( arg == "--host" ) {
+			if( i + 1 >= argc || atoi(argv[i+1]) <= 0 ) {
+				cerr << "INVALID THREAD COUNT" << endl;
+				return 0;
+			}
+			hostThreads = atoi(argv[++i]);
+		} else if( arg == "--slice-ms" ) {
+			if( i + 1 >= argc || atof(argv[i+1]) <= 0 ) {
+				cerr << "INVALID TIME SLICE" << endl;
+				return 0;
+			}
+			sliceMs = atof(argv[++i]);
+		} else if( arg == "--checkpoint-every" ) {
+			if( i + 1 >= argc || atoll(argv[i+1]) <= 0 ) {
+				cerr << "INVALID CHECKPOINT INTERVAL" << endl;
+				return 0;
+			}
+			checkpointEvery = atoll(argv[++i]);
+		} else if( arg == "--checkpoint" ) {
+			if( i + 1 >= argc ) {
+				cerr << "MISSING CHECKPOINT FILE NAME" << endl;
+				return 0;
+			}
+			checkpointPath = argv[++i];
+		} else if( arg == "--resume" ) {
+			resume = true;
+		} else if( arg == "--incremental" ) {
+			incremental = true;
+		} else if( arg == "--snapshot-every" ) {
+			if( i + 1 >= argc || atoll(argv[i+1]) <= 0 ) {
+				cerr << "INVALID SNAPSHOT INTERVAL" << endl;
+				return 0;
+			}
+			snapshotEvery = atoll(argv[++i]);
+		} else if( arg == "--optimize" ) {
+			optimize = true;
+		} else {
+			files.push_back(arg);
+		}
+	}
+	SetUnitBuffer(unitBuffer, directIO);
+	//A cached run replays its output and exit status, and nothing else the run would have done
+	if( !cacheDir.empty() ) {
+		const char * other = check ? "--check" : !batchPath.empty() ? "--batch" : hostThreads > 0 ? "--host"
+			: resume ? "--resume" : incremental ? "--incremental" : checkpointEvery > 0 ? "--checkpoint-every"
+			: !tracePath.empty() ? "--trace" : stats ? "--stats" : memReport ? "--mem-report" : nullptr;
+		if( other != nullptr ) {
+			cerr << "CANNOT COMBINE --cache WITH " << other << endl;
+			return 0;
+		}
+	}
+	//Only the program run by main is traced
+	if( !tracePath.empty() && (check || !batchPath.empty() || hostThreads > 0) ) {
+		cerr << "CANNOT COMBINE --trace WITH " << (check ? "--check" : !batchPath.empty() ? "--batch" : "--host") << endl;
+		return 0;
+	}
+	if( check ) {
+		if( files.empty() ) {
+			cerr << "Missing File Name." << endl;
+			return 0;
 		}
+		return CheckFiles(files, threads != 0 ? threads : thread::hardware_concurrency(), cout) > 0 ? 1 : 0;
 	}
-    if(argc == 1) {
+	if( !batchPath.empty() ) {
+		if( files.size() != 1 ) {
+			cerr << (files.empty() ? "Missing File Name." : "ONLY ONE FILE NAME ALLOWED") << endl;
+			return 0;
+		}
+		//The optimizer would reuse an initializer's expression where the variable now holds its binding
+		if( optimize ) {
+			cerr << "CANNOT COMBINE --batch WITH --optimize" << endl;
+			return 0;
+		}
+		return RunBatch(files[0], batchPath, threads != 0 ? threads : thread::hardware_concurrency());
+	}
+	if( hostThreads > 0 ) {
+		//Each program gets a fiber stack as large as a main thread's usual one; pages are only used once touched
+		Scheduler scheduler(hostThreads, sliceMs, 8 << 20);
+		for( const string & name : files ) {
+			scheduler.Submit(name);
+		}
+		int worst = scheduler.Wait();
+		if( stats ) {
+			scheduler.PrintStats(cerr);
+		}
+		return worst;
+	}
+	if( files.size() > 1 ) {
+		cerr << "ONLY ONE FILE NAME ALLOWED" << endl;
+		return 0;
+	}
+    if(files.empty()) {
 		cerr << "Missing File Name." << endl;
 		return 0;
 	}
+	file.open(files[0].c_str());
+	if( file.is_open() == false ) {
+		cerr << "CANNOT OPEN " << files[0] << endl;
+		return 0;
+	}
+	in = &file;
+	if( memReport ) {
+		EnableMemReport();
+		ChargeMemory(MEM_SOURCE, BUFSIZ); //The file stream's buffer
+	}
+	if( incremental && resume ) {
+		cerr << "CANNOT COMBINE --incremental WITH --resume" << endl;
+		return 0;
+	}
+	//The whole source is kept to be diffed by the next run, and the run reads it from memory
+	string source;
+	istringstream sourceStream;
+	string incrementalPath = files[0] + ".inc";
+	string config;
+	if( incremental || !cacheDir.empty() ) {
+		ostringstream text;
+		text << file.rdbuf();
+		source = text.str();
+		sourceStream.str(source);
+		in = &sourceStream;
+		if( memReport ) {
+			ChargeMemory(MEM_SOURCE, source.capacity() + sourceStream.str().capacity()); //The stream holds a copy
+		}
+		//A snapshot or a cached run is only reused by a run with the same options
+		for( int i = 1; i < argc; i++ ) {
+			string arg = argv[i];
+			if( arg == "--cache" || arg == "--cache-size" ) {
+				i++;
+			} else if( find(files.begin(), files.end(), arg) == files.end() ) {
+				config += arg;
+				config += '\0';
+			}
+		}
+	}
+	if( incremental ) {
+		SetIncremental(snapshotEvery);
+	}
+	ResultCache cache(cacheDir, cacheSize);
+	string cacheKey;
+	if( !cacheDir.empty() ) {
+		cacheKey = ResultCache::Key(source, config);
+		string output;
+		int cachedStatus;
+		if( cache.Lookup(cacheKey, output, cachedStatus) ) {
+			cout.write(output.data(), output.size());
+			return cachedStatus;
+		}
+	}
+	if( checkpointPath.empty() ) {
+		checkpointPath = files[0] + ".ckpt";
+	}
+	if( checkpointEvery > 0 || resume ) {
+		SetCheckpoint(checkpointPath, checkpointEvery, HashFile(files[0]));
+	}
+	if( !tracePath.empty() && !OpenTrace(tracePath, traceSize) ) {
+		cerr << "CANNOT OPEN " << tracePath << endl;
+		return 0;
+	}
+	
+	//Everything written to cout from here on goes through the writer thread
+	unique_ptr<AsyncOutput> async;
+	if( asyncOutput ) {
+		async.reset(new AsyncOutput(cout, outputBuffer));
+		if( memReport ) {
+			ChargeMemory(MEM_OUTPUT, async->Capacity());
+		}
+	}
+	unique_ptr<OutputCapture> capture;
+	if( incremental || !cacheDir.empty() ) {
+		capture.reset(new OutputCapture(cout));
+	}
 	
-    bool status = Prog(*in, lineNumber);
+	vector<LexItem> tokens;
+	if( optimize ) {
+		Tokenize(*in, lineNumber, tokens);
+		Optimize(tokens, MaxDepth());
+		if( memReport ) {
+			ChargeMemory(MEM_TOKENS, TokenBytes(tokens));
+		}
+		ReplayTokens(&tokens);
+		lineNumber = 1;
+	}
+	
+    bool status;
+	if( resume ) {
+		long long outputOffset;
+		if( !LoadCheckpoint(*in, lineNumber, outputOffset) ) {
+			cerr << "CANNOT RESUME FROM " << checkpointPath << endl;
+			return 0;
+		}
+		//Output written after the checkpoint by the interrupted run is cut off, so that
+		//a file it went to ends up as an uninterrupted run would have left it
+		struct stat st;
+		if( fstat(STDOUT_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= outputOffset ) {
+			if( ftruncate(STDOUT_FILENO, outputOffset) == 0 ) {
+				lseek(STDOUT_FILENO, outputOffset, SEEK_SET);
+			}
+		}
+		status = ResumeProg(*in, lineNumber);
+	} else if( incremental ) {
+		string output;
+		bool resumed;
+		if( !LoadIncremental(incrementalPath, config, source, *in, lineNumber, output, resumed) ) {
+			cerr << "CANNOT RESUME FROM " << incrementalPath << endl;
+			return 0;
+		}
+		if( resumed ) {
+			cout.write(output.data(), output.size());
+			status = ResumeProg(*in, lineNumber);
+		} else {
+			status = Prog(*in, lineNumber);
+		}
+	} else {
+		status = Prog(*in, lineNumber);
+	}
     
-    if(!status) {
-    	cout << "\nStatus: Unsuccessful Execution " << endl << "Number of Errors: " << ErrCount()  << endl;
+    int exitStatus = Finish(status, cout);
+	if( incremental ) {
+		cout.flush();
+		if( memReport ) {
+			ChargeMemory(MEM_OUTPUT, capture->Text().capacity());
+		}
+		SaveIncremental(incrementalPath, config, source, capture->Text());
+		capture.reset();
+	}
+	//A run that read input, wrote files or may have been cut short by its time budget is not a function of its source
+	if( !cacheDir.empty() ) {
+		cout.flush();
+		if( exitStatus != 3 && !InputUsed() && !UnitsUsed() ) {
+			cache.Store(cacheKey, capture->Text(), exitStatus);
+		}
+		capture.reset();
+	}
+	//Drains the ring and joins the writer on both the successful and the failed path
+	async.reset();
+	if( stats ) {
+		PrintStats(cerr);
+	}
+	if( memReport ) {
+		PrintMemReport(cerr, memTop);
 	}
+	return exitStatus;
 }
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "scheduler.h"
+#include "interpreter.h"
+
+struct Scheduler::Fiber {
+	string path;
+	chrono::steady_clock::time_point submitted;
+	ucontext_t context;
+	char * stack = nullptr; //Lowest address of the mapping, a guard page
+	chrono::steady_clock::time_point sliceStart;
+	chrono::steady_clock::duration used = chrono::steady_clock::duration::zero();
+	bool done = false;
+	int status = 0;
+};
+
+struct Scheduler::Worker {
+	Scheduler * owner;
+	thread t;
+	ucontext_t home; //Where a fiber that yields or ends returns to
+	deque<Fiber *> young;
+	deque<Fiber *> aged;
+	int sinceAged = 0;
+};
+
+//A program that has run this long is aged; the young ones go first
+static const chrono::milliseconds aged_after(20);
+//Young slices in a row before an aged program gets one
+static const int aged_share = 4;
+
+thread_local Scheduler::Worker * Scheduler::current = nullptr;
+thread_local Scheduler::Fiber * Scheduler::running = nullptr;
+
+Scheduler::Scheduler(unsigned threadCount, double sliceMs, size_t stackBytes) : unfinished(0), stopping(false), stackBytes(stackBytes), worstStatus(0) {
+	slice = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(sliceMs));
+	for (unsigned i = 0; i < max(1u, threadCount); i++) {
+		workers.push_back(new Worker);
+		workers.back()->owner = this;
+	}
+	for (Worker * w : workers) {
+		w->t = thread(&Scheduler::WorkerLoop, this, ref(*w));
+	}
+}
+
+Scheduler::~Scheduler() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (Worker * w : workers) {
+		w->t.join();
+		delete w;
+	}
+}
+
+void Scheduler::Submit(const string & path) {
+	Fiber * f = new Fiber;
+	f->path = path;
+	f->submitted = chrono::steady_clock::now();
+	{
+		lock_guard<mutex> guard(lock);
+		pending.push_back(f);
+		unfinished++;
+	}
+	wake.notify_one();
+}
+
+int Scheduler::Wait() {
+	unique_lock<mutex> guard(lock);
+	idle.wait(guard, [&] { return unfinished == 0; });
+	return worstStatus;
+}
+
+//Young programs of our own first, then a program nobody has started, then the aged
+//ones, which also get every aged_share-th slice while there are young programs
+Scheduler::Fiber * Scheduler::Next(Worker & w) {
+	Fiber * f;
+	bool agedTurn = !w.aged.empty() && w.sinceAged >= aged_share;
+	if (!agedTurn && !w.young.empty()) {
+		f = w.young.front();
+		w.young.pop_front();
+		w.sinceAged++;
+		return f;
+	}
+	if (!agedTurn) {
+		unique_lock<mutex> guard(lock);
+		if (w.aged.empty()) {
+			wake.wait(guard, [&] { return !pending.empty() || stopping; });
+		}
+		if (!pending.empty()) {
+			f = pending.front();
+			pending.pop_front();
+			w.sinceAged++;
+			return f;
+		}
+		if (w.aged.empty()) {
+			return nullptr;
+		}
+	}
+	f = w.aged.front();
+	w.aged.pop_front();
+	w.sinceAged = 0;
+	return f;
+}
+
+void Scheduler::Start(Worker & w, Fiber * f) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	void * map = mmap(nullptr, stackBytes + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (map == MAP_FAILED) {
+		cerr << "CANNOT ALLOCATE A STACK FOR " << f->path << endl;
+		f->done = true;
+		f->status = 1;
+		return;
+	}
+	f->stack = static_cast<char *>(map);
+	mprotect(f->stack, page, PROT_NONE); //Overflowing the stack faults instead of corrupting memory
+	getcontext(&f->context);
+	f->context.uc_stack.ss_sp = f->stack + page;
+	f->context.uc_stack.ss_size = stackBytes;
+	f->context.uc_link = &w.home;
+	makecontext(&f->context, &Scheduler::FiberMain, 0);
+}
+
+void Scheduler::Finished(Fiber * f) {
+	if (f->stack != nullptr) {
+		munmap(f->stack, stackBytes + sysconf(_SC_PAGESIZE));
+	}
+	chrono::duration<double, milli> latency = chrono::steady_clock::now() - f->submitted;
+	{
+		lock_guard<mutex> guard(lock);
+		latencies.push_back(latency.count());
+		worstStatus = max(worstStatus, f->status);
+		if (--unfinished == 0) {
+			idle.notify_all();
+		}
+	}
+	delete f;
+}
+
+void Scheduler::WorkerLoop(Worker & w) {
+	current = &w;
+	SetPreemption(&Scheduler::SliceOver, &Scheduler::Yield);
+	Fiber * f;
+	while ((f = Next(w)) != nullptr) {
+		if (f->stack == nullptr) {
+			Start(w, f);
+		}
+		if (!f->done) {
+			running = f;
+			f->sliceStart = chrono::steady_clock::now();
+			swapcontext(&w.home, &f->context);
+			running = nullptr;
+			f->used += chrono::steady_clock::now() - f->sliceStart;
+		}
+		if (f->done) {
+			Finished(f);
+		} else if (f->used < aged_after) {
+			w.young.push_back(f);
+		} else {
+			w.aged.push_back(f);
+		}
+	}
+}
+
+//Runs on the fiber's own stack; returning resumes the worker through uc_link
+void Scheduler::FiberMain() {
+	Fiber * f = running;
+	{
+		ofstream out((f->path + ".out").c_str());
+		ifstream src(f->path.c_str());
+		if (!src.is_open()) {
+			out << "CANNOT OPEN " << f->path << endl;
+			f->status = 1;
+		} else {
+			string input = f->path + ".in";
+			if (access(input.c_str(), R_OK) != 0) {
+				input = "/dev/null";
+			}
+			ProgramContext * context = NewProgram(out, input);
+			try {
+				f->status = RunProgram(context, src);
+			} catch (const char * msg) {
+				out << msg << endl;
+				f->status = 1;
+			}
+			DeleteProgram(context);
+		}
+	}
+	f->done = true;
+}
+
+bool Scheduler::SliceOver() {
+	return chrono::steady_clock::now() - running->sliceStart >= current->owner->slice;
+}
+
+void Scheduler::Yield() {
+	swapcontext(&running->context, &current->home);
+}
+
+void Scheduler::PrintStats(ostream & out) {
+	lock_guard<mutex> guard(lock);
+	if (latencies.empty()) {
+		return;
+	}
+	vector<double> sorted = latencies;
+	sort(sorted.begin(), sorted.end());
+	auto at = [&](double q) { return sorted[min(sorted.size() - 1, (size_t) (q * sorted.size()))]; };
+	out << "Hosted Programs: " << sorted.size() << endl;
+	out << "Completion Latency: p50 " << at(0.5) << " ms, p99 " << at(0.99) << " ms, max " << sorted.back() << " ms" << endl;
+}
@@ -0,0 +1,68 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ostream>
+
+using namespace std;
+
+//Runs many programs in one process, each as a fiber with its own stack, multiplexed
+//over a few threads. A program yields at a statement boundary once its time slice is
+//over. Fibers never move between threads, since the interpreter keeps per-thread
+//state, so a worker only takes programs that have not started yet from the shared
+//queue. Each worker runs its own programs round-robin, those that have used little
+//time first, which keeps short programs fast while long ones are running; every
+//few slices one goes to the longest-running programs so that they are not starved.
+class Scheduler {
+	struct Fiber;
+	struct Worker;
+
+	vector<Worker *> workers;
+	mutex lock;
+	condition_variable wake;
+	condition_variable idle;
+	deque<Fiber *> pending; //Submitted programs that no worker has started
+	size_t unfinished;
+	bool stopping;
+
+	chrono::steady_clock::duration slice;
+	size_t stackBytes;
+
+	vector<double> latencies; //Milliseconds from submission to completion
+	int worstStatus;
+
+	static thread_local Worker * current; //Worker of the calling thread
+	static thread_local Fiber * running; //Fiber the calling thread is running
+
+	Fiber * Next(Worker & w);
+	void Start(Worker & w, Fiber * f);
+	void Finished(Fiber * f);
+	void WorkerLoop(Worker & w);
+	static void FiberMain();
+	static bool SliceOver();
+	static void Yield();
+
+public:
+	Scheduler(unsigned threadCount, double sliceMs, size_t stackBytes);
+	~Scheduler();
+
+	Scheduler(const Scheduler &) = delete;
+	Scheduler & operator=(const Scheduler &) = delete;
+
+	//Queues the program file; its output goes to the file name with .out appended,
+	//and READ takes its input from the file name with .in appended, if it exists
+	void Submit(const string & path);
+
+	//Waits for every submitted program and returns the highest exit status among them
+	int Wait();
+
+	void PrintStats(ostream & out);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+//Large enough for the longest event: kind, line, a name and a CHARACTER value at trace_string_limit
+static const size_t max_event = 3 + 3 * 10 + 2 * trace_string_limit + 1 + 8;
+
+static char * PutString(char * p, const char * s, size_t size) {
+	size = min(size, trace_string_limit);
+	p = PutVarint(p, size);
+	memcpy(p, s, size);
+	return p + size;
+}
+
+//Leaves room for the length, filled in by Finish
+static char * Start(char * event, TraceEvent kind, int line) {
+	event[2] = char(kind);
+	return PutVarint(event + 3, uint64_t(line));
+}
+
+static size_t Finish(char * event, char * end) {
+	size_t size = end - event;
+	event[0] = char(size & 0xff);
+	event[1] = char(size >> 8);
+	return size;
+}
+
+bool Tracer::Open(const string & path, size_t capacity) {
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	size_t size = sizeof(TraceHeader) + capacity;
+	void * map = MAP_FAILED;
+	if (ftruncate(fd, size) == 0) {
+		map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	header = static_cast<TraceHeader *>(map);
+	memcpy(header->magic, trace_magic, sizeof(trace_magic));
+	header->version = trace_version;
+	header->capacity = capacity;
+	header->head = 0;
+	header->tail = 0;
+	ring = static_cast<char *>(map) + sizeof(TraceHeader);
+	this->capacity = capacity;
+	mapped = size;
+	return true;
+}
+
+Tracer::~Tracer() {
+	if (header != nullptr) {
+		munmap(header, mapped);
+	}
+}
+
+void Tracer::Append(const char * event, size_t size) {
+	if (size > capacity) {
+		return;
+	}
+	while (busy.test_and_set(memory_order_acquire));
+	uint64_t head = header->head;
+	uint64_t tail = header->tail;
+	while (head + size - tail > capacity) {
+		size_t at = tail % capacity;
+		tail += uint8_t(ring[at]) | uint8_t(ring[(at + 1) % capacity]) << 8;
+	}
+	size_t at = head % capacity;
+	size_t first = min(size, size_t(capacity - at));
+	memcpy(ring + at, event, first);
+	memcpy(ring, event + first, size - first);
+	//tail first, so that a reader never sees a head past an event that has been overwritten
+	header->tail = tail;
+	header->head = head + size;
+	busy.clear(memory_order_release);
+}
+
+void Tracer::Statement(int line) {
+	char event[16];
+	Append(event, Finish(event, Start(event, TRACE_STATEMENT, line)));
+}
+
+void Tracer::Assign(int line, const string & name, const Value & val) {
+	char event[max_event];
+	char * p = Start(event, TRACE_ASSIGN, line);
+	p = PutString(p, name.data(), name.size());
+	*p++ = char(val.GetType());
+	if (val.IsInt()) {
+		int64_t v = val.GetInt();
+		p = PutVarint(p, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	} else if (val.IsReal()) {
+		double v = val.GetReal();
+		memcpy(p, &v, sizeof(v));
+		p += sizeof(v);
+	} else if (val.IsString()) {
+		p = PutString(p, val.GetStringData(), val.GetStringSize());
+	} else if (val.IsBool()) {
+		*p++ = char(val.GetBool());
+	}
+	Append(event, Finish(event, p));
+}
+
+void Tracer::Branch(int line, bool taken) {
+	char event[16];
+	char * p = Start(event, TRACE_BRANCH, line);
+	*p++ = char(taken);
+	Append(event, Finish(event, p));
+}
+
+void Tracer::Error(int line, const string & msg) {
+	char event[max_event];
+	Append(event, Finish(event, PutString(Start(event, TRACE_ERROR, line), msg.data(), msg.size())));
+}
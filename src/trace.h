@@ -0,0 +1,80 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+#include "val.h"
+
+//Layout of a trace file, shared by the interpreter and tools/tracedump.cpp.
+//The file is a TraceHeader followed by a ring of capacity bytes. Events are appended
+//at head and the oldest whole events dropped at tail to make room, so that the file
+//always holds the most recent events. head and tail count bytes since the run began;
+//an event starts at tail % capacity and may wrap around the end of the ring.
+//
+//An event is its length (2 bytes, little-endian, counting the whole event), its kind
+//(1 byte) and fields written as varints:
+// - TRACE_STATEMENT: line
+// - TRACE_ASSIGN: line, variable name, value
+// - TRACE_BRANCH: line, 1 when the THEN branch is taken and 0 when it is not
+// - TRACE_ERROR: line, message
+//A name or a message is its length and its bytes. A value is its ValType, then a
+//zigzag varint for an INTEGER, 8 bytes for a REAL, a string for a CHARACTER or a byte,
+//0 or 1, for a LOGICAL. An element of a LOGICAL array is named like flags(3).
+//Strings longer than trace_string_limit are cut to it.
+enum TraceEvent : uint8_t { TRACE_STATEMENT, TRACE_ASSIGN, TRACE_BRANCH, TRACE_ERROR };
+
+static const char trace_magic[8] = {'S', 'F', '9', '5', 'T', 'R', 'C', 'E'};
+static const uint32_t trace_version = 1;
+static const size_t trace_string_limit = 1024;
+
+struct TraceHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t capacity;
+	uint64_t head;
+	uint64_t tail;
+};
+
+inline char * PutVarint(char * p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = char(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = char(v);
+	return p;
+}
+
+//Appends events to a memory-mapped trace file. The mapping is shared with the file,
+//so what was written survives the process being killed. Threads of DO CONCURRENT
+//iterations append under a spinlock; their events interleave in the order they ran.
+class Tracer {
+	TraceHeader * header;
+	char * ring;
+	uint64_t capacity;
+	size_t mapped;
+	atomic_flag busy = ATOMIC_FLAG_INIT;
+
+	void Append(const char * event, size_t size);
+
+public:
+	Tracer() : header(nullptr), ring(nullptr), capacity(0), mapped(0) {}
+	~Tracer();
+	Tracer(const Tracer &) = delete;
+	Tracer & operator=(const Tracer &) = delete;
+
+	//Creates or truncates path and maps a ring of capacity bytes
+	bool Open(const string & path, size_t capacity);
+
+	void Statement(int line);
+	void Assign(int line, const string & name, const Value & val);
+	void Branch(int line, bool taken);
+	void Error(int line, const string & msg);
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "unit.h"
+
+static const size_t block_size = 4096; //Alignment of the buffer, and of the offsets and lengths of direct writes
+
+UnitWriter::UnitWriter() : fd(-1), direct(false), buffer(nullptr), capacity(0), used(0), flushed(0) {
+}
+
+UnitWriter::~UnitWriter() {
+	Close();
+}
+
+bool UnitWriter::SetDirect(bool on) {
+#ifdef O_DIRECT
+	int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+#else
+	return !on;
+#endif
+}
+
+bool UnitWriter::Open(const string & name, size_t size, bool useDirect, long long keep) {
+	//Keeping part of the file may mean reading back its last partial block
+	int flags = O_CREAT | O_CLOEXEC | (keep > 0 ? O_RDWR : O_WRONLY | O_TRUNC);
+	direct = false;
+#ifdef O_DIRECT
+	if (useDirect) {
+		fd = open(name.c_str(), flags | O_DIRECT, 0666);
+		direct = fd >= 0;
+	}
+#endif
+	if (fd < 0) {
+		fd = open(name.c_str(), flags, 0666);
+	}
+	if (fd < 0) {
+		return false;
+	}
+	//A device such as /dev/null has no length to cut back to and no tail to read back
+	struct stat st;
+	bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+	capacity = max(block_size, (size + block_size - 1) / block_size * block_size);
+	void * aligned;
+	if ((regular && keep > 0 && ftruncate(fd, keep) != 0) || posix_memalign(&aligned, block_size, capacity) != 0) {
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	buffer = static_cast<char *>(aligned);
+	used = 0;
+	flushed = keep;
+	if (regular && direct && keep % block_size != 0) {
+		used = keep % block_size;
+		flushed = keep - used;
+		if (!SetDirect(false) || pread(fd, buffer, used, flushed) != (ssize_t) used || !SetDirect(true)) {
+			used = 0;
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UnitWriter::WriteOut(const char * data, size_t len, long long offset) {
+	while (len > 0) {
+		ssize_t n = pwrite(fd, data, len, offset);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && errno == EINVAL && direct) { //Blocks larger than block_size: go through the cache from now on
+			direct = false;
+			if (!SetDirect(false)) {
+				return false;
+			}
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+bool UnitWriter::Write(const char * data, size_t len) {
+	while (len > 0) {
+		size_t n = min(len, capacity - used);
+		memcpy(buffer + used, data, n);
+		used += n;
+		data += n;
+		len -= n;
+		if (used == capacity && !Flush()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool UnitWriter::WriteRecord(const char * data, size_t len) {
+	if (len > (size_t) INT32_MAX) {
+		return false;
+	}
+	RecordMarker marker = len;
+	return Write((const char *) &marker, sizeof(marker)) && Write(data, len) && Write((const char *) &marker, sizeof(marker));
+}
+
+bool UnitWriter::Flush() {
+	size_t whole = direct ? used / block_size * block_size : used;
+	if (whole > 0 && !WriteOut(buffer, whole, flushed)) {
+		return false;
+	}
+	size_t rest = used - whole;
+	if (rest > 0) {
+		if (!SetDirect(false) || !WriteOut(buffer + whole, rest, flushed + whole) || !SetDirect(direct)) {
+			return false;
+		}
+		memmove(buffer, buffer + whole, rest);
+	}
+	flushed += whole;
+	used = rest;
+	return true;
+}
+
+bool UnitWriter::Close() {
+	if (fd < 0) {
+		return true;
+	}
+	bool written = Flush();
+	written = close(fd) == 0 && written;
+	fd = -1;
+	free(buffer);
+	buffer = nullptr;
+	return written;
+}
+
+UnitReader::UnitReader() : data(nullptr), size(0), pos(0) {
+}
+
+UnitReader::~UnitReader() {
+	Close();
+}
+
+bool UnitReader::Open(const string & name, long long offset) {
+	int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	bool opened = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset <= st.st_size;
+	if (opened && st.st_size > 0) { //An empty file has nothing to map, and ends at once
+		void * map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		opened = map != MAP_FAILED;
+		if (opened) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			data = static_cast<const char *>(map);
+			size = st.st_size;
+		}
+	}
+	close(fd);
+	pos = offset;
+	return opened;
+}
+
+UnitReader::Status UnitReader::Next(const char * & record, size_t & len) {
+	if (pos == size) {
+		return END;
+	}
+	RecordMarker head, tail;
+	if (size - pos < 2 * sizeof(RecordMarker)) {
+		return BAD;
+	}
+	memcpy(&head, data + pos, sizeof(head));
+	if (head < 0 || size - pos - 2 * sizeof(RecordMarker) < (size_t) head) {
+		return BAD;
+	}
+	memcpy(&tail, data + pos + sizeof(head) + head, sizeof(tail));
+	if (tail != head) {
+		return BAD;
+	}
+	record = data + pos + sizeof(head);
+	len = head;
+	pos += 2 * sizeof(RecordMarker) + head;
+	return RECORD;
+}
+
+void UnitReader::Close() {
+	if (data != nullptr) {
+		munmap(const_cast<char *>(data), size);
+	}
+	data = nullptr;
+	size = pos = 0;
+}
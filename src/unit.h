@@ -0,0 +1,87 @@
+#ifndef UNIT_H_
+#define UNIT_H_
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+//A file connected to a unit by OPEN. WRITE records are gathered in a large buffer
+//aligned to a block and written out a whole buffer at a time at the file's offset,
+//so that a multi-gigabyte file takes a few system calls per hundred megabytes. With
+//direct I/O the file is opened with O_DIRECT where the file system allows it, and
+//whole blocks go from the buffer to the device without passing through the page
+//cache; the last partial block is written through the cache and kept in the buffer,
+//to be written again whole once it fills.
+class UnitWriter {
+	int fd;
+	bool direct;
+	char * buffer;
+	size_t capacity;
+	size_t used;
+	long long flushed; //Bytes of the file before the buffer, a whole number of blocks with direct I/O
+
+	bool SetDirect(bool on);
+	bool WriteOut(const char * data, size_t len, long long offset);
+
+public:
+	UnitWriter();
+	~UnitWriter();
+
+	UnitWriter(const UnitWriter &) = delete;
+	UnitWriter & operator=(const UnitWriter &) = delete;
+
+	//Creates or empties the file, or with keep, keeps its first keep bytes and continues after them.
+	//The buffer is capacity bytes, rounded up to a whole number of blocks.
+	bool Open(const string & name, size_t capacity, bool useDirect, long long keep = 0);
+
+	bool Write(const char * data, size_t len);
+
+	//Writes an unformatted record: its length as a RecordMarker, the bytes, and the length again
+	bool WriteRecord(const char * data, size_t len);
+
+	//Writes what the buffer holds, so that the file has every byte written to the unit
+	bool Flush();
+
+	//Flushes and closes the file; false when some of it could not be written
+	bool Close();
+
+	long long Offset() const { return flushed + used; }
+	size_t Capacity() const { return capacity; }
+};
+
+//Length of an unformatted record, written before and after its bytes in the machine's
+//byte order, so that the file can be read forwards or backwards as Fortran's sequential
+//unformatted files are
+typedef int32_t RecordMarker;
+
+//A file connected to a unit by OPEN with ACTION='READ' and FORM='UNFORMATTED'. The file
+//is mapped into memory whole, and READ copies the values out of a record where it lies.
+class UnitReader {
+	const char * data;
+	size_t size;
+	size_t pos;
+
+public:
+	enum Status { RECORD, END, BAD };
+
+	UnitReader();
+	~UnitReader();
+
+	UnitReader(const UnitReader &) = delete;
+	UnitReader & operator=(const UnitReader &) = delete;
+
+	//Maps a regular file, to be read from offset on
+	bool Open(const string & name, long long offset = 0);
+
+	//The next record, valid until the reader is closed; BAD when its markers do not agree
+	//or it runs past the end of the file
+	Status Next(const char * & record, size_t & len);
+
+	void Close();
+
+	long long Offset() const { return pos; }
+};
+
+#endif
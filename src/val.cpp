@@ -1,62 +1,73 @@
 #include "val.h"
 
-Value Value::operator+(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp + op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp + op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp + op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp + op.Rtemp);
-    } else {
-        return Value();
-    }
-}
+#include <charconv>
+#include <cfloat>
 
-Value Value::operator-(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp - op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp - op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp - op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp - op.Rtemp);
-    } else {
-        return Value();
-    }
-}
+#include <utility>
 
-Value Value::operator*(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp * op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp * op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp * op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp * op.Rtemp);
-    } else {
-        return Value();
-    }
-}
+//Generates the binary operator table. An operator is defined by the types it takes and
+//one C++ expression over the operands' native values, whose type gives the result type:
+//INTEGER op INTEGER stays INTEGER, a REAL operand makes it REAL, comparisons give a
+//bool. A new type needs an entry in Native and in the traits below.
+struct Operations {
+	template <ValType V> static decltype(auto) Native(const Value & v) {
+		if constexpr (V == VINT) {
+			return v.Itemp;
+		} else if constexpr (V == VREAL) {
+			return v.Rtemp;
+		} else if constexpr (V == VSTRING) {
+			return (v.Stemp); //By reference
+		} else {
+			return v.Btemp;
+		}
+	}
 
-Value Value::operator/(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp / op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp / op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp / op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp / op.Rtemp);
-    } else {
-        return Value();
-    }
-}
+	static constexpr bool Numeric(ValType v) {
+		return v == VINT || v == VREAL;
+	}
 
+	static constexpr bool Takes(BinaryOp o, ValType l, ValType r) {
+		if (o == OP_EQ) {
+			return (Numeric(l) && Numeric(r)) || (l == VSTRING && r == VSTRING);
+		}
+		return Numeric(l) && Numeric(r);
+	}
 
+	template <BinaryOp O, class L, class R> static Value Compute(const L & a, const R & b) {
+		if constexpr (O == OP_ADD) {
+			return Value(a + b);
+		} else if constexpr (O == OP_SUB) {
+			return Value(a - b);
+		} else if constexpr (O == OP_MUL) {
+			return Value(a * b);
+		} else if constexpr (O == OP_DIV) {
+			return Value(a / b);
+		} else if constexpr (O == OP_POW) {
+			return Value(pow(a, b));
+		} else if constexpr (O == OP_EQ) {
+			return Value(a == b);
+		} else if constexpr (O == OP_LT) {
+			return Value(a < b);
+		} else {
+			return Value(a > b);
+		}
+	}
+
+	template <BinaryOp O, ValType L, ValType R> static Value Entry(const Value & a, const Value & b) {
+		if constexpr (Takes(O, L, R)) {
+			return Compute<O>(Native<L>(a), Native<R>(b));
+		} else {
+			return Value();
+		}
+	}
+
+	template <size_t... I> static constexpr array<Value::BinaryFn, sizeof...(I)> Table(index_sequence<I...>) {
+		return {{ &Entry<BinaryOp(I / (VTYPE_COUNT * VTYPE_COUNT)), ValType(I / VTYPE_COUNT % VTYPE_COUNT), ValType(I % VTYPE_COUNT)>... }};
+	}
+};
+
+const array<Value::BinaryFn, OP_COUNT * VTYPE_COUNT * VTYPE_COUNT> Value::binary_ops =
+	Operations::Table(make_index_sequence<OP_COUNT * VTYPE_COUNT * VTYPE_COUNT>());
 
 Value Value::Catenate(const Value& op) const {
     if (IsString() && op.IsString()) {
@@ -67,60 +78,46 @@ Value Value::Catenate(const Value& op) const {
     }
 }
 
-Value Value::Power(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(pow(Itemp, op.Itemp));
-    } else if (IsInt() && op.IsReal()) {
-        return Value(pow(Itemp, op.Rtemp));
-    } else if (IsReal() && op.IsInt()) {
-        return Value(pow(Rtemp, op.Itemp));
-    } else if (IsReal() && op.IsReal()) {
-        return Value(pow(Rtemp, op.Rtemp));
-    } else {
-        return Value();
+void Value::Append(const Value& op, size_t limit) {
+    if (!IsString() || !op.IsString()) {
+        *this = Value();
+        return;
     }
-}
-
-Value Value::operator==(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp == op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp == op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp == op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp == op.Rtemp);
-    } else if (IsString() && op.IsString()) {
-        return Value(Stemp == op.Stemp);
-    } else {
-        return Value();
+    if (Stemp.length() < limit) {
+        if (limit != string::npos && Stemp.capacity() < limit) {
+            Stemp.reserve(limit);
+        }
+        Stemp.append(op.Stemp, 0, limit - Stemp.length());
     }
 }
 
-Value Value::operator>(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp > op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp > op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp > op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp > op.Rtemp);
-    } else {
-        return Value();
-    }
+void Value::FitString(int len) {
+    Stemp.resize(len, ' ');
+    strLen = len;
 }
 
-Value Value::operator<(const Value& op) const {
-    if (IsInt() && op.IsInt()) {
-        return Value(Itemp < op.Itemp);
-    } else if (IsInt() && op.IsReal()) {
-        return Value(Itemp < op.Rtemp);
-    } else if (IsReal() && op.IsInt()) {
-        return Value(Rtemp < op.Itemp);
-    } else if (IsReal() && op.IsReal()) {
-        return Value(Rtemp < op.Rtemp);
-    } else {
-        return Value();
+void Value::AppendTo(string & line) const {
+    char buf[DBL_MAX_10_EXP + 8]; //Every digit of the largest double, the sign, the point and two decimals
+    to_chars_result res;
+    switch (T) {
+        case VINT:
+            res = to_chars(buf, buf + sizeof(buf), Itemp);
+            line.append(buf, res.ptr);
+            break;
+        case VREAL:
+            res = to_chars(buf, buf + sizeof(buf), Rtemp, chars_format::fixed, 2);
+            line.append(buf, res.ptr);
+            break;
+        case VSTRING:
+            line += Stemp;
+            break;
+        case VBOOL:
+            line += Btemp ? 'T' : 'F';
+            break;
+        case VERR:
+            line += "ERROR";
+            break;
+        default:
+            break;
     }
-}
\ No newline at end of file
+}
@@ -9,10 +9,15 @@
 #include <stdexcept>
 #include <cmath>
 #include <sstream>
+#include <array>
 
 using namespace std;
 
 enum ValType { VINT, VREAL, VSTRING, VBOOL, VERR };
+const int VTYPE_COUNT = VERR + 1;
+
+//Binary operators, each defined for every pair of operand types by one table in val.cpp
+enum BinaryOp { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_EQ, OP_LT, OP_GT, OP_COUNT };
 
 class Value {
     ValType	T;
@@ -21,7 +26,13 @@ class Value {
 	double   Rtemp;
     string	Stemp;
     int strLen;
-    
+
+    //Indexed by operator, then left and right operand type; pairs an operator does not take give an error value
+    typedef Value (*BinaryFn)(const Value &, const Value &);
+    static const array<BinaryFn, OP_COUNT * VTYPE_COUNT * VTYPE_COUNT> binary_ops;
+    friend struct Operations;
+
+    Value Apply(BinaryOp o, const Value & op) const { return binary_ops[(o * VTYPE_COUNT + T) * VTYPE_COUNT + op.T](*this, op); }
        
 public:
     Value() : T(VERR), Btemp(false), Itemp(0), Rtemp(0.0), Stemp(""), strLen(0) {}
@@ -46,6 +57,10 @@ public:
     
     bool GetBool() const {if(IsBool()) return Btemp; throw "RUNTIME ERROR: Value not a boolean";}
     
+    size_t GetStringSize() const { return Stemp.size(); } //Characters held, without copying them
+    const char * GetStringData() const { return Stemp.data(); }
+    size_t GetStringCapacity() const { return Stemp.capacity(); } //Characters the storage can hold before it grows
+    
     int GetstrLen() const { if( IsString() ) return strLen; throw "RUNTIME ERROR: Value not a string";}
     
     void SetType(ValType type)
@@ -80,37 +95,44 @@ public:
 	
 	
     // numeric overloaded add this to op
-    Value operator+(const Value& op) const;
+    Value operator+(const Value& op) const { return Apply(OP_ADD, op); }
     
     // numeric overloaded subtract op from this
-    Value operator-(const Value& op) const;
+    Value operator-(const Value& op) const { return Apply(OP_SUB, op); }
     
     // numeric overloaded multiply this by op
-    Value operator*(const Value& op) const;
+    Value operator*(const Value& op) const { return Apply(OP_MUL, op); }
     
     // numeric overloaded divide this by oper
-    Value operator/(const Value& op) const;
+    Value operator/(const Value& op) const { return Apply(OP_DIV, op); }
     
     //string concatenation of this with op
     Value Catenate(const Value & op) const;
     
+    //appends op to this string in place, keeping at most limit characters
+    void Append(const Value & op, size_t limit);
+    
+    //pads with blanks or truncates this string to len characters, as a CHARACTER(LEN=len) variable holds it
+    void FitString(int len);
+    
     //compute the value of this raised to the exponent op
-    Value Power(const Value & op) const;
+    Value Power(const Value & op) const { return Apply(OP_POW, op); }
     
     //overloaded equality operator of this with op
-    Value operator==(const Value& op) const;
+    Value operator==(const Value& op) const { return Apply(OP_EQ, op); }
 	//overloaded greater than operator of this with op
-	Value operator>(const Value& op) const;
+	Value operator>(const Value& op) const { return Apply(OP_GT, op); }
 	//overloaded less than operator of this with op
-	Value operator<(const Value& op) const;
+	Value operator<(const Value& op) const { return Apply(OP_LT, op); }
+	
 	
+    //appends the text PRINT shows for this value to line: reals have two decimals, booleans are T or F
+    void AppendTo(string & line) const;
 	
     friend ostream& operator<<(ostream& out, const Value& op) {
-        if( op.IsInt() ) out << op.Itemp;
-		else if( op.IsString() ) out << op.Stemp ;
-        else if( op.IsReal()) out << fixed << showpoint << setprecision(2) << op.Rtemp;
-        else if(op.IsErr()) out << "ERROR";
-        return out;
+        string text;
+        op.AppendTo(text);
+        return out << text;
     }
 };
 
@@ -0,0 +1,527 @@
+//Synthetic SFort95 workload generator.
+//
+//Emits a valid program from a seed together with the output the interpreter must
+//produce for it, so the pair can drive both correctness and throughput runs. The
+//generator evaluates every statement as it writes it, mirroring the interpreter's
+//rules: left-to-right evaluation, the declared type of the assigned variable
+//applying to the leftmost constant of an expression, CHARACTER padding and
+//truncation, and REAL output with two decimals. Expressions that would overflow an
+//INTEGER or divide by zero are never emitted.
+//
+//IF blocks are only nested inside the branch that is taken, because branches that
+//are not taken are skipped token by token up to the first ELSE or END.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+struct Options {
+	unsigned long long seed = 1;
+	int statements = 100;
+	int variables = 10;
+	int exprDepth = 3;
+	int charLen = 16;
+	int catChain = 3;
+	int ifDepth = 2;
+	double taken = 0.5;
+	double printDensity = 0.2;
+	string out;
+};
+
+enum GenType { GINT, GREAL, GSTRING };
+
+struct GenValue {
+	GenType type;
+	long long i;
+	double r;
+	string s;
+	bool ok; //False once an intermediate result leaves the safe range
+
+	GenValue() : type(GINT), i(0), r(0), ok(true) {}
+	static GenValue Int(long long v) { GenValue g; g.type = GINT; g.i = v; return g; }
+	static GenValue Real(double v) { GenValue g; g.type = GREAL; g.r = v; return g; }
+	static GenValue Str(const string & v) { GenValue g; g.type = GSTRING; g.s = v; return g; }
+	double Num() const { return type == GINT ? (double) i : r; }
+};
+
+//What the interpreter seeds the leftmost operand of an expression with
+struct Seed {
+	bool set;
+	GenType type;
+	int strLen;
+};
+
+struct Variable {
+	string name;
+	GenType type;
+	int len; //Declared LEN of a CHARACTER variable
+	GenValue value;
+};
+
+static const long long INT_LIMIT = 1000000;
+static const double REAL_LIMIT = 1e6;
+
+class Generator {
+	Options opt;
+	mt19937_64 rng;
+	vector<Variable> vars;
+	size_t visible; //Variables declared so far
+	ostringstream program;
+	ostringstream expected;
+	int emitted;
+
+	unsigned long long Next() { return rng(); }
+	int Range(int lo, int hi) { return lo + (int) (Next() % (unsigned long long) (hi - lo + 1)); }
+	bool Chance(double p) { return (Next() >> 11) * (1.0 / 9007199254740992.0) < p; }
+
+	vector<int> VarsOf(GenType type) {
+		vector<int> found;
+		for (size_t i = 0; i < visible; i++) {
+			if (vars[i].type == type) {
+				found.push_back(i);
+			}
+		}
+		return found;
+	}
+
+	static bool Safe(const GenValue & v) {
+		if (!v.ok) {
+			return false;
+		}
+		if (v.type == GINT) {
+			return v.i > -INT_LIMIT && v.i < INT_LIMIT;
+		}
+		if (v.type == GREAL) {
+			return isfinite(v.r) && fabs(v.r) < REAL_LIMIT;
+		}
+		return true;
+	}
+
+	static GenValue Arith(const GenValue & a, char op, const GenValue & b) {
+		GenValue res;
+		if (a.type == GINT && b.type == GINT) {
+			long long v = 0;
+			switch (op) {
+				case '+': v = a.i + b.i; break;
+				case '-': v = a.i - b.i; break;
+				case '*': v = a.i * b.i; break;
+				case '/': v = a.i / b.i; break;
+			}
+			res = GenValue::Int(v);
+		} else {
+			double x = a.Num(), y = b.Num(), v = 0;
+			switch (op) {
+				case '+': v = x + y; break;
+				case '-': v = x - y; break;
+				case '*': v = x * y; break;
+				case '/': v = x / y; break;
+			}
+			res = GenValue::Real(v);
+		}
+		res.ok = a.ok && b.ok;
+		res.ok = Safe(res);
+		return res;
+	}
+
+	static string Fit(string s, int len) {
+		if ((int) s.length() > len) {
+			return s.substr(0, len);
+		}
+		s.append(len - s.length(), ' ');
+		return s;
+	}
+
+	string IntLiteral(long long & value) {
+		value = Range(0, 20);
+		return to_string(value);
+	}
+
+	string RealLiteral(double & value) {
+		string text = to_string(Range(0, 20)) + "." + to_string(Range(0, 9)) + to_string(Range(1, 9));
+		value = stod(text);
+		return text;
+	}
+
+	string StringLiteral() {
+		static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+		string s;
+		int len = Range(1, max(1, opt.charLen));
+		for (int i = 0; i < len; i++) {
+			s += chars[Next() % (sizeof(chars) - 1)];
+		}
+		return s;
+	}
+
+	//Factor ::= IDENT | ICONST | RCONST | (Expr), with the sign of SFactor applied.
+	//The interpreter ignores a sign in front of a parenthesized expression, so none is emitted.
+	string Factor(GenType type, int depth, Seed seed, int sign, GenValue & val) {
+		int choice = Range(0, 9);
+		vector<int> ints = VarsOf(GINT), reals = VarsOf(GREAL);
+		if (choice < 2 && depth > 0 && sign > 0) {
+			return "(" + Expr(type, depth - 1, seed, val) + ")";
+		}
+		if (choice < 6) {
+			vector<int> pool = ints;
+			if (type == GREAL) {
+				pool.insert(pool.end(), reals.begin(), reals.end());
+			}
+			if (!pool.empty()) {
+				Variable & v = vars[pool[Next() % pool.size()]];
+				val = Arith(v.value, '*', GenValue::Int(sign));
+				return v.name;
+			}
+		}
+		if (type == GREAL && Chance(0.5)) {
+			double r;
+			string text = RealLiteral(r);
+			val = GenValue::Real(r * sign);
+			return text;
+		}
+		long long i;
+		string text = IntLiteral(i);
+		if (seed.set && seed.type == GREAL) {
+			val = GenValue::Real(stod(text) * sign);
+		} else {
+			val = GenValue::Int(i * sign);
+		}
+		return text;
+	}
+
+	//SFactor ::= [-] Factor
+	string SFactor(GenType type, int depth, Seed seed, GenValue & val) {
+		int sign = Chance(0.15) ? -1 : 1;
+		string text = Factor(type, depth, seed, sign, val);
+		return sign < 0 ? "-" + text : text;
+	}
+
+	//TermExpr ::= SFactor [** 2], REAL expressions only
+	string TermExpr(GenType type, int depth, Seed seed, GenValue & val) {
+		string text = SFactor(type, depth, seed, val);
+		if (type == GREAL && Chance(0.1)) {
+			GenValue res = GenValue::Real(pow(val.Num(), 2.0));
+			res.ok = val.ok;
+			res.ok = Safe(res);
+			val = res;
+			text += " ** 2";
+		}
+		return text;
+	}
+
+	//MultExpr ::= TermExpr {(* | /) TermExpr}; divisors are non-zero constants
+	string MultExpr(GenType type, int depth, Seed seed, GenValue & val) {
+		string text = TermExpr(type, depth, seed, val);
+		Seed none = {false, GINT, 0};
+		while (Chance(0.3)) {
+			if (Chance(0.5)) {
+				GenValue rhs;
+				text += " * " + TermExpr(type, depth, none, rhs);
+				val = Arith(val, '*', rhs);
+			} else if (type == GREAL && Chance(0.5)) {
+				double r;
+				string lit = RealLiteral(r);
+				if (r == 0) {
+					continue;
+				}
+				text += " / " + lit;
+				val = Arith(val, '/', GenValue::Real(r));
+			} else {
+				long long d = Range(1, 9);
+				text += " / " + to_string(d);
+				val = Arith(val, '/', GenValue::Int(d));
+			}
+		}
+		return text;
+	}
+
+	//Expr ::= MultExpr {(+ | -) MultExpr}
+	string Expr(GenType type, int depth, Seed seed, GenValue & val) {
+		string text = MultExpr(type, depth, seed, val);
+		Seed none = {false, GINT, 0};
+		while (Chance(0.4)) {
+			GenValue rhs;
+			char op = Chance(0.5) ? '+' : '-';
+			text += string(" ") + op + " " + MultExpr(type, depth, none, rhs);
+			val = Arith(val, op, rhs);
+		}
+		return text;
+	}
+
+	//A numeric expression that stays in range, or a plain constant after a few tries
+	string SafeExpr(GenType type, Seed seed, GenValue & val) {
+		for (int attempt = 0; attempt < 8; attempt++) {
+			mt19937_64 saved = rng;
+			string text = Expr(type, opt.exprDepth, seed, val);
+			if (Safe(val)) {
+				return text;
+			}
+			rng = saved;
+			rng.discard(attempt + 1);
+		}
+		long long i;
+		string text = IntLiteral(i);
+		val = (seed.set && seed.type == GREAL) ? GenValue::Real(stod(text)) : GenValue::Int(i);
+		return text;
+	}
+
+	//Operand {// Operand} for a CHARACTER variable of length len, or a PRINT item when len is 0
+	string CatExpr(int len, GenValue & val) {
+		vector<int> strs = VarsOf(GSTRING);
+		int operands = Range(1, max(1, opt.catChain));
+		string text;
+		for (int k = 0; k < operands; k++) {
+			string piece;
+			if (!strs.empty() && Chance(0.5)) {
+				Variable & v = vars[strs[Next() % strs.size()]];
+				text += (k ? " // " : "") + v.name;
+				piece = v.value.s;
+			} else {
+				string lit = StringLiteral();
+				text += (k ? " // \"" : "\"") + lit + "\"";
+				piece = (k == 0 && len > 0) ? Fit(lit, len) : lit;
+			}
+			val.s = k ? val.s + piece : piece;
+		}
+		val.type = GSTRING;
+		val.ok = true;
+		if (len > 0) {
+			val.s = Fit(val.s, len);
+		}
+		return text;
+	}
+
+	static string Format(const GenValue & v) {
+		ostringstream out;
+		if (v.type == GINT) {
+			out << v.i;
+		} else if (v.type == GREAL) {
+			out << fixed << showpoint << setprecision(2) << v.r;
+		} else {
+			out << v.s;
+		}
+		return out.str();
+	}
+
+	void Indent(int level) {
+		for (int i = 0; i < level + 1; i++) {
+			program << '\t';
+		}
+	}
+
+	void Assign(int level, bool live) {
+		Variable & v = vars[Next() % vars.size()];
+		GenValue val;
+		string text;
+		if (v.type == GSTRING) {
+			text = CatExpr(v.len, val);
+		} else {
+			//Assignments seed the expression with the variable's current value, not its declared type
+			Seed seed = {true, v.value.type, 0};
+			text = SafeExpr(v.type, seed, val);
+		}
+		Indent(level);
+		program << v.name << " = " << text << "\n";
+		if (live) {
+			v.value = val;
+		}
+	}
+
+	void Print(int level, bool live) {
+		int items = Range(1, 4);
+		string line;
+		Indent(level);
+		program << "PRINT *, ";
+		for (int k = 0; k < items; k++) {
+			GenValue val;
+			int kind = Range(0, 3);
+			if (k) {
+				program << ", ";
+			}
+			if (kind == 0) {
+				string lit = StringLiteral();
+				program << "\"" << lit << "\"";
+				val = GenValue::Str(lit);
+			} else if (kind == 1) {
+				Variable & v = vars[Next() % vars.size()];
+				program << v.name;
+				val = v.value;
+			} else if (kind == 2) {
+				Seed none = {false, GINT, 0};
+				program << SafeExpr(Chance(0.5) ? GREAL : GINT, none, val);
+			} else {
+				program << CatExpr(0, val);
+			}
+			line += Format(val);
+		}
+		program << "\n";
+		if (live) {
+			expected << line << "\n";
+		}
+	}
+
+	//A relational condition that evaluates to want
+	string Condition(bool want) {
+		Seed none = {false, GINT, 0};
+		GenValue a, b;
+		string left = SafeExpr(Chance(0.5) ? GREAL : GINT, none, a);
+		string right = SafeExpr(Chance(0.5) ? GREAL : GINT, none, b);
+		double x = a.Num(), y = b.Num();
+		string op;
+		if (want) {
+			op = x < y ? "<" : x > y ? ">" : "==";
+		} else {
+			op = x < y ? (Chance(0.5) ? ">" : "==") : x > y ? (Chance(0.5) ? "<" : "==") : (Chance(0.5) ? "<" : ">");
+		}
+		return left + " " + op + " " + right;
+	}
+
+	void Simple(int level, bool live) {
+		if (Chance(opt.printDensity)) {
+			Print(level, live);
+		} else {
+			Assign(level, live);
+		}
+		emitted++;
+	}
+
+	void Block(int level, int count, bool live) {
+		for (int k = 0; k < count && emitted < opt.statements; k++) {
+			if (live && level < opt.ifDepth && Chance(0.15)) {
+				If(level);
+			} else {
+				Simple(level, live);
+			}
+		}
+	}
+
+	void If(int level) {
+		bool taken = Chance(opt.taken);
+		bool hasElse = Chance(0.5);
+		Indent(level);
+		program << "IF (" << Condition(taken) << ") THEN\n";
+		emitted++;
+		int size = Range(1, 4);
+		Block(level + 1, size, taken);
+		if (hasElse) {
+			Indent(level);
+			program << "ELSE\n";
+			Block(level + 1, size, !taken);
+		}
+		Indent(level);
+		program << "END IF\n";
+	}
+
+	void Declare() {
+		static const char * typeNames[] = { "INTEGER", "REAL", "CHARACTER" };
+		int count = max(1, opt.variables);
+		for (int i = 0; i < count; i++) {
+			Variable v;
+			int pick = Range(0, 9);
+			v.type = pick < 4 ? GINT : pick < 8 ? GREAL : GSTRING;
+			v.name = string(v.type == GINT ? "iv" : v.type == GREAL ? "rv" : "sv") + to_string(i + 1);
+			v.len = v.type == GSTRING ? Range(1, max(1, opt.charLen)) : 0;
+			vars.push_back(v);
+		}
+		//One declaration per variable keeps initializers seeded with the right type and length
+		for (visible = 0; visible < vars.size(); visible++) {
+			Variable & v = vars[visible];
+			Indent(0);
+			program << typeNames[v.type];
+			if (v.type == GSTRING) {
+				program << " (LEN = " << v.len << ")";
+			}
+			program << " :: " << v.name << " = ";
+			GenValue val;
+			if (v.type == GSTRING) {
+				program << CatExpr(v.len, val);
+			} else {
+				Seed seed = {true, v.type, 0};
+				program << SafeExpr(v.type, seed, val);
+			}
+			program << "\n";
+			v.value = val;
+		}
+	}
+
+public:
+	explicit Generator(const Options & o) : opt(o), rng(o.seed), visible(0), emitted(0) {}
+
+	void Generate() {
+		program << "PROGRAM gen\n";
+		program << "\t!Generated by tools/gen --seed " << opt.seed << " --statements " << opt.statements
+			<< " --variables " << opt.variables << " --expr-depth " << opt.exprDepth << " --char-len " << opt.charLen
+			<< " --cat-chain " << opt.catChain << " --if-depth " << opt.ifDepth << " --taken " << opt.taken
+			<< " --print-density " << opt.printDensity << "\n";
+		Declare();
+		while (emitted < opt.statements) {
+			Block(0, opt.statements - emitted, true);
+		}
+		program << "END PROGRAM gen\n";
+	}
+
+	string Program() const { return program.str(); }
+	string Expected() const { return expected.str(); }
+};
+
+static void Usage() {
+	cerr << "Usage: gen [--seed N] [--statements N] [--variables N] [--expr-depth N] [--char-len N]" << endl
+		<< "           [--cat-chain N] [--if-depth N] [--taken RATIO] [--print-density RATIO] [--out FILE]" << endl;
+}
+
+int main(int argc, char * argv[]) {
+	Options opt;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (i + 1 >= argc) {
+			Usage();
+			return 2;
+		}
+		string value = argv[++i];
+		if (arg == "--seed") {
+			opt.seed = strtoull(value.c_str(), NULL, 10);
+		} else if (arg == "--statements") {
+			opt.statements = atoi(value.c_str());
+		} else if (arg == "--variables") {
+			opt.variables = atoi(value.c_str());
+		} else if (arg == "--expr-depth") {
+			opt.exprDepth = atoi(value.c_str());
+		} else if (arg == "--char-len") {
+			opt.charLen = atoi(value.c_str());
+		} else if (arg == "--cat-chain") {
+			opt.catChain = atoi(value.c_str());
+		} else if (arg == "--if-depth") {
+			opt.ifDepth = atoi(value.c_str());
+		} else if (arg == "--taken") {
+			opt.taken = atof(value.c_str());
+		} else if (arg == "--print-density") {
+			opt.printDensity = atof(value.c_str());
+		} else if (arg == "--out") {
+			opt.out = value;
+		} else {
+			Usage();
+			return 2;
+		}
+	}
+
+	Generator gen(opt);
+	gen.Generate();
+	if (opt.out.empty()) {
+		cout << gen.Program();
+		return 0;
+	}
+	ofstream program(opt.out.c_str()), expected((opt.out + ".correct").c_str());
+	if (!program.is_open() || !expected.is_open()) {
+		cerr << "CANNOT OPEN " << opt.out << endl;
+		return 1;
+	}
+	program << gen.Program();
+	expected << gen.Expected();
+	return 0;
+}
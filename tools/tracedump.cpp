@@ -0,0 +1,229 @@
+//Decoder for the execution traces written by --trace.
+//
+//Prints the events a trace file holds, oldest first, one per line, or as a JSON
+//document with --json. When the ring has wrapped, the events dropped to make room
+//are counted in bytes at the top of the output. The file layout is described in
+//src/trace.h.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+
+using namespace std;
+
+#include "../src/trace.h"
+
+struct Event {
+	TraceEvent kind;
+	uint64_t line;
+	string name; //Variable of an assignment
+	string text; //Value of an assignment, message of an error
+	string type;
+	bool quoted = false; //The value is not a JSON number
+	bool taken = false;
+};
+
+class Cursor {
+	const string & ring;
+	uint64_t at;
+
+public:
+	Cursor(const string & ring, uint64_t at) : ring(ring), at(at) {}
+
+	uint8_t Byte() {
+		return uint8_t(ring[at++ % ring.size()]);
+	}
+
+	uint64_t Varint() {
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			uint8_t b = Byte();
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) {
+				break;
+			}
+		}
+		return v;
+	}
+
+	string Str() {
+		uint64_t size = Varint();
+		string s;
+		for (uint64_t i = 0; i < size && i < trace_string_limit; i++) {
+			s += char(Byte());
+		}
+		return s;
+	}
+
+	double F64() {
+		char bytes[8];
+		for (char & b : bytes) {
+			b = char(Byte());
+		}
+		double v;
+		memcpy(&v, bytes, sizeof(v));
+		return v;
+	}
+};
+
+static bool Decode(Cursor & c, Event & e) {
+	e.kind = TraceEvent(c.Byte());
+	e.line = c.Varint();
+	switch (e.kind) {
+		case TRACE_STATEMENT:
+			return true;
+		case TRACE_ASSIGN: {
+			e.name = c.Str();
+			ValType type = ValType(c.Byte());
+			if (type == VINT) {
+				uint64_t v = c.Varint();
+				e.type = "INTEGER";
+				e.text = to_string(int64_t(v >> 1) ^ -int64_t(v & 1));
+			} else if (type == VREAL) {
+				double v = c.F64();
+				ostringstream text;
+				text << setprecision(17) << v;
+				e.type = "REAL";
+				e.text = text.str();
+				e.quoted = !isfinite(v);
+			} else if (type == VSTRING) {
+				e.type = "CHARACTER";
+				e.text = c.Str();
+				e.quoted = true;
+			} else if (type == VBOOL) {
+				e.type = "LOGICAL";
+				e.text = c.Byte() != 0 ? "true" : "false";
+			} else {
+				return false;
+			}
+			return true;
+		}
+		case TRACE_BRANCH:
+			e.taken = c.Byte() != 0;
+			return true;
+		case TRACE_ERROR:
+			e.text = c.Str();
+			return true;
+	}
+	return false;
+}
+
+static string Json(const string & s) {
+	string out = "\"";
+	for (unsigned char ch : s) {
+		if (ch == '"' || ch == '\\') {
+			out += '\\';
+			out += char(ch);
+		} else if (ch < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+			out += escaped;
+		} else {
+			out += char(ch);
+		}
+	}
+	return out + "\"";
+}
+
+static void PrintText(const Event & e) {
+	cout << e.line << ": ";
+	switch (e.kind) {
+		case TRACE_STATEMENT:
+			cout << "statement";
+			break;
+		case TRACE_ASSIGN:
+			cout << e.name << " = " << (e.quoted ? "\"" + e.text + "\"" : e.text) << " (" << e.type << ")";
+			break;
+		case TRACE_BRANCH:
+			cout << "IF " << (e.taken ? "taken" : "not taken");
+			break;
+		case TRACE_ERROR:
+			cout << "error: " << e.text;
+			break;
+	}
+	cout << "\n";
+}
+
+static void PrintJson(const Event & e) {
+	static const char * const kinds[] = {"statement", "assign", "branch", "error"};
+	cout << "{\"event\": \"" << kinds[e.kind] << "\", \"line\": " << e.line;
+	if (e.kind == TRACE_ASSIGN) {
+		cout << ", \"variable\": " << Json(e.name) << ", \"type\": \"" << e.type << "\", \"value\": ";
+		cout << (e.quoted ? Json(e.text) : e.text);
+	} else if (e.kind == TRACE_BRANCH) {
+		cout << ", \"taken\": " << (e.taken ? "true" : "false");
+	} else if (e.kind == TRACE_ERROR) {
+		cout << ", \"message\": " << Json(e.text);
+	}
+	cout << "}";
+}
+
+int main(int argc, char *argv[]) {
+	bool json = false;
+	string path;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--json") {
+			json = true;
+		} else if (path.empty()) {
+			path = arg;
+		} else {
+			cerr << "usage: tracedump [--json] FILE" << endl;
+			return 2;
+		}
+	}
+	if (path.empty()) {
+		cerr << "usage: tracedump [--json] FILE" << endl;
+		return 2;
+	}
+	ifstream file(path, ios::binary);
+	TraceHeader header;
+	if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0) {
+		cerr << path << ": not a trace file" << endl;
+		return 1;
+	}
+	if (header.version != trace_version) {
+		cerr << path << ": unsupported trace version " << header.version << endl;
+		return 1;
+	}
+	string ring(header.capacity, '\0');
+	if (header.capacity == 0 || !file.read(&ring[0], ring.size()) || header.head < header.tail || header.head - header.tail > header.capacity) {
+		cerr << path << ": truncated trace file" << endl;
+		return 1;
+	}
+
+	if (json) {
+		cout << "{\"dropped_bytes\": " << header.tail << ", \"events\": [";
+	} else if (header.tail > 0) {
+		cout << "(" << header.tail << " bytes of older events overwritten)\n";
+	}
+	bool first = true;
+	for (uint64_t at = header.tail; at < header.head; ) {
+		Cursor c(ring, at);
+		uint64_t size = c.Byte();
+		size |= uint64_t(c.Byte()) << 8;
+		Event e;
+		if (size < 4 || at + size > header.head || !Decode(c, e)) {
+			cerr << path << ": corrupt event at byte " << at << endl;
+			return 1;
+		}
+		if (json) {
+			cout << (first ? "\n  " : ",\n  ");
+			PrintJson(e);
+		} else {
+			PrintText(e);
+		}
+		first = false;
+		at += size;
+	}
+	if (json) {
+		cout << "\n]}\n";
+	}
+	return 0;
+}